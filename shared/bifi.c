@@ -25,8 +25,6 @@
 #endif
 #endif
 
-static int bifi_swapping = 1;  /* set in bifi_clear() */
-
 /* one helper from g_array.c (the original is global, but since
    garray_ambigendian() lacks EXTERN specifier, .dll externs cannot see it;
    btw. it has a comment: ``this should be renamed and moved...'')
@@ -38,6 +36,10 @@ static int ambigendian(void)
     return (c==0);
 }
 
+/* no global state here, so that files may be read and written in parallel
+   (the check is constant anyway) */
+#define bifi_swapping  (!ambigendian())
+
 /* two helpers from d_soundfile.c */
 uint32 bifi_swap4(uint32 n)
 {
@@ -77,7 +79,6 @@ static void bifi_error_set(t_bifi *x, int errcode)
 
 void bifi_clear(t_bifi *x)
 {
-    bifi_swapping = !ambigendian();
     x->b_fp = 0;
     x->b_filename[0] = '\0';
     bifi_error_clear(x);
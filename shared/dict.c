@@ -20,7 +20,11 @@
 
 #define DICT_HASHSIZE_DEFAULT   1024
 #define DICT_HASHSIZE_MIN          8
-#define DICT_HASHSIZE_MAX      16384
+#define DICT_HASHSIZE_MAX      16384  /* initial size only */
+
+/* hashtable doubles when its load exceeds 3/4 */
+#define DICT_MUSTGROW(x)  ((x)->d_nentries > ((x)->d_hashsize >> 1) + \
+			   ((x)->d_hashsize >> 2))
 
 /* two structures local to m_pd.c */
 typedef struct _dict_bindelem
@@ -69,6 +73,7 @@ t_dict *dict_new(size_t hashsize)
 #ifdef DICT_DEBUG
 	post("allocating dictionary with %d-element hashtable", sz);
 #endif
+	x->d_nentries = 0;
 	if (x->d_hashtable =
 	    getbytes((x->d_hashsize = sz) * sizeof(*x->d_hashtable)))
 	{
@@ -83,60 +88,134 @@ t_dict *dict_new(size_t hashsize)
 void dict_free(t_dict *x)
 {
     if (x->d_hashtable)
+    {
+	size_t i;
+	for (i = 0; i < x->d_hashsize; i++)
+	{
+	    t_dict_entry *e, *next;
+	    for (e = x->d_hashtable[i]; e; e = next)
+	    {
+		next = e->e_next;
+		if (e->e_owned)
+		{
+		    freebytes(e->e_sym->s_name, strlen(e->e_sym->s_name) + 1);
+		    freebytes(e->e_sym, sizeof(*e->e_sym));
+		}
+		freebytes(e, sizeof(*e));
+	    }
+	}
 	freebytes(x->d_hashtable, x->d_hashsize * sizeof(*x->d_hashtable));
+    }
     freebytes(x, sizeof(*x));
 }
 
-/* adapted dogensym() from m_class.c */
-t_symbol *dict_dokey(t_dict *x, char *s, t_symbol *oldsym)
+/* FNV-1a, followed by a final avalanche (as in MurmurHash3), so that
+   keys differing only in their last characters (which is common with
+   names like "seq1", "seq2"...) spread across the whole table */
+static unsigned int dict_hash(char *s, int *lengthp)
 {
-    t_symbol **sym1, *sym2;
-    unsigned int hash1 = 0,  hash2 = 0;
-    int length = 0;
+    unsigned int hash = 2166136261U;
     char *s2 = s;
-    int mask = x->d_hashsize - 1;
+    while (*s2)
+    {
+	hash ^= (unsigned char)*s2++;
+	hash *= 16777619U;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bU;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35U;
+    hash ^= hash >> 16;
+    *lengthp = s2 - s;
+    return (hash);
+}
+
+/* entries are relinked by their cached hash, strings are not touched */
+static void dict_grow(t_dict *x)
+{
+    size_t i, newsize = x->d_hashsize << 1;
+    t_dict_entry **newtable = getbytes(newsize * sizeof(*newtable));
+    if (!newtable)
+	return;  /* keep on with longer chains */
 #ifdef DICT_DEBUG
-    startpost("make symbol-key from \"%s\"", s);
+    post("growing dictionary to %d-element hashtable", newsize);
 #endif
-    while (*s2)
+    for (i = 0; i < x->d_hashsize; i++)
     {
-	hash1 += *s2;
-	hash2 += hash1;
-	length++;
-	s2++;
+	t_dict_entry *e, *next;
+	for (e = x->d_hashtable[i]; e; e = next)
+	{
+	    t_dict_entry **ep = newtable + (e->e_hash & (newsize - 1));
+	    next = e->e_next;
+	    e->e_next = *ep;
+	    *ep = e;
+	}
     }
-    sym1 = x->d_hashtable + (hash2 & mask);
+    freebytes(x->d_hashtable, x->d_hashsize * sizeof(*x->d_hashtable));
+    x->d_hashtable = newtable;
+    x->d_hashsize = newsize;
+}
+
+/* adapted dogensym() from m_class.c */
+t_symbol *dict_dokey(t_dict *x, char *s, t_symbol *oldsym)
+{
+    t_dict_entry **e1, *e2;
+    t_symbol *sym;
+    int length;
+    unsigned int hash = dict_hash(s, &length);
 #ifdef DICT_DEBUG
-    post(" in slot %d", (hash2 & mask));
+    startpost("make symbol-key from \"%s\"", s);
+#endif
+    e1 = x->d_hashtable + (hash & (x->d_hashsize - 1));
+#ifdef DICT_DEBUG
+    post(" in slot %d", (hash & (x->d_hashsize - 1)));
 #endif
-    while (sym2 = *sym1)
+    while (e2 = *e1)
     {
 #ifdef DICT_DEBUG
-	post("try \"%s\"", sym2->s_name);
+	post("try \"%s\"", e2->e_sym->s_name);
 #endif
-	if (!strcmp(sym2->s_name, s))
+	if (e2->e_hash == hash && !strcmp(e2->e_sym->s_name, s))
 	{
 #ifdef DICT_DEBUG
-	    post("found at address %x", (int)sym2);
+	    post("found at address %x", (int)e2->e_sym);
 #endif
-	    return(sym2);
+	    return (e2->e_sym);
 	}
-	sym1 = &sym2->s_next;
+	e1 = &e2->e_next;
+    }
+    if (!(e2 = (t_dict_entry *)getbytes(sizeof(*e2))))
+	return (0);
+    if (oldsym)
+    {
+	sym = oldsym;
+	e2->e_owned = 0;
     }
-    if (oldsym) sym2 = oldsym;
     else
     {
-    	sym2 = (t_symbol *)t_getbytes(sizeof(*sym2));
-    	sym2->s_name = t_getbytes(length+1);
-    	sym2->s_next = 0;
-    	sym2->s_thing = 0;
-    	strcpy(sym2->s_name, s);
+	if (!(sym = (t_symbol *)t_getbytes(sizeof(*sym))) ||
+	    !(sym->s_name = t_getbytes(length+1)))
+	{
+	    if (sym) freebytes(sym, sizeof(*sym));
+	    freebytes(e2, sizeof(*e2));
+	    return (0);
+	}
+	sym->s_next = 0;
+	sym->s_thing = 0;
+	strcpy(sym->s_name, s);
+	e2->e_owned = 1;
     }
-    *sym1 = sym2;
+    e2->e_hash = hash;
+    e2->e_sym = sym;
+    e2->e_next = 0;
+    *e1 = e2;
+    x->d_nentries++;
 #ifdef DICT_DEBUG
-    post("appended at address %x", (int)sym2);
+    post("appended at address %x", (int)sym);
 #endif
-    return (sym2);
+    if (DICT_MUSTGROW(x))
+	dict_grow(x);
+    return (sym);
 }
 
 /* adapted gensym() from m_class.c */
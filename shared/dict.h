@@ -5,11 +5,21 @@
 #ifndef __DICT_H__
 #define __DICT_H__
 
+/* keys are symbols, chained in separate entries, which cache key hash */
+typedef struct _dict_entry
+{
+    unsigned int          e_hash;
+    t_symbol             *e_sym;
+    struct _dict_entry   *e_next;
+    int                   e_owned;  /* set if e_sym is allocated here */
+} t_dict_entry;
+
 typedef struct _dict
 {
-    size_t      d_hashsize;
-    t_symbol  **d_hashtable;
-    t_class    *d_bindlist_class;
+    size_t          d_hashsize;
+    size_t          d_nentries;
+    t_dict_entry  **d_hashtable;
+    t_class        *d_bindlist_class;
 } t_dict;
 
 typedef int (*t_dict_hook)(t_pd *x, void *arg);
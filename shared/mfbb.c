@@ -395,39 +395,81 @@ makefailed:
     return (0);
 }
 
-/* comparison functions used by qsort (assume unfolded time) */
-/* LATER replace qsort with some more efficient merging algorithm (maybe use
-   semi-atoms to store links?) */
-static int mfbb_compare_particles(const void *ap1, const void *ap2)
+/* Sorting keys (assume unfolded time).  Particles are not sorted in place:
+   keys are sorted instead, and then particles are permuted in place.
+   Since a key carries everything the comparison needs, there is no global
+   state, and several binbufs may be sorted in parallel.  Comparing original
+   positions last makes the sort stable, so that simultaneous events keep
+   their order (note-offs do not jump over note-ons, etc.) */
+typedef struct _mfbb_key
 {
-    return (((t_atom *)ap1)->a_w.w_float > ((t_atom *)ap2)->a_w.w_float ? 1 : -1);
+    int      k_track;  /* zero, unless separating */
+    t_float  k_time;
+    int      k_ndx;    /* original particle index */
+} t_mfbb_key;
+
+static int mfbb_compare_keys(const void *p1, const void *p2)
+{
+    const t_mfbb_key *k1 = p1, *k2 = p2;
+    if (k1->k_track != k2->k_track)
+	return (k1->k_track < k2->k_track ? -1 : 1);
+    if (k1->k_time != k2->k_time)
+	return (k1->k_time < k2->k_time ? -1 : 1);
+    return (k1->k_ndx - k2->k_ndx);
 }
 
-static t_squtt *tartemhack;
-static int mfbb_decompare_particles(const void *ap1, const void *ap2)
+/* if tt is null, tracks are ignored */
+static void mfbb_sort_particles(t_binbuf *x, int nevents, t_squtt *tt)
 {
-    int track1, track2;
-    if (!(track2 = squtt_checkatom(tartemhack, (t_atom *)ap2))) return (-1);
-    if (!(track1 = squtt_checkatom(tartemhack, (t_atom *)ap1))) return (1);
-    if (track1 < track2) return (-1);
-    if (track1 > track2) return (1);
-    return (((t_atom *)ap1)->a_w.w_float > ((t_atom *)ap2)->a_w.w_float ? 1 : -1);
+    size_t psize = MFBB_PARTICLE_SIZE * sizeof(t_atom);
+    t_atom tmp[MFBB_PARTICLE_SIZE], *ap;
+    t_mfbb_key *keys, *kp;
+    int i, j, src;
+    if (nevents * MFBB_PARTICLE_SIZE > x->b_n)
+	nevents = x->b_n / MFBB_PARTICLE_SIZE;
+    if (nevents < 2)
+	return;
+    if (!(keys = getbytes(nevents * sizeof(*keys))))
+	return;
+    for (i = 0, kp = keys, ap = x->b_vec; i < nevents;
+	 i++, kp++, ap += MFBB_PARTICLE_SIZE)
+    {
+	kp->k_track = 0;
+	if (tt && !(kp->k_track = squtt_checkatom(tt, ap + 1)))
+	    kp->k_track = 0x7fffffff;  /* foreign targets go last */
+	kp->k_time = ap->a_w.w_float;
+	kp->k_ndx = i;
+    }
+    qsort(keys, nevents, sizeof(*keys), mfbb_compare_keys);
+    /* permute in place, following cycles; a particle is in place,
+       when its key's index is equal to its position */
+    for (i = 0; i < nevents; i++)
+    {
+	if (keys[i].k_ndx == i)
+	    continue;
+	memcpy(tmp, x->b_vec + i * MFBB_PARTICLE_SIZE, psize);
+	for (j = i; (src = keys[j].k_ndx) != i; j = src)
+	{
+	    memcpy(x->b_vec + j * MFBB_PARTICLE_SIZE,
+		   x->b_vec + src * MFBB_PARTICLE_SIZE, psize);
+	    keys[j].k_ndx = j;
+	}
+	memcpy(x->b_vec + j * MFBB_PARTICLE_SIZE, tmp, psize);
+	keys[j].k_ndx = j;
+    }
+    freebytes(keys, nevents * sizeof(*keys));
 }
 
 /* track interleaving */
 void mfbb_merge_tracks(t_binbuf *x, t_mifi_stream *stp, t_squtt *tt)
 {
-    tartemhack = tt;
-    qsort(x->b_vec, stp->s_nevents, MFBB_PARTICLE_SIZE * sizeof(t_atom),
-	  mfbb_compare_particles);
+    mfbb_sort_particles(x, stp->s_nevents, 0);
 }
 
 /* track demultiplexing */
 void mfbb_separate_tracks(t_binbuf *x, t_mifi_stream *stp, t_squtt *tt)
 {
-    tartemhack = tt;
-    qsort(x->b_vec, stp->s_nevents, MFBB_PARTICLE_SIZE * sizeof(t_atom),
-	  mfbb_decompare_particles);
+    mfbb_sort_particles(x, stp->s_nevents, tt);
 }
 
 /* This is to be called in a qlist reading routine.
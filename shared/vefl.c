@@ -2,7 +2,8 @@
 * For information on usage and redistribution, and for a DISCLAIMER OF ALL
 * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
 
-/* The simplest of garrays: vector of floats */
+/* The simplest of garrays: vector of floats (accessed as words, so that
+   this works where a t_word is wider than a t_float) */
 
 /* Array checking is done in three points:
    1. vefl_new(): never complains
@@ -50,11 +51,6 @@ static void vefl_tick(t_vefl *vp)
 t_vefl *vefl_placement_new(t_vefl *vp, t_symbol *name,
 			   int writable, t_glist *gl, t_garray *arr)
 {
-    if (sizeof(t_word) != sizeof(t_float))
-    {
-	bug("vefl_new: sizeof(t_word) != sizeof(t_float)");
-	return (0);
-    }
     if (!vp)
     {
 	if (!(vp = getbytes(sizeof(*vp))))
@@ -81,7 +77,7 @@ t_vefl *vefl_placement_new(t_vefl *vp, t_symbol *name,
 	vp->v_glist = vp->v_garray ? vp->v_garray->x_glist : 0;
     }
     if (vp->v_garray
-	&& !garray_getfloatarray(vp->v_garray, &vp->v_size, &vp->v_data))
+	&& !garray_getfloatwords(vp->v_garray, &vp->v_size, &vp->v_data))
     {
 	vp->v_glist = 0;
 	vp->v_garray = 0;
@@ -118,7 +114,7 @@ int vefl_renew(t_vefl *vp, t_symbol *name, int complain)
 	{
 	    if (complain) error("%s: no such array", name->s_name);
 	}
-	else if (!garray_getfloatarray(vp->v_garray, &vp->v_size, &vp->v_data))
+	else if (!garray_getfloatwords(vp->v_garray, &vp->v_size, &vp->v_data))
 	{
 	    vp->v_garray = 0;
 	    if (complain) error("%s: bad template", name->s_name);
@@ -133,6 +129,27 @@ int vefl_renew(t_vefl *vp, t_symbol *name, int complain)
     return (0);
 }
 
+/* Resizes an array found by the last vefl_renew(), unless it already has
+   the requested size.  Returns zero on failure, the array is then
+   forgotten. */
+int vefl_resize(t_vefl *vp, int size)
+{
+    if (!vp->v_garray)
+	return (0);
+    if (vp->v_size != size)
+    {
+	garray_resize(vp->v_garray, size);
+	if (!garray_getfloatwords(vp->v_garray, &vp->v_size, &vp->v_data)
+	    || vp->v_size < size)
+	{
+	    vp->v_garray = 0;
+	    vp->v_glist = 0;
+	    return (0);
+	}
+    }
+    return (1);
+}
+
 void vefl_redraw(t_vefl *vp, float suppresstime)
 {
     if (vp->v_clock)  /* requests from readers are ignored */
@@ -192,18 +209,18 @@ void vefl_setbounds(t_vefl *vp, t_float xmin, t_float ymin,
 void vefl_getrange(t_vefl *vp, t_float *yminp, t_float *ymaxp)
 {
     int vsz = vp->v_size;
-    t_float *vec = vp->v_data;
+    t_word *vec = vp->v_data;
     if (vec && vsz)
     {
 	t_float ymin = SHARED_FLT_MAX, ymax = -SHARED_FLT_MAX;
 	while (vsz--)
 	{
-	    if (*vec > ymax)
+	    if (vec->w_float > ymax)
 	    {
-		ymax = *vec;
+		ymax = vec->w_float;
 		if (ymax < ymin) ymin = ymax;
 	    }
-	    else if (*vec < ymin) ymin = *vec;
+	    else if (vec->w_float < ymin) ymin = vec->w_float;
 	    vec++;
 	}
 	*yminp = ymin;
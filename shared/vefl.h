@@ -12,7 +12,7 @@ typedef struct _vefl
     t_glist   *v_glist;
     t_garray  *v_garray;
     int        v_size;
-    t_float   *v_data;
+    t_word    *v_data;    /* use w_float */
     t_symbol  *v_type;
     t_clock   *v_clock;
     int        v_clockset;
@@ -24,6 +24,7 @@ t_vefl *vefl_placement_new(t_vefl *vp, t_symbol *name,
 			   int writable, t_glist *gl, t_garray *arr);
 void vefl_free(t_vefl *vp);
 int vefl_renew(t_vefl *vp, t_symbol *name, int complain);
+int vefl_resize(t_vefl *vp, int size);
 void vefl_redraw(t_vefl *vp, float suppresstime);
 void vefl_redraw_stop(t_vefl *vp);
 void vefl_getbounds(t_vefl *vp, t_float *xminp, t_float *yminp,
@@ -19,7 +19,6 @@
    - optional unfolded positioning and editing
    - smoothed positioning: timespan argument, attempt to make acc./ret.
    - better searching of midi events
-   - `merge' method (sorting version of addclone)
    - `freeze' pp
    - clean up and debug saving feature
    - find a better way of plugging xeq features into the friends
@@ -94,64 +93,114 @@ static void xeq_gui_defs(void)
     sys_gui(" $name.text insert end $contents\n");
     sys_gui("}\n");
 
-    sys_gui("proc xeq_window_ok {name} {\n");
-    sys_gui(" if {[winfo exists $name]} {\n");
-    sys_gui("  set ii [$name.text index [concat end - 1 lines]]\n");
+    sys_gui("proc xeq_send {msg} {\n");
     if (major > 0 || minor > 42)
-        sys_gui("  pdsend [concat $name.editok clear \\;]\n");
+	sys_gui(" pdsend $msg\n");
     else
-        sys_gui("  pd [concat $name.editok clear \\;]\n");
-    sys_gui("  for {set i 1} \\\n");
-    sys_gui("   {[$name.text compare $i.end < $ii]} \\\n");
-    sys_gui("  	{incr i 1} {\n");
-    sys_gui("   set lin [$name.text get $i.0 $i.end]\n");
+	sys_gui(" pd $msg\n");
+    sys_gui("}\n");
+
+    /* Paged window: contents are sent in pages of a fixed number of
+       events, each page following a mark, the next one is requested
+       when the end of text becomes visible. */
+    sys_gui("proc xeq_window_paged {name geometry title} {\n");
+    sys_gui(" xeq_window $name $geometry $title {}\n");
+    sys_gui(" foreach m [$name.text mark names] {\n");
+    sys_gui("  if {[string match xeqpage* $m]} {$name.text mark unset $m}\n");
+    sys_gui(" }\n");
+    sys_gui(" set ::xeq_npages($name) 0\n");
+    sys_gui(" set ::xeq_more($name) 1\n");
+    sys_gui(" set ::xeq_pending($name) 1\n");
+    sys_gui(" $name.text configure \\\n");
+    sys_gui("  -yscrollcommand [list xeq_window_scroll $name]\n");
+    sys_gui("}\n");
+
+    sys_gui("proc xeq_window_scroll {name first last} {\n");
+    sys_gui(" $name.scroll set $first $last\n");
+    sys_gui(" if {$last >= 1.0 && $::xeq_more($name) \\\n");
+    sys_gui("  && !$::xeq_pending($name)} {\n");
+    sys_gui("  set ::xeq_pending($name) 1\n");
+    sys_gui("  xeq_send [concat $name.editok editpage \\\n");
+    sys_gui("   $::xeq_npages($name) \\;]\n");
+    sys_gui(" }\n");
+    sys_gui("}\n");
+
+    sys_gui("proc xeq_window_page {name page} {\n");
+    sys_gui(" if {![winfo exists $name]} return\n");
+    sys_gui(" $name.text mark set xeqpage$page {end - 1 chars}\n");
+    sys_gui(" $name.text mark gravity xeqpage$page left\n");
+    sys_gui("}\n");
+
+    sys_gui("proc xeq_window_pagetext {name page} {\n");
+    sys_gui(" set next xeqpage[expr $page + 1]\n");
+    sys_gui(" if {[lsearch [$name.text mark names] $next] < 0} {\n");
+    sys_gui("  set next {end - 1 chars}\n");
+    sys_gui(" }\n");
+    sys_gui(" return [$name.text get xeqpage$page $next]\n");
+    sys_gui("}\n");
+
+    sys_gui("proc xeq_window_pagedone {name page more} {\n");
+    sys_gui(" if {![winfo exists $name]} return\n");
+    sys_gui(" set ::xeq_orig($name,$page) [xeq_window_pagetext $name $page]\n");
+    sys_gui(" set ::xeq_npages($name) [expr $page + 1]\n");
+    sys_gui(" set ::xeq_more($name) $more\n");
+    sys_gui(" set ::xeq_pending($name) 0\n");
+    sys_gui(" eval xeq_window_scroll $name [$name.text yview]\n");
+    sys_gui("}\n");
+
+    /* only the pages which were changed are sent back */
+    sys_gui("proc xeq_window_ok {name} {\n");
+    sys_gui(" if {![winfo exists $name]} return\n");
+    sys_gui(" for {set p 0} {$p < $::xeq_npages($name)} {incr p} {\n");
+    sys_gui("  set txt [xeq_window_pagetext $name $p]\n");
+    sys_gui("  if {$txt == $::xeq_orig($name,$p)} continue\n");
+    sys_gui("  xeq_send [concat $name.editok editchange $p \\;]\n");
+    sys_gui("  foreach lin [split $txt \\n] {\n");
     sys_gui("   if {$lin != \"\"} {\n");
     sys_gui("    regsub -all \\; $lin \"  _semi_ \" tmplin\n");
     sys_gui("    regsub -all \\, $tmplin \"  _comma_ \" lin\n");
-    if (major > 0 || minor > 42)
-        sys_gui("    pdsend [concat $name.editok addline $lin \\;]\n");
-    else
-        sys_gui("    pd [concat $name.editok addline $lin \\;]\n");
+    sys_gui("    xeq_send [concat $name.editok editline $lin \\;]\n");
     sys_gui("   }\n");
     sys_gui("  }\n");
+    sys_gui("  set ::xeq_orig($name,$p) $txt\n");
     sys_gui(" }\n");
+    sys_gui(" xeq_send [concat $name.editok editdone \\;]\n");
     sys_gui("}\n");
 }
 
 static char wname[MAXPDSTRING];
 
-static void xeq_window(t_xeq *x, char *title, char *contents)
+static void xeq_window_ok(t_xeq *x)
 {
-    int width = 600, height = 340;
-    sprintf(wname, ".%x", (int)x);
-    if (!title) title = "xeq contents";
-    sys_vgui("xeq_window %s %dx%d {%s} {%s}\n",
-	     wname, width, height, title, contents);
+    sprintf(wname, ".%lx", (unsigned long)x);
+    sys_vgui("xeq_window_ok %s\n", wname);
 }
 
-static void xeq_window_ok(t_xeq *x)
+static void xeq_window_paged(t_xeq *x, char *title)
 {
-    sprintf(wname, ".%x", (int)x);
-    sys_vgui("xeq_window_ok %s\n", wname);
+    int width = 600, height = 340;
+    sprintf(wname, ".%lx", (unsigned long)x);
+    if (!title) title = "xeq contents";
+    sys_vgui("xeq_window_paged %s %dx%d {%s}\n", wname, width, height, title);
 }
 
-/* to be called only immediately after xeq_window(),
-   before there is any chance of window being closed */
+/* pages are sent on request, so the window may be gone already */
 static void xeq_window_append(t_xeq *x, char *contents)
 {
-    sprintf(wname, ".%x", (int)x);
-    sys_vgui("%s.text insert end {%s}\n", wname, contents);
+    sprintf(wname, ".%lx", (unsigned long)x);
+    sys_vgui("if {[winfo exists %s]} {%s.text insert end {%s}}\n",
+	     wname, wname, contents);
 }
 
 static void xeq_window_bind(t_xeq *x)
 {
-    sprintf(wname, ".%x.editok", (int)x);
+    sprintf(wname, ".%lx.editok", (unsigned long)x);
     pd_bind((t_pd *)x, gensym(wname));
 }
 
 static void xeq_window_unbind(t_xeq *x)
 {
-    sprintf(wname, ".%x.editok", (int)x);
+    sprintf(wname, ".%lx.editok", (unsigned long)x);
     pd_unbind((t_pd *)x, gensym(wname));
 }
 
@@ -169,10 +218,12 @@ int xeq_listparse(int argc, t_atom *argv,
     *data2p = -1;
     if (--argc < 2 || argv->a_type != A_FLOAT) goto notmidi;
     *data1p = (int)argv++->a_w.w_float;
+    argc--;
     if (*data1p < 0 || *data1p > 127 || argv->a_type != A_FLOAT) goto notmidi;
     switch (*statusp)
     {
     case 0x80: case 0x90: case 0xa0: case 0xb0: case 0xe0:
+	if (argc < 2) goto notmidi;  /* no channel after data2 */
 	*data2p = (int)argv++->a_w.w_float;
 	if (*data2p < 0 || *data2p > 127 || argv->a_type != A_FLOAT) goto notmidi;
     case 0xc0: case 0xd0:
@@ -190,6 +241,51 @@ notmidi:
     return (0);
 }
 
+/* Parses arguments of `packed' message: none or nonzero for
+   XEQ_PACKED_LIST, zero or `off' for XEQ_PACKED_OFF, `raw' for
+   XEQ_PACKED_RAW.  Returns -1 if arguments are bad. */
+int xeq_packedmode(int ac, t_atom *av)
+{
+    if (!ac)
+	return (XEQ_PACKED_LIST);
+    if (av->a_type == A_FLOAT)
+	return (av->a_w.w_float != 0 ? XEQ_PACKED_LIST : XEQ_PACKED_OFF);
+    if (av->a_type == A_SYMBOL)
+    {
+	char *name = av->a_w.w_symbol->s_name;
+	if (!strcmp(name, "raw"))
+	    return (XEQ_PACKED_RAW);
+	if (!strcmp(name, "off"))
+	    return (XEQ_PACKED_OFF);
+	if (!strcmp(name, "on") || !strcmp(name, "list"))
+	    return (XEQ_PACKED_LIST);
+    }
+    post("packed: bad argument (use 0, 1, on, off, list or raw)");
+    return (-1);
+}
+
+/* Fills at with a single list for a channel event, in a packed mode.
+   Channel is zero-based, data2 is negative if missing (then it is
+   either skipped, in raw mode, or zeroed).  Returns number of atoms. */
+int xeq_packmidi(t_atom *at, int mode,
+		 int status, int channel, int data1, int data2)
+{
+    if (mode == XEQ_PACKED_RAW)
+    {
+	SETFLOAT(at, status | channel);
+	SETFLOAT(at + 1, data1);
+	if (data2 < 0)
+	    return (2);
+	SETFLOAT(at + 2, data2);
+	return (3);
+    }
+    SETFLOAT(at, channel + 1);
+    SETFLOAT(at + 1, status);
+    SETFLOAT(at + 2, data1);
+    SETFLOAT(at + 3, data2 < 0 ? 0 : data2);
+    return (4);
+}
+
 /* XEQ LOCATOR */
 
 /* standard locator names (to speed up message parsing a little) */
@@ -222,27 +318,31 @@ t_xeqlocator *xeq_whichloc(t_xeq *x, t_symbol *s)
 static int xeqlocator_lookatfirst(t_xeqlocator *x)
 {
     t_atom *ap;
+    int checkdelay = 1;
     if (!x->l_binbuf || (x->l_natoms = binbuf_getnatom(x->l_binbuf)) <= 0)
 	return (XEQ_FAIL_EMPTY);
     ap = x->l_firstatom = binbuf_getvec(x->l_binbuf);
     x->l_atprevious = -1;
     x->l_atdelta = -1;
+    x->l_delta = 0;
     for (x->l_atnext = 0; x->l_atnext < x->l_natoms; x->l_atnext++, ap++)
     {
 	switch (ap->a_type)
 	{
 	case A_FLOAT:
-	    if (x->l_atdelta < 0)
+	    if (checkdelay)
 	    {
-		if ((x->l_delta = ap->a_w.w_float) < 0)
-		    x->l_delta = 0;
+		if (ap->a_w.w_float > 0)
+		    x->l_delta += ap->a_w.w_float;
 		x->l_atdelta = x->l_atnext;
+		checkdelay = 0;
 	    }
 	    break;
 	case A_SYMBOL:
 	    x->l_when = x->l_delta;
 	    return (XEQ_FAIL_OK);
 	case A_SEMI:
+	    checkdelay = 1;
 	    break;
 	default:
 	    return (XEQ_FAIL_CORRUPT);
@@ -253,17 +353,21 @@ static int xeqlocator_lookatfirst(t_xeqlocator *x)
 
 /* look at target symbol of next event */
 /* LATER sort out semi/comma rules and check again... */
+/* Deltas of events without a target are summed up, and only the first
+   element of a delta vector counts, as in xeqindex_build(), so that
+   locators agree with the event index. */
 static int xeqlocator_lookatnext(t_xeqlocator *x)
 {
     t_atom *ap = x->l_firstatom + x->l_atnext;
     int checkdelay = 0, checktarget = 0;
     x->l_atprevious = x->l_atnext;
+    x->l_delta = 0;
     for (; x->l_atnext < x->l_natoms; x->l_atnext++, ap++)
     {
 	if (checkdelay && ap->a_type == A_FLOAT)
 	{
-	    if ((x->l_delta = ap->a_w.w_float) < 0)
-		x->l_delta = 0;
+	    if (ap->a_w.w_float > 0)
+		x->l_delta += ap->a_w.w_float;
 	    x->l_atdelta = x->l_atnext;
 	    checkdelay = 0;
 	    checktarget = 1;
@@ -273,27 +377,33 @@ static int xeqlocator_lookatnext(t_xeqlocator *x)
 	    x->l_when += x->l_delta;
 	    return (XEQ_FAIL_OK);
 	}
-	else checkdelay = checktarget = ap->a_type == A_SEMI;
+	else if (!checktarget || ap->a_type != A_FLOAT)
+	    checkdelay = checktarget = ap->a_type == A_SEMI;
     }
     return (XEQ_FAIL_EOS);
 }
 
+/* negative index counts from the end (last event: -1) */
 static int xeqlocator_lookatindex(t_xeqlocator *x, int ndx)
 {
     int result = xeqlocator_lookatfirst(x);
     if (result != XEQ_FAIL_OK)
 	return (result);
-    if (ndx < -1)
-	return (XEQ_FAIL_BADREQUEST);  /* LATER retrograde (last event: -1) */
-    else if (ndx == -1)
-	while (xeqlocator_lookatnext(x) == XEQ_FAIL_OK);
-    else while (ndx--)
+    if (ndx < 0)
+    {
+	int nevents = 1;
+	while (xeqlocator_lookatnext(x) == XEQ_FAIL_OK) nevents++;
+	if ((ndx += nevents) < 0)
+	    return (XEQ_FAIL_BADREQUEST);
+	xeqlocator_lookatfirst(x);
+    }
+    if (ndx > 0) while (ndx--)
 	if (xeqlocator_lookatnext(x) != XEQ_FAIL_OK)
 	    return (XEQ_FAIL_EOS);
     return (XEQ_FAIL_OK);
 }
 
-float xeqlocator_reset(t_xeqlocator *x)
+double xeqlocator_reset(t_xeqlocator *x)
 {
     return (xeqlocator_settotime(x, 0));  /* hope this is safe... */
 }
@@ -320,21 +430,28 @@ int xeqlocator_settoindex(t_xeqlocator *x, int ndx)
     return (result);
 }
 
-/* FIXME/CHECKIT */
-/* return delay until next message, if any (negative return otherwise) */
-float xeqlocator_settotime(t_xeqlocator *x, float when)
+/* Locator is set to the given time, and its next event is the first one
+   not earlier (l_when + l_delay being the onset of that event).  Return
+   delay until next message, if any (negative return otherwise). */
+double xeqlocator_settotime(t_xeqlocator *x, double when)
 {
     xeqlocator_hide(x);
     x->l_when = when;
     if (xeqlocator_lookatfirst(x) != XEQ_FAIL_OK)
 	return (-1);
     do if (x->l_when >= when)
-	return (x->l_delay = x->l_when - when);
+    {
+	x->l_delay = x->l_when - when;
+	x->l_when = when;
+	return (x->l_delay);
+    }
     while (xeqlocator_lookatnext(x) == XEQ_FAIL_OK);
+    x->l_when = when;  /* past the last event */
+    x->l_delay = 0;
     return (-1);
 }
 
-float xeqlocator_settolocator(t_xeqlocator *x, t_xeqlocator *reference)
+double xeqlocator_settolocator(t_xeqlocator *x, t_xeqlocator *reference)
 {
     if (x->l_binbuf == reference->l_binbuf)
     {
@@ -344,12 +461,30 @@ float xeqlocator_settolocator(t_xeqlocator *x, t_xeqlocator *reference)
     else return (xeqlocator_settotime(x, reference->l_when));
 }
 
-float xeqlocator_move(t_xeqlocator *x, float interval)
+/* Locator is set to k-th event of an index, built for locator's binbuf
+   (no delay left). */
+void xeqlocator_settoevent(t_xeqlocator *x, t_xeqindex *ix, int k)
+{
+    t_xeqevent *ep = ix->ix_events + k;
+    x->l_firstatom = binbuf_getvec(x->l_binbuf);
+    x->l_natoms = binbuf_getnatom(x->l_binbuf);
+    x->l_when = ep->e_onset;
+    x->l_delay = 0;
+    x->l_delta = ep->e_onset - (k ? ep[-1].e_onset : 0);
+    x->l_atnext = (ep->e_attarget >= 0 ? ep->e_attarget : ep->e_atend);
+    x->l_atdelta = (k < ix->ix_nevents &&
+		    x->l_firstatom[ep->e_atstart].a_type == A_FLOAT ?
+		    ep->e_atstart : -1);
+    x->l_atprevious = (!k ? -1 : (ep[-1].e_attarget >= 0 ?
+				  ep[-1].e_attarget : ep[-1].e_atstart));
+}
+
+double xeqlocator_move(t_xeqlocator *x, double interval)
 {
     int natoms;
     t_atom *ap;
-    float lastdelay = 0;
-    float nexttime = x->l_when + x->l_delay;
+    double lastdelay = 0;
+    double nexttime = x->l_when + x->l_delay;
     int ndx = x->l_atnext;
     int prv = x->l_atprevious;
     int checkdelay, checktarget;
@@ -367,7 +502,8 @@ float xeqlocator_move(t_xeqlocator *x, float interval)
     {
 	if (checkdelay && ap->a_type == A_FLOAT)
 	{
-	    lastdelay = ap->a_w.w_float;
+	    if (ap->a_w.w_float > 0)
+		lastdelay += ap->a_w.w_float;
 	    checkdelay = 0;
 	    checktarget = 1;
 	}
@@ -386,17 +522,20 @@ float xeqlocator_move(t_xeqlocator *x, float interval)
 	    checkdelay = checktarget = 0;
 	}
 	/* LATER sort out semi/comma rules and check again... */
-	else checkdelay = checktarget = ap->a_type == A_SEMI;
+	else if (!checktarget || ap->a_type != A_FLOAT)
+	    checkdelay = checktarget = ap->a_type == A_SEMI;
     }
+    x->l_atnext = natoms;  /* past the last event */
+    x->l_atprevious = prv;
     return (-1);
 }
 
-float xeqlocator_skipnotes(t_xeqlocator *x, int count)
+double xeqlocator_skipnotes(t_xeqlocator *x, int count)
 {
     int natoms;
     t_atom *ap;
-    float lastdelay = 0;
-    float nexttime = x->l_when + x->l_delay;
+    double lastdelay = 0;
+    double nexttime = x->l_when + x->l_delay;
     int ndx = x->l_atnext;
     int prv = x->l_atprevious;
     int checkdelay, checktarget;
@@ -413,16 +552,19 @@ float xeqlocator_skipnotes(t_xeqlocator *x, int count)
     {
 	if (checkdelay && ap->a_type == A_FLOAT)
 	{
-	    lastdelay = ap->a_w.w_float;
+	    if (ap->a_w.w_float > 0)
+		lastdelay += ap->a_w.w_float;
 	    checkdelay = 0;
 	    checktarget = 1;
 	}
 	else if (checktarget && ap->a_type == A_SYMBOL)
 	{
+	    nexttime += lastdelay;
 	    if (ap[1].a_type == A_FLOAT && (int)ap[1].a_w.w_float == 144
 		&& ap[3].a_type == A_FLOAT && (int)ap[3].a_w.w_float > 0
 		&& count-- <= 0)
 	    {
+		x->l_when = nexttime;
 		x->l_delay = 0;
 		x->l_delta = lastdelay;
 		x->l_atnext = ndx;
@@ -434,7 +576,8 @@ float xeqlocator_skipnotes(t_xeqlocator *x, int count)
 	    checkdelay = checktarget = 0;
 	}
 	/* LATER sort out semi/comma rules and check again... */
-	else checkdelay = checktarget = ap->a_type == A_SEMI;
+	else if (!checktarget || ap->a_type != A_FLOAT)
+	    checkdelay = checktarget = ap->a_type == A_SEMI;
     }
     return (-1);
 }
@@ -446,16 +589,140 @@ void xeqlocator_post(t_xeqlocator *loc, char *name)
 	 loc->l_atprevious, loc->l_delta);
 }
 
+/* XEQ EVENT INDEX */
+
+#define XEQINDEX_INISIZE  256
+
+void xeqindex_init(t_xeqindex *ix)
+{
+    ix->ix_nevents = 0;
+    ix->ix_size = 0;
+    ix->ix_events = 0;
+}
+
+void xeqindex_free(t_xeqindex *ix)
+{
+    if (ix->ix_events)
+	freebytes(ix->ix_events, ix->ix_size * sizeof(*ix->ix_events));
+    xeqindex_init(ix);
+}
+
+static int xeqindex_grow(t_xeqindex *ix)
+{
+    int newsize = ix->ix_size ? 2 * ix->ix_size : XEQINDEX_INISIZE;
+    t_xeqevent *newevents = (ix->ix_events ?
+			     resizebytes(ix->ix_events,
+					 ix->ix_size * sizeof(*newevents),
+					 newsize * sizeof(*newevents)) :
+			     getbytes(newsize * sizeof(*newevents)));
+    if (!newevents)
+	return (0);
+    ix->ix_events = newevents;
+    ix->ix_size = newsize;
+    return (1);
+}
+
+/* Follows the rules of xeqit_donext(), except that a comma does not
+   start a new event.  Events without a target (a delay alone) are
+   indexed as well, since they carry time.  Returns number of events
+   or -1 if out of memory. */
+int xeqindex_build(t_xeqindex *ix, t_binbuf *bb)
+{
+    int natoms = bb ? binbuf_getnatom(bb) : 0;
+    t_atom *vec = bb ? binbuf_getvec(bb) : 0;
+    int ndx = 0, nevents = 0;
+    double onset = 0;
+    ix->ix_nevents = 0;
+    while (1)
+    {
+	t_xeqevent *ep;
+	while (ndx < natoms &&
+	       (vec[ndx].a_type == A_SEMI || vec[ndx].a_type == A_COMMA))
+	    ndx++;
+	if (nevents + 1 >= ix->ix_size && !xeqindex_grow(ix))
+	    return (-1);
+	ep = ix->ix_events + nevents;
+	if (ndx >= natoms)
+	{
+	    ep->e_onset = onset;
+	    ep->e_atstart = ep->e_atend = natoms;
+	    ep->e_attarget = -1;
+	    break;
+	}
+	ep->e_atstart = ndx;
+	if (vec[ndx].a_type == A_FLOAT)
+	{
+	    if (vec[ndx].a_w.w_float > 0)
+		onset += vec[ndx].a_w.w_float;
+	    while (++ndx < natoms && vec[ndx].a_type == A_FLOAT);
+	}
+	ep->e_onset = onset;
+	ep->e_attarget =
+	    (ndx < natoms && vec[ndx].a_type == A_SYMBOL ? ndx : -1);
+	while (ndx < natoms && vec[ndx].a_type != A_SEMI)
+	    ndx++;
+	ep->e_atend = ndx;
+	nevents++;
+    }
+    return (ix->ix_nevents = nevents);
+}
+
+/* return index of first event not earlier than given time
+   (ix_nevents if there is none) */
+int xeqindex_findtime(t_xeqindex *ix, double when)
+{
+    int lo = 0, hi = ix->ix_nevents;
+    while (lo < hi)
+    {
+	int mid = (lo + hi) >> 1;
+	if (ix->ix_events[mid].e_onset < when) lo = mid + 1;
+	else hi = mid;
+    }
+    return (lo);
+}
+
+/* return index of the event a given atom belongs to (ix_nevents if
+   the atom is past the last event) */
+int xeqindex_findatom(t_xeqindex *ix, int ndx)
+{
+    int lo = 0, hi = ix->ix_nevents;
+    while (lo < hi)
+    {
+	int mid = (lo + hi + 1) >> 1;
+	if (ix->ix_events[mid].e_atstart <= ndx) lo = mid;
+	else hi = mid - 1;
+    }
+    return (lo);
+}
+
 /* XEQ ITERATOR: STATE OF SEQUENCE TRAVERSAL */
 
 void xeqit_rewind(t_xeqit *it)
 {
-    xeqlocator_reset(&it->i_playloc);
+    if (it->i_reverse)
+	xeqlocator_hide(&it->i_playloc);  /* at the end */
+    else
+	xeqlocator_reset(&it->i_playloc);
     xeqlocator_reset(&it->i_blooploc);
     xeqlocator_hide(&it->i_elooploc);
     it->i_finish = 0;
     it->i_restarted = 1;
     it->i_loopover = 0;
+    it->i_nbatched = 0;
+}
+
+/* pass channel events gathered so far (the list is emptied first,
+   in case the hook causes another traversal step) */
+static void xeqit_flushbatch(t_xeqit *it)
+{
+    int nevents = it->i_nbatched;
+    if (nevents)
+    {
+	it->i_nbatched = 0;
+	if (it->i_batch_hook)
+	    XEQTRACE(XEQTRACE_BATCH, (t_xeq *)it->i_owner, it,
+		     it->i_batch_hook(it, nevents, it->i_batch));
+    }
 }
 
 static int xeqit_preloop(t_xeqit *it)
@@ -466,30 +733,57 @@ static int xeqit_preloop(t_xeqit *it)
 	xeqlocator_hide(&it->i_elooploc);  /* do not loop */
 	return (0);
     }
-    it->i_playloc.l_delay =  /* set predelay of a loop: */
-	it->i_elooploc.l_delta - it->i_elooploc.l_delay;
+    xeqit_flushbatch(it);  /* the tail of a loop */
+    /* set predelay of a loop, so that every pass takes exactly the time
+       between loop locators, however the deltas add up */
+    it->i_playloc.l_delay = it->i_elooploc.l_when - it->i_playloc.l_when;
+    if (it->i_playloc.l_delay < 0)
+	it->i_playloc.l_delay = 0;
     it->i_loopover = 1;
     if (it->i_delay_hook)
     {
 	t_atom at;
 	SETFLOAT(&at, it->i_playloc.l_delay);
-	it->i_delay_hook(it, 1, &at);
+	XEQTRACE(XEQTRACE_DELAY, (t_xeq *)it->i_owner, it,
+		 it->i_delay_hook(it, 1, &at));
     }
     return (1);
 }
 
+/* staged sequence (see HOT SWAP below) */
+typedef struct _xeqswap
+{
+    t_binbuf     *s_binbuf;
+    double        s_when;        /* install time, negative: at loop wrap */
+    t_xeqindex    s_newindex;
+    t_xeqindex    s_oldindex;    /* of host's sequence */
+    unsigned int  s_generation;  /* old index is stale, unless these two */
+    int           s_oldnatoms;   /* match host's sequence */
+} t_xeqswap;
+
+static void xeq_swapin(t_xeq *host, t_xeqit *caller, double from);
+static int xeq_swapdue(t_xeq *host, t_xeqit *it);
+
 static int xeqit_postloop(t_xeqit *it)
 {
-    if (it->i_loopover_hook) it->i_loopover_hook(it);
+    t_xeq *owner = (t_xeq *)it->i_owner;
+    if (it->i_loopover_hook)
+	XEQTRACE(XEQTRACE_LOOPOVER, owner, it, it->i_loopover_hook(it));
     /* clear loopover flag _after_ applying the hook, in order
        to enable resolving startloop()/postloop() confusion */
     it->i_loopover = 0;  /* LATER sort out reentrancy etc. */
+    /* a sequence staged for loop wrap goes in here (play locator is
+       set to loop start right below) */
+    if (owner->x_swap && it == &owner->x_autoit &&
+	owner->x_swap->s_when < 0)
+	xeq_swapin(owner, it, -1);
     xeqlocator_settolocator(&it->i_playloc, &it->i_blooploc);
     if (it->i_delay_hook)
     {
 	t_atom at;
 	SETFLOAT(&at, it->i_playloc.l_delay);
-	it->i_delay_hook(it, 1, &at);
+	XEQTRACE(XEQTRACE_DELAY, (t_xeq *)it->i_owner, it,
+		 it->i_delay_hook(it, 1, &at));
     }
     return (1);
 }
@@ -511,13 +805,15 @@ static int xeqit_startloop(t_xeqit *it)
 
     /* from postloop */
     it->i_loopover = 0;  /* LATER sort out reentrancy etc. */
-    if (it->i_loopover_hook) it->i_loopover_hook(it);
+    if (it->i_loopover_hook)
+	XEQTRACE(XEQTRACE_LOOPOVER, (t_xeq *)it->i_owner, it, it->i_loopover_hook(it));
     xeqlocator_settolocator(&it->i_playloc, &it->i_blooploc);
     if (it->i_delay_hook)
     {
 	t_atom at;
 	SETFLOAT(&at, it->i_playloc.l_delay);
-	it->i_delay_hook(it, 1, &at);
+	XEQTRACE(XEQTRACE_DELAY, (t_xeq *)it->i_owner, it,
+		 it->i_delay_hook(it, 1, &at));
     }
     return (1);
 }
@@ -528,7 +824,7 @@ static void xeqit_stoploop(t_xeqit *it)
     xeqlocator_hide(&it->i_elooploc);  /* do not loop */
 }
 
-int xeqit_loop(t_xeqit *it, t_float lpos, t_float rpos)
+int xeqit_loop(t_xeqit *it, double lpos, double rpos)
 {
     if (lpos < 0 || rpos <= lpos)
     {
@@ -560,12 +856,136 @@ void xeqit_sethooks(t_xeqit *it, t_xeqithook_delay dhook,
     it->i_loopover_hook = lhook;
 }
 
+/* Batched dispatch is independent of other hooks, and stays in effect
+   until cleared.  In this mode, zero delays are not passed to delay hook,
+   and channel events of a tick go to batch hook instead of message hook,
+   in one call per tick (see xeqit_donext()). */
+void xeqit_setbatchhook(t_xeqit *it, t_xeqithook_batch bhook)
+{
+    xeqit_flushbatch(it);
+    it->i_batch_hook = bhook;
+}
+
 void xeqit_settoit(t_xeqit *it, t_xeqit *reference)
 {
     it->i_finish = reference->i_finish;
     xeqlocator_settolocator(&it->i_playloc, &reference->i_playloc);
 }
 
+/* SEQUENCE VERSIONS */
+
+/* Whenever a host's sequence is replaced, cleared or reloaded, the host
+   gets a new generation number.  Friends cache it, and revalidate only if
+   the number they have seen is stale (see xeq_derived_validate()).  Since
+   the counter is global, no two hosts ever share a generation, and
+   switching to another host is caught as well. */
+static unsigned int xeq_lastgeneration = 0;
+
+/* a host of any xeq, base, or friend's base */
+t_xeq *xeq_gethost(t_xeq *x)
+{
+    t_hyphen *self = x->x_this.x_self;
+    return (self && self->x_host ? (t_xeq *)self->x_host : x);
+}
+
+void xeq_touch(t_xeq *x)
+{
+    xeq_gethost(x)->x_generation = ++xeq_lastgeneration;
+}
+
+/* PERFORMANCE COUNTERS */
+
+#ifdef XEQ_STATS
+
+void xeqstats_reset(t_xeqstats *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+static void xeqstats_add(t_xeqstats *to, t_xeqstats *from)
+{
+    to->s_nevents += from->s_nevents;
+    to->s_nticks += from->s_nticks;
+    if (from->s_maxpertick > to->s_maxpertick)
+	to->s_maxpertick = from->s_maxpertick;
+    to->s_steptime += from->s_steptime;
+    if (from->s_maxsteptime > to->s_maxsteptime)
+	to->s_maxsteptime = from->s_maxsteptime;
+    to->s_nfires += from->s_nfires;
+    to->s_latetime += from->s_latetime;
+    if (from->s_maxlatetime > to->s_maxlatetime)
+	to->s_maxlatetime = from->s_maxlatetime;
+    to->s_nseeks += from->s_nseeks;
+    to->s_seektime += from->s_seektime;
+    if (from->s_maxseektime > to->s_maxseektime)
+	to->s_maxseektime = from->s_maxseektime;
+}
+
+static int xeqedit_bytes(struct _xeqedit *e);
+static int xeqswap_bytes(struct _xeqswap *sw);
+
+/* memory held by a base, apart from its host's sequence */
+static double xeqstats_basebytes(t_xeq *base)
+{
+    return (sizeof(*base) + base->x_heldbytes +
+	    (base->x_autoit.i_index.ix_size + base->x_stepit.i_index.ix_size +
+	     base->x_walkit.i_index.ix_size) * sizeof(t_xeqevent) +
+	    (base->x_edit ? xeqedit_bytes(base->x_edit) : 0));
+}
+
+static int xeqhook_stats_collect(t_pd *f, void *s)
+{
+    t_xeq *base = XEQ_BASE(f);
+    int nbases = XEQ_NBASES(f);
+    if (base)
+    {
+	while (nbases-- > 0)
+	{
+	    ((t_xeqstats *)s)->s_nbytes += xeqstats_basebytes(base);
+	    xeqstats_add(s, &(base++)->x_stats);
+	}
+    }
+    return (1);
+}
+
+static int xeqhook_stats_reset(t_pd *f, void *dummy)
+{
+    t_xeq *base = XEQ_BASE(f);
+    int nbases = XEQ_NBASES(f);
+    if (base)
+	while (nbases-- > 0) xeqstats_reset(&(base++)->x_stats);
+    return (1);
+}
+
+/* counters of a host, summed with those of all its friends */
+void xeqstats_collect(t_xeq *host, t_xeqstats *s)
+{
+    xeqstats_reset(s);
+    xeqstats_add(s, &host->x_stats);
+    s->s_nbytes = xeqstats_basebytes(host) +
+	(host->x_binbuf ? binbuf_getnatom(host->x_binbuf) * sizeof(t_atom) : 0) +
+	(host->x_swap ? xeqswap_bytes(host->x_swap) : 0) +
+	(host->x_find ? xeqfind_bytes(host->x_find) : 0);
+    hyphen_forallfriends((t_hyphen *)host, xeqhook_stats_collect, s);
+}
+
+void xeqstats_resetall(t_xeq *host)
+{
+    xeqstats_reset(&host->x_stats);
+    hyphen_forallfriends((t_hyphen *)host, xeqhook_stats_reset, 0);
+}
+
+static void xeqstats_seek(t_xeq *x, double started)
+{
+    double elapsed = (xeq_realtime() - started) * 1000.;
+    x->x_stats.s_nseeks++;
+    x->x_stats.s_seektime += elapsed;
+    if (elapsed > x->x_stats.s_maxseektime)
+	x->x_stats.s_maxseektime = elapsed;
+}
+
+#endif
+
 /* MULTICASTING HOOKS */
 
 static void xeq_setbinbuf(t_xeq *x, t_binbuf *bb);
@@ -647,7 +1067,14 @@ static void xeqithook_playmessage(t_xeqit *it,
     {
 	int status = it->i_status;
 	if (dest) typedmess(dest, &s_list, argc, argv);
-	if (status)
+	if (status && x->x_packed)
+	{
+	    t_atom at[XEQ_PACKED_MAXATOMS];
+	    outlet_list(x->x_midiout, &s_list,
+			xeq_packmidi(at, x->x_packed, status, it->i_channel,
+				     it->i_data1, it->i_data2), at);
+	}
+	else if (status)
 	{
 	    status |= it->i_channel;
 	    outlet_float(x->x_midiout, status);
@@ -659,40 +1086,34 @@ static void xeqithook_playmessage(t_xeqit *it,
 	typedmess(dest, argv->a_w.w_symbol, argc-1, argv+1);
 }
 
-static void xeqithook_findmessage(t_xeqit *it,
-				  t_symbol *target, int argc, t_atom *argv)
+static t_atom *xeqit_retromessage(t_atom *buf, int argc, t_atom *argv,
+				  int status, int data2);
+/* a chord (or any other group of simultaneous channel events) goes out
+   as a single list of midi bytes, or of packed events, if so requested */
+static void xeqithook_playbatch(t_xeqit *it, int nevents, t_xeqmidi *events)
 {
-    if (it->i_messtarget != &s_ && it->i_messtarget != target) return;
-    if (argc > it->i_messlength) argc = it->i_messlength;
-    if (argc == it->i_messlength)
+    t_xeq *x = (t_xeq *)it->i_owner;
+    t_atom at[XEQ_MAXBATCH * XEQ_PACKED_MAXATOMS];
+    int mode = (x->x_packed ? x->x_packed : XEQ_PACKED_RAW), natoms = 0;
+    t_xeqmidi *mp;
+    for (mp = events; mp < events + nevents; mp++)
     {
-	t_atom *messp = it->i_message;
-	while (argc--)
+	t_pd *dest = mp->m_target->s_thing;
+	if (dest && mp->m_atmessage + mp->m_count <=
+	    binbuf_getnatom(x->x_binbuf))
 	{
-	    if (argv->a_type == A_FLOAT)
-	    {
-		if (messp->a_type != A_FLOAT ||
-		    argv->a_w.w_float != messp->a_w.w_float) break;
-	    }
-	    else if (argv->a_type == A_SYMBOL)
-	    {
-		if (messp->a_type != A_SYMBOL ||
-		    argv->a_w.w_symbol != messp->a_w.w_symbol) break;
-	    }
-	    else break;
-	    argv++;
-	    messp++;
+	    t_atom buf[4], *argv = binbuf_getvec(x->x_binbuf)
+		+ mp->m_atmessage;
+	    if (it->i_reverse &&
+		(mp->m_status == 0x80 || mp->m_status == 0x90))
+		argv = xeqit_retromessage(buf, mp->m_count, argv,
+					  mp->m_status, mp->m_data2);
+	    typedmess(dest, &s_list, mp->m_count, argv);
 	}
-	if (argc < 0) it->i_finish = -1;
-    }
-}
-
-static void xeqithook_findevent(t_xeqit *it,
-				t_symbol *target, int argc, t_atom *argv)
-{
-    if (it->i_status) {
-	t_xeq *x = (t_xeq *)it->i_owner;
+	natoms += xeq_packmidi(at + natoms, mode, mp->m_status,
+			       mp->m_channel, mp->m_data1, mp->m_data2);
     }
+    outlet_list(x->x_midiout, &s_list, natoms, at);
 }
 
 static void xeqithook_playfinish(t_xeqit *it)
@@ -723,14 +1144,296 @@ static void xeqithook_loopover(t_xeqit *it)
 
 /* SEQUENCE TRAVERSAL */
 
+static int xeqit_applypp(t_xeqit *it, t_symbol *target, int status,
+			 int *channelp, int *data1p, int *data2p)
+{
+    int result;
+    XEQTRACE(XEQTRACE_APPLYPP, (t_xeq *)it->i_owner, it,
+	     result = it->i_applypp_hook(it, target, status,
+					 channelp, data1p, data2p));
+    return (result);
+}
+
+/* RETROGRADE TRAVERSAL */
+
+/* A retrograde position is a boundary between events: i_event is
+   the number of the next event in forward order, and the one before it
+   is played next.  The play locator is kept at event i_event, as
+   a forward locator would be, but its l_when is current time, and
+   l_delay is the time left until the event before (or until zero).
+   If the locator was moved by other means (locating, a hot swap), the
+   boundary is taken from it.  Steps are O(1), once the event index is
+   built.  Loop locators are ignored in retrograde.
+   LATER let hot swaps take retrograde time into account */
+
+#define XEQ_RETROVELOCITY  64
+
+static void xeqit_initreverse(t_xeqit *it)
+{
+    it->i_reverse = 0;
+    it->i_event = 0;
+    it->i_eventatnext = -2;
+    xeqindex_init(&it->i_index);
+    it->i_indexgeneration = 0;
+    it->i_indexnatoms = -1;
+}
+
+static void xeqit_retroset(t_xeqit *it, int k, double now)
+{
+    t_xeqindex *ix = &it->i_index;
+    t_xeqlocator *loc = &it->i_playloc;
+    xeqlocator_settoevent(loc, ix, k);
+    loc->l_when = now;
+    if ((loc->l_delay = now - (k ? ix->ix_events[k - 1].e_onset : 0)) < 0)
+	loc->l_delay = 0;
+    it->i_event = k;
+    it->i_eventatnext = loc->l_atnext;
+}
+
+/* returns an up to date event index (null if out of memory), with
+   i_event in sync with the play locator */
+static t_xeqindex *xeqit_retrosync(t_xeqit *it)
+{
+    t_xeqindex *ix = &it->i_index;
+    t_xeqlocator *loc = &it->i_playloc;
+    t_xeq *host = xeq_gethost((t_xeq *)it->i_owner);
+    int natoms;
+    if (!loc->l_binbuf)
+	return (0);
+    natoms = binbuf_getnatom(loc->l_binbuf);
+    if (it->i_indexgeneration != host->x_generation ||
+	it->i_indexnatoms != natoms)
+    {
+	if (xeqindex_build(ix, loc->l_binbuf) < 0)
+	    return (0);
+	it->i_indexgeneration = host->x_generation;
+	it->i_indexnatoms = natoms;
+	it->i_eventatnext = -2;
+    }
+    if (loc->l_atnext != it->i_eventatnext)
+    {
+	if (loc->l_atnext < 0 || loc->l_atnext >= natoms)  /* at the end */
+	    xeqit_retroset(it, ix->ix_nevents,
+			   ix->ix_events[ix->ix_nevents].e_onset);
+	else
+	    xeqit_retroset(it, xeqindex_findatom(ix, loc->l_atnext),
+			   loc->l_when);
+    }
+    return (ix);
+}
+
+/* Iterator turns around at current time.  A forward locator is restored
+   from the retrograde one, with the delay left until the next event. */
+void xeqit_setreverse(t_xeqit *it, int flag)
+{
+    t_xeqindex *ix;
+    flag = (flag != 0);
+    if (flag == it->i_reverse)
+	return;
+    xeqit_flushbatch(it);
+    it->i_finish = 0;
+    if (flag)
+	it->i_eventatnext = -2;  /* locator is forward: take the boundary */
+    if (!(ix = xeqit_retrosync(it)))
+	return;
+    if (!flag)
+    {
+	t_xeqlocator *loc = &it->i_playloc;
+	double now = loc->l_when;
+	int k = it->i_event;
+	xeqlocator_settoevent(loc, ix, k);
+	loc->l_when = now;
+	if ((loc->l_delay = ix->ix_events[k].e_onset - now) < 0)
+	    loc->l_delay = 0;
+    }
+    it->i_reverse = flag;
+}
+
+/* In retrograde, note-ons and note-offs swap roles, so that notes are
+   paired by the noteon buffer as usual.  A note-off turned note-on keeps
+   its velocity, if any (LATER take it from the matching note-on).
+   Returns nonzero if the event was swapped. */
+static int xeqit_retroswap(int *statusp, int *data2p)
+{
+    if (*statusp == 0x90 && *data2p > 0)
+	*statusp = 0x80;
+    else if (*statusp == 0x80 || *statusp == 0x90)
+    {
+	*statusp = 0x90;
+	if (*data2p <= 0) *data2p = XEQ_RETROVELOCITY;
+    }
+    else return (0);
+    return (1);
+}
+
+/* message of a swapped note event, as passed to its target */
+static t_atom *xeqit_retromessage(t_atom *buf, int argc, t_atom *argv,
+				  int status, int data2)
+{
+    if (argc != 4)
+	return (argv);
+    buf[0] = argv[0];
+    buf[1] = argv[1];
+    buf[2] = argv[2];
+    buf[3] = argv[3];
+    SETFLOAT(&buf[0], status);
+    SETFLOAT(&buf[2], data2);
+    return (buf);
+}
+
+/* true if a hook moved the locator, or changed the sequence */
+static int xeqit_retromoved(t_xeqit *it)
+{
+    t_xeq *owner = (t_xeq *)it->i_owner;
+    return (it->i_eventatnext != it->i_playloc.l_atnext ||
+	    xeq_gethost(owner)->x_generation != it->i_indexgeneration ||
+	    !owner->x_binbuf ||
+	    binbuf_getnatom(owner->x_binbuf) != it->i_indexnatoms);
+}
+
+/* Plays messages of the event before the boundary, in forward order,
+   then moves the boundary back, and passes the delay until the event
+   before, as xeqit_dodonext() does.  Returns after the delay hook,
+   or when a message hook restarts the iterator. */
+static void xeqit_doprevious(t_xeqit *it)
+{
+    t_xeq *owner = (t_xeq *)it->i_owner;
+    t_xeqlocator *loc = &it->i_playloc;
+    t_xeqindex *ix;
+    if (it->i_finish)
+    {
+	if (it->i_finish == 1) goto end;
+	else return;  /* forced: do not perform normal finishing */
+    }
+    if (!owner->x_binbuf) goto end;
+    while (1)
+    {
+	t_xeqevent *ep;
+	t_atom at;
+	double delay;
+	int k, ndx;
+	if (!(ix = xeqit_retrosync(it)) || (k = it->i_event) <= 0)
+	    goto end;
+	ep = ix->ix_events + --k;
+	xeqlocator_settoevent(loc, ix, k);
+	it->i_event = k;
+	it->i_eventatnext = loc->l_atnext;
+	for (ndx = ep->e_attarget; ndx >= 0 && ndx < ep->e_atend; ndx++)
+	{
+	    /* a message: target's arguments, or atoms after a comma */
+	    t_atom *vec = binbuf_getvec(owner->x_binbuf), *ap, *argv;
+	    t_atom buf[4];
+	    t_symbol *target = vec[ep->e_attarget].a_w.w_symbol;
+	    int status, channel, data1, data2, count, wasrestarted;
+	    if (ndx == ep->e_attarget) ndx++;
+	    for (count = 0, ap = argv = vec + ndx;
+		 ndx + count < ep->e_atend &&
+		     (ap->a_type == A_FLOAT || ap->a_type == A_SYMBOL);
+		 count++, ap++);
+	    if (!count)
+		continue;
+	    ap = argv;
+	    if (ap->a_type == A_FLOAT &&
+		xeq_listparse(count, ap, &status, &channel, &data1, &data2))
+	    {
+		int swapped = xeqit_retroswap(&status, &data2);
+		if (!it->i_applypp_hook ||
+		    xeqit_applypp(it, target, status,
+				  &channel, &data1, &data2))
+		{
+		    if (swapped)
+			argv = xeqit_retromessage(buf, count, ap,
+						  status, data2);
+		    it->i_status = status;
+		    it->i_channel = channel;
+		    it->i_data1 = data1;
+		    it->i_data2 = data2;
+		}
+		else it->i_status = 0;
+	    }
+	    else it->i_status = 0;
+	    if (it->i_batch_hook)
+	    {
+		if (it->i_status)
+		{
+		    t_xeqmidi *mp;
+		    if (it->i_nbatched == XEQ_MAXBATCH)
+			xeqit_flushbatch(it);
+		    mp = &it->i_batch[it->i_nbatched++];
+		    mp->m_target = target;
+		    mp->m_atmessage = ndx;
+		    mp->m_count = count;
+		    mp->m_status = it->i_status;
+		    mp->m_channel = channel;
+		    mp->m_data1 = data1;
+		    mp->m_data2 = data2;
+		    XEQSTATS_EVENT(owner);
+		    ndx += count;
+		    continue;
+		}
+		xeqit_flushbatch(it);  /* keep the order of other messages */
+	    }
+	    wasrestarted = it->i_restarted;
+	    it->i_restarted = 0;
+	    XEQSTATS_EVENT(owner);
+	    if (it->i_message_hook)
+		XEQTRACE(XEQTRACE_MESSAGE, owner, it,
+			 it->i_message_hook(it, target, count, argv));
+	    if (it->i_restarted)
+		return;
+	    it->i_restarted = wasrestarted;
+	    if (xeqit_retromoved(it))
+		break;
+	    ndx += count;
+	}
+	if (xeqit_retromoved(it))
+	{
+	    /* go on from wherever the locator is now */
+	    if (!(ix = xeqit_retrosync(it)))
+		goto end;
+	    k = it->i_event;
+	    delay = loc->l_delay;
+	}
+	else loc->l_delay = delay = ep->e_onset - (k ? ep[-1].e_onset : 0);
+	if (!k && delay <= 0)
+	    goto end;
+	if (it->i_batch_hook)
+	{
+	    if (delay <= 0)
+		continue;  /* same tick: keep gathering */
+	    xeqit_flushbatch(it);
+	}
+	if (it->i_delay_hook)
+	{
+	    SETFLOAT(&at, delay);
+	    XEQTRACE(XEQTRACE_DELAY, owner, it, it->i_delay_hook(it, 1, &at));
+	}
+	return;
+    }
+end:
+    xeqit_flushbatch(it);
+    /* at the start, as after rewinding */
+    xeqlocator_reset(loc);
+    it->i_event = 0;
+    it->i_eventatnext = loc->l_atnext;
+    it->i_finish = 1;
+    if (it->i_finish_hook)
+	XEQTRACE(XEQTRACE_FINISH, owner, it, it->i_finish_hook(it));
+}
+
 /* this is qlist_donext(), somewhat modified */
 /* LATER abstract this into a generic binbuf parsing routine
    (current version of mfbb_parse() ignores nonmidi events). */
-void xeqit_donext(t_xeqit *it)
+static void xeqit_dodonext(t_xeqit *it)
 {
     t_xeq *owner = (t_xeq *)it->i_owner;
     t_symbol *target = 0;
     int status, data1, data2, channel;
+    if (it->i_reverse)
+    {
+	xeqit_doprevious(it);
+	return;
+    }
     if (it->i_finish)
     {
 	if (it->i_finish == 1) goto end;
@@ -767,6 +1470,7 @@ void xeqit_donext(t_xeqit *it)
 
 	if (!target && ap->a_type == A_FLOAT)
 	{
+	    t_atom at;
 	    /* we are at the first atom of a delta vector */
     	    ap2 = ap + 1;
     	    onset2 = onset + 1;
@@ -774,8 +1478,28 @@ void xeqit_donext(t_xeqit *it)
     	    	onset2++, ap2++;
 	    it->i_playloc.l_atprevious = it->i_playloc.l_atnext;
     	    it->i_playloc.l_atnext = onset2;
-	    it->i_playloc.l_delay = it->i_playloc.l_delta = ap->a_w.w_float;
-	    if (it->i_delay_hook) it->i_delay_hook(it, onset2-onset, ap);
+	    it->i_playloc.l_delay = it->i_playloc.l_delta =
+		(ap->a_w.w_float > 0 ? ap->a_w.w_float : 0);
+	    if (owner->x_swap && it == &owner->x_autoit &&
+		owner->x_swap->s_when >= 0 && xeq_swapdue(owner, it))
+	    {
+		/* old sequence is gone, pass the delay until next event
+		   of the new one; the batch points into the old one */
+		xeqit_flushbatch(it);
+		xeq_swapin(owner, it, owner->x_swap->s_when);
+		SETFLOAT(&at, it->i_playloc.l_delay);
+		ap = &at;
+		onset = onset2 - 1;
+	    }
+	    if (it->i_batch_hook)
+	    {
+		if (it->i_playloc.l_delay <= 0)
+		    continue;  /* same tick: keep gathering */
+		xeqit_flushbatch(it);
+	    }
+	    if (it->i_delay_hook)
+		XEQTRACE(XEQTRACE_DELAY, owner, it,
+			 it->i_delay_hook(it, onset2-onset, ap));
     	    return;
     	}
 
@@ -810,7 +1534,7 @@ void xeqit_donext(t_xeqit *it)
 	if (ap->a_type == A_FLOAT &&
 	    xeq_listparse(count, ap, &status, &channel, &data1, &data2) &&
 	    (!it->i_applypp_hook ||
-	     it->i_applypp_hook(it, target, status, &channel, &data1, &data2)))
+	     xeqit_applypp(it, target, status, &channel, &data1, &data2)))
 	{
 #if 0
 	    post("%d %d %d %d", status, channel, data1, data2);
@@ -822,9 +1546,35 @@ void xeqit_donext(t_xeqit *it)
 	}
 	else it->i_status = 0;
 
+	if (it->i_batch_hook)
+	{
+	    if (it->i_status)
+	    {
+		t_xeqmidi *mp;
+		if (it->i_nbatched == XEQ_MAXBATCH)
+		    xeqit_flushbatch(it);
+		mp = &it->i_batch[it->i_nbatched++];
+		mp->m_target = target;
+		mp->m_atmessage = onset;
+		mp->m_count = count;
+		mp->m_status = status;
+		mp->m_channel = channel;
+		mp->m_data1 = data1;
+		mp->m_data2 = data2;
+		XEQSTATS_EVENT(owner);
+		it->i_playloc.l_atprevious = it->i_playloc.l_atnext;
+		it->i_playloc.l_atnext = onset2;
+		continue;
+	    }
+	    xeqit_flushbatch(it);  /* keep the order of other messages */
+	}
+
 	wasrestarted = it->i_restarted;
 	it->i_restarted = 0;
-	if (it->i_message_hook) it->i_message_hook(it, target, count, ap);
+	XEQSTATS_EVENT(owner);
+	if (it->i_message_hook)
+	    XEQTRACE(XEQTRACE_MESSAGE, owner, it,
+		     it->i_message_hook(it, target, count, ap));
 	it->i_playloc.l_atprevious = it->i_playloc.l_atnext;
 	it->i_playloc.l_atnext = onset2;  /* index to next separator */
 	if (it->i_restarted)
@@ -833,9 +1583,49 @@ void xeqit_donext(t_xeqit *it)
     }  /* while (1); never falls through */
 
 end:
+    xeqit_flushbatch(it);
     xeqlocator_hide(&it->i_playloc);
     it->i_finish = 1;
-    if (it->i_finish_hook) it->i_finish_hook(it);
+    if (it->i_finish_hook)
+	XEQTRACE(XEQTRACE_FINISH, owner, it, it->i_finish_hook(it));
+}
+
+/* Playback steps are measured, walking (rendering, searching, etc.) is
+   not.  A clock fire is late by the real time elapsed since the clock
+   was set, less the delay requested. */
+void xeqit_donext(t_xeqit *it)
+{
+#ifdef XEQ_STATS
+    t_xeq *owner = (t_xeq *)it->i_owner;
+    if (it == &owner->x_autoit || it == &owner->x_stepit)
+    {
+	t_xeqstats *s = &owner->x_stats;
+	double started = xeq_realtime(), finished, elapsed;
+	double nevents = s->s_nevents;
+	if (it == &owner->x_autoit && s->s_realclockset > 0)
+	{
+	    double late = (started - s->s_realclockset) * 1000.
+		- owner->x_clockdelay;
+	    if (late < 0) late = 0;
+	    s->s_nfires++;
+	    s->s_latetime += late;
+	    if (late > s->s_maxlatetime) s->s_maxlatetime = late;
+	    s->s_realclockset = 0;
+	}
+	XEQTRACE(XEQTRACE_STEP, owner, it, xeqit_dodonext(it));
+	finished = xeq_realtime();
+	elapsed = (finished - started) * 1000.;
+	s->s_nticks++;
+	s->s_steptime += elapsed;
+	if (elapsed > s->s_maxsteptime) s->s_maxsteptime = elapsed;
+	if (s->s_nevents - nevents > s->s_maxpertick)
+	    s->s_maxpertick = s->s_nevents - nevents;
+	if (it == &owner->x_autoit && owner->x_whenclockset != 0)
+	    s->s_realclockset = finished;
+	return;
+    }
+#endif
+    XEQTRACE(XEQTRACE_STEP, (t_xeq *)it->i_owner, it, xeqit_dodonext(it));
 }
 
 /* CLOCK HANDLER */
@@ -843,7 +1633,7 @@ end:
 void xeq_tick(t_xeq *x)
 {
     x->x_whenclockset = 0;
-    xeqit_donext(&x->x_autoit);
+    XEQTRACE(XEQTRACE_TICK, x, 0, xeqit_donext(&x->x_autoit));
 }
 
 /* CREATION/DESTRUCTION */
@@ -873,6 +1663,20 @@ static void xeq_newbase(t_xeq *x, t_binbuf *bb, t_method tickmethod)
     x->x_clockdelay = 0;
     x->x_clock = tickmethod ? clock_new(x, tickmethod) : 0;
     xeq_noteons_clear(x);
+    x->x_renderout = 0;
+    x->x_render = 0;
+    x->x_edit = 0;
+    x->x_swap = 0;
+    x->x_find = 0;
+    x->x_generation = 0;
+    x->x_checksum = 0;
+    x->x_checkedgeneration = 0;
+    x->x_checkednatoms = -1;
+    x->x_packed = XEQ_PACKED_OFF;
+    x->x_heldbytes = 0;
+#ifdef XEQ_STATS
+    xeqstats_reset(&x->x_stats);
+#endif
     x->x_ttp = 0;
     x->x_transpo = 0;
     x->x_autoit.i_owner = x;
@@ -885,6 +1689,12 @@ static void xeq_newbase(t_xeq *x, t_binbuf *bb, t_method tickmethod)
     xeqit_sethooks(&x->x_stepit, xeqithook_stepdelay, xeqithook_applypp,
 		   xeqithook_playmessage, xeqithook_stepfinish, 0);
     xeqit_sethooks(&x->x_walkit, 0, 0, 0, 0, 0);
+    x->x_autoit.i_batch_hook = 0;
+    x->x_stepit.i_batch_hook = 0;
+    x->x_walkit.i_batch_hook = 0;
+    xeqit_initreverse(&x->x_autoit);
+    xeqit_initreverse(&x->x_stepit);
+    xeqit_initreverse(&x->x_walkit);
     xeqit_rewind(&x->x_autoit);
     xeqit_rewind(&x->x_stepit);
     xeqit_rewind(&x->x_walkit);
@@ -895,22 +1705,32 @@ static void *xeq_new(t_symbol *name)
     t_xeq *x = (t_xeq *)hyphen_new(xeq_class, 0);
     hyphen_attach((t_hyphen *)x, name);
     xeq_newbase(x, binbuf_new(), (t_method)xeq_tick);
+    xeq_touch(x);
     hyphen_forallfriends((t_hyphen *)x, xeqhook_multicast_setbinbuf, 0);
     outlet_new((t_object *)x, &s_list);
     x->x_midiout = outlet_new((t_object *)x, &s_float);
     x->x_bangout = outlet_new((t_object *)x, &s_bang);
+    x->x_renderout = outlet_new((t_object *)x, &s_list);
     return (x);
 }
 
+static void xeqedit_free(struct _xeqedit *e);
 static void xeq_freebase(t_xeq *x)
 {
     if (x->x_clock) clock_free(x->x_clock);
+    if (x->x_edit) xeqedit_free(x->x_edit);
+    if (x->x_find) xeqfind_free(x->x_find);
+    xeqindex_free(&x->x_autoit.i_index);
+    xeqindex_free(&x->x_stepit.i_index);
+    xeqindex_free(&x->x_walkit.i_index);
     xeq_window_unbind(x);
 }
 
+static void xeqswap_free(t_xeqswap *sw);
 static void xeq_free(t_xeq *x)
 {
     t_binbuf *bb = x->x_binbuf;
+    if (x->x_swap) xeqswap_free(x->x_swap);
     x->x_binbuf = 0;
     hyphen_forallfriends((t_hyphen *)x, xeqhook_multicast_setbinbuf, 0);
     hyphen_detach((t_hyphen *)x);
@@ -941,15 +1761,15 @@ void xeq_transpo(t_xeq *x, t_floatarg f)
 
 void xeq_tempo(t_xeq *x, t_floatarg f)
 {
-    float newtempo;
+    double newtempo;
     if (f == 0) f = 1;  /* tempo message without argument (FIXME) */
     else if (f < 1e-20) f = 1e-20;
     else if (f > 1e20) f = 1e20;
     newtempo = 1./f;
     if (x->x_whenclockset != 0)
     {
-    	float elapsed = clock_gettimesince(x->x_whenclockset);
-    	float left = x->x_clockdelay - elapsed;
+	double elapsed = clock_gettimesince(x->x_whenclockset);
+	double left = x->x_clockdelay - elapsed;
     	if (left < 0) left = 0;
     	else left *= newtempo / x->x_tempo;
     	clock_delay(x->x_clock, x->x_clockdelay = left);
@@ -958,22 +1778,42 @@ void xeq_tempo(t_xeq *x, t_floatarg f)
     x->x_tempo = newtempo;
 }
 
-/* PLAYBACK CONTROL METHODS */
+static void xeq_packed(t_xeq *x, t_symbol *s, int ac, t_atom *av)
+{
+    int mode = xeq_packedmode(ac, av);
+    if (mode >= 0) x->x_packed = mode;
+}
 
-static void xeq_flush(t_xeq *x)
+static void xeq_batch(t_xeq *x, t_floatarg f)
+{
+    xeqit_setbatchhook(&x->x_autoit, f != 0 ? xeqithook_playbatch : 0);
+}
+
+/* PLAYBACK CONTROL METHODS */
+
+static void xeq_flush(t_xeq *x)
 {
     int channel, key, transposed;
     for (channel = 0; channel < 16; channel++)
     {
 	for (key = 0; key < 128; key++)
 	{
-	    if ((transposed = x->x_noteons[channel][key]) >= 0)
+	    if ((transposed = x->x_noteons[channel][key]) < 0)
+		continue;
+	    if (x->x_packed)
+	    {
+		t_atom at[XEQ_PACKED_MAXATOMS];
+		outlet_list(x->x_midiout, &s_list,
+			    xeq_packmidi(at, x->x_packed,
+					 0x90, channel, transposed, 0), at);
+	    }
+	    else
 	    {
 		outlet_float(x->x_midiout, 0x90 | channel);
 		outlet_float(x->x_midiout, transposed);
 		outlet_float(x->x_midiout, 0);
-		x->x_noteons[channel][key] = -1;
 	    }
+	    x->x_noteons[channel][key] = -1;
 	}
     }
 }
@@ -984,21 +1824,62 @@ void xeq_rewind(t_xeq *x)
     xeqit_rewind(&x->x_stepit);  /* LATER rethink */
     if (x->x_clock) clock_unset(x->x_clock);
     x->x_whenclockset = 0;
+#ifdef XEQ_STATS
+    x->x_stats.s_realclockset = 0;
+#endif
+}
+
+/* to be called whenever atom-indices of a sequence become invalid */
+void xeq_rewindall(t_xeq *x)
+{
+    xeq_rewind(x);
+    hyphen_forallfriends((t_hyphen *)x, xeqhook_multicast_rewind, 0);
+}
+
+/* Host takes over a binbuf, which replaces its sequence, and the old
+   one is freed.  Host and friends are rewound. */
+void xeq_setsequence(t_xeq *x, t_binbuf *bb)
+{
+    t_xeq *host = xeq_gethost(x);
+    t_binbuf *oldbb = host->x_binbuf;
+    xeq_setbinbuf(host, bb);
+    hyphen_forallfriends((t_hyphen *)host, xeqhook_multicast_setbinbuf, 0);
+    xeq_touch(host);
+    xeq_rewindall(host);
+    if (oldbb) binbuf_free(oldbb);
 }
 
+/* logical delay left until next event of auto playback (or zero,
+   if not playing) */
+double xeq_delayleft(t_xeq *x)
+{
+    double left;
+    if (x->x_whenclockset == 0)
+	return (0);
+    left = x->x_clockdelay - clock_gettimesince(x->x_whenclockset);
+    return (left > 0 ? left / x->x_tempo : 0);
+}
+
+/* Play locator is moved to the time of stopping, next event's onset
+   (l_when + l_delay) stays the same. */
 void xeq_stop(t_xeq *x)
 {
     x->x_autoit.i_restarted = 1;  /* LATER rethink */
     if (x->x_clock) clock_unset(x->x_clock);
+#ifdef XEQ_STATS
+    x->x_stats.s_realclockset = 0;
+#endif
     if (x->x_whenclockset != 0)
     {
-    	float elapsed = clock_gettimesince(x->x_whenclockset);
-    	float left = x->x_clockdelay - elapsed;
-    	if (left < 0) left = 0;
-	x->x_autoit.i_playloc.l_delay = left / x->x_tempo;
+	t_xeqlocator *loc = &x->x_autoit.i_playloc;
+	double left = xeq_delayleft(x);
+	if (x->x_autoit.i_reverse)  /* time runs backwards */
+	    loc->l_when -= loc->l_delay - left;
+	else
+	    loc->l_when += loc->l_delay - left;
+	loc->l_delay = left;
 #if 0
-	post("stop: delay set to %f (user %f)",
-	     x->x_autoit.i_playloc.l_delay, left);
+	post("stop: delay set to %f", loc->l_delay);
 #endif
 	x->x_whenclockset = 0;
     }
@@ -1009,11 +1890,38 @@ static void xeq_next(t_xeq *x, t_floatarg drop)
     xeqit_sethooks(&x->x_stepit, xeqithook_stepdelay,
 		   drop ? 0 : xeqithook_applypp,
 		   drop ? 0 : xeqithook_playmessage, xeqithook_stepfinish, 0);
+    xeqit_setreverse(&x->x_stepit, 0);
     xeqit_donext(&x->x_stepit);
 }
 
+/* a step backwards: the event before, then the delay before that */
+static void xeq_previous(t_xeq *x, t_floatarg drop)
+{
+    xeqit_sethooks(&x->x_stepit, xeqithook_stepdelay,
+		   drop ? 0 : xeqithook_applypp,
+		   drop ? 0 : xeqithook_playmessage, xeqithook_stepfinish, 0);
+    xeqit_setreverse(&x->x_stepit, 1);
+    xeqit_donext(&x->x_stepit);
+}
+
+/* auto playback turns around, keeping current time (and playing on,
+   if it was playing) */
+static void xeq_reverse(t_xeq *x, t_floatarg f)
+{
+    int running = (x->x_clock && x->x_whenclockset != 0);
+    if ((f != 0) == x->x_autoit.i_reverse)
+	return;
+    if (running)
+	xeq_stop(x);
+    xeqit_setreverse(&x->x_autoit, f != 0);
+    if (running)
+	xeq_start(x);
+}
+
 void xeq_start(t_xeq *x)
 {
+    if (x->x_autoit.i_reverse)
+	xeqit_retrosync(&x->x_autoit);  /* in case it was moved */
     if (x->x_clock)
     {
 #if 0
@@ -1022,6 +1930,9 @@ void xeq_start(t_xeq *x)
  	clock_delay(x->x_clock, x->x_clockdelay =
 		    x->x_autoit.i_playloc.l_delay * x->x_tempo);
 	x->x_whenclockset = clock_getsystime();
+#ifdef XEQ_STATS
+	x->x_stats.s_realclockset = xeq_realtime();
+#endif
     }
 }
 
@@ -1063,12 +1974,472 @@ void xeq_loop(t_xeq *x, t_symbol *s, int ac, t_atom *av)
     }
 }
 
+/* OFFLINE RENDERING */
+
+/* Rendering walks a copy of the auto iterator, with no clock involved.
+   Delays are only summed up, and scaled by tempo, so that every event
+   is output (or bounced into another host) with its user time stamp. */
+
+#define XEQRENDER_INISIZE  256
+
+typedef struct _xeqrender
+{
+    double     r_time;     /* user time of current event */
+    double     r_written;  /* user time, as already bounced */
+    t_xeq     *r_target;   /* bouncing target, if any */
+    t_atom    *r_vec;
+    int        r_size;
+    int        r_natoms;   /* bounced so far */
+    int        r_nevents;
+    t_symbol  *r_notetargets[16][128];  /* for flushing at loopover */
+} t_xeqrender;
+
+static int xeqrender_checksize(t_xeqrender *r, int natoms)
+{
+    if (natoms > r->r_size)
+    {
+	int newsize = r->r_size ? 2 * r->r_size : XEQRENDER_INISIZE;
+	t_atom *newvec;
+	while (newsize < natoms) newsize *= 2;
+	if (!(newvec = (r->r_vec ?
+			resizebytes(r->r_vec, r->r_size * sizeof(*newvec),
+				    newsize * sizeof(*newvec)) :
+			getbytes(newsize * sizeof(*newvec)))))
+	    return (0);
+	r->r_vec = newvec;
+	r->r_size = newsize;
+    }
+    return (1);
+}
+
+static void xeqrender_emit(t_xeq *x, t_symbol *target, int argc, t_atom *argv)
+{
+    t_xeqrender *r = x->x_render;
+    t_atom *ap;
+    if (!xeqrender_checksize(r, r->r_natoms + argc + 3))
+	return;
+    if (r->r_target)
+    {
+	float delta = r->r_time - r->r_written;
+	if (delta < 0) delta = 0;
+	r->r_written += delta;
+	ap = r->r_vec + r->r_natoms;
+	SETFLOAT(ap, delta); ap++;
+	SETSYMBOL(ap, target); ap++;
+	memcpy(ap, argv, argc * sizeof(*ap));
+	ap += argc;
+	SETSEMI(ap);
+	r->r_natoms += argc + 3;
+    }
+    else
+    {
+	ap = r->r_vec;
+	SETFLOAT(ap, r->r_time);
+	SETSYMBOL(ap + 1, target);
+	memcpy(ap + 2, argv, argc * sizeof(*ap));
+	outlet_list(x->x_renderout, &s_list, argc + 2, r->r_vec);
+    }
+    r->r_nevents++;
+}
+
+static void xeqrender_flush(t_xeq *x)
+{
+    t_xeqrender *r = x->x_render;
+    int channel, key, transposed;
+    for (channel = 0; channel < 16; channel++)
+    {
+	for (key = 0; key < 128; key++)
+	{
+	    if ((transposed = x->x_noteons[channel][key]) >= 0)
+	    {
+		t_symbol *target = r->r_notetargets[channel][transposed];
+		t_atom at[4];
+		SETFLOAT(&at[0], 0x90);
+		SETFLOAT(&at[1], transposed);
+		SETFLOAT(&at[2], 0);
+		SETFLOAT(&at[3], channel + 1);
+		xeqrender_emit(x, target ? target : gensym("flush"), 4, at);
+		x->x_noteons[channel][key] = -1;
+	    }
+	}
+    }
+}
+
+static void xeqithook_renderdelay(t_xeqit *it, int argc, t_atom *argv)
+{
+    t_xeq *x = (t_xeq *)it->i_owner;
+    x->x_render->r_time += it->i_playloc.l_delay * x->x_tempo;
+}
+
+/* midi events are rendered after applying playback parameters,
+   and dropped if rejected by them */
+static void xeqithook_rendermessage(t_xeqit *it,
+				    t_symbol *target, int argc, t_atom *argv)
+{
+    t_xeq *x = (t_xeq *)it->i_owner;
+    if (it->i_status)
+    {
+	t_atom at[4];
+	int n = 0;
+	SETFLOAT(&at[n], it->i_status); n++;
+	SETFLOAT(&at[n], it->i_data1); n++;
+	if (it->i_data2 >= 0)
+	{
+	    SETFLOAT(&at[n], it->i_data2); n++;
+	}
+	SETFLOAT(&at[n], it->i_channel + 1); n++;
+	if (it->i_status == 0x90 && it->i_data2 > 0)
+	    x->x_render->r_notetargets[it->i_channel][it->i_data1] = target;
+	xeqrender_emit(x, target, n, at);
+    }
+    else
+    {
+	int status, channel, data1, data2;
+	if (argv->a_type != A_FLOAT ||
+	    !xeq_listparse(argc, argv, &status, &channel, &data1, &data2))
+	    xeqrender_emit(x, target, argc, argv);
+    }
+}
+
+static void xeqithook_renderloopover(t_xeqit *it)
+{
+    xeqrender_flush((t_xeq *)it->i_owner);
+}
+
+/* Renders from current auto position to the end, or until given user time
+   (if nonnegative).  Output goes to the render outlet, unless there is
+   a target, which is then appended to.  Returns number of rendered events,
+   or -1 on failure. */
+int xeq_dorender(t_xeq *x, double until, t_xeq *target)
+{
+    t_xeqit *it = &x->x_walkit;
+    t_xeqrender *r;
+    signed char noteons[16][128];
+    t_xeqindex index;
+    unsigned int generation;
+    int natoms, result;
+    if (x->x_render)
+	return (-1);
+    if (!target && !x->x_renderout)
+    {
+	post("render: no render outlet");
+	return (-1);
+    }
+    /* the walking iterator keeps its own event index; a reversed host
+       renders forward from current time */
+    index = it->i_index;
+    generation = it->i_indexgeneration;
+    natoms = it->i_indexnatoms;
+    *it = x->x_autoit;
+    it->i_index = index;
+    it->i_indexgeneration = generation;
+    it->i_indexnatoms = natoms;
+    xeqit_setreverse(it, 0);
+    if (it->i_elooploc.l_atnext >= 0
+	&& (until < 0 || it->i_elooploc.l_when <= it->i_blooploc.l_when))
+    {
+	post("render: looping sequence needs a time limit");
+	return (-1);
+    }
+    if (!(r = getbytes(sizeof(*r))))
+	return (-1);
+    r->r_time = it->i_playloc.l_delay * x->x_tempo;
+    r->r_written = 0;
+    r->r_target = target;
+    if (!xeqrender_checksize(r, XEQRENDER_INISIZE))
+    {
+	freebytes(r, sizeof(*r));
+	return (-1);
+    }
+    xeqit_sethooks(it, xeqithook_renderdelay, xeqithook_applypp,
+		   xeqithook_rendermessage, 0, xeqithook_renderloopover);
+    xeqit_setbatchhook(it, 0);
+    memcpy(noteons, x->x_noteons, sizeof(noteons));
+    xeq_noteons_clear(x);
+    x->x_render = r;
+    while (!it->i_finish && (until < 0 || r->r_time <= until))
+	xeqit_donext(it);
+    xeqrender_flush(x);
+    x->x_render = 0;
+    memcpy(x->x_noteons, noteons, sizeof(noteons));
+    if (target && r->r_natoms)
+	binbuf_add(target->x_binbuf, r->r_natoms, r->r_vec);
+    result = r->r_nevents;
+    freebytes(r->r_vec, r->r_size * sizeof(*r->r_vec));
+    freebytes(r, sizeof(*r));
+    return (result);
+}
+
+/* a time limit may be given in msec, or as a locator name */
+static int xeq_renderlimit(t_xeq *x, t_atom *av, double *untilp)
+{
+    t_xeqlocator *loc;
+    if (av->a_type == A_FLOAT)
+	*untilp = av->a_w.w_float;
+    else if (av->a_type == A_SYMBOL
+	     && (loc = xeq_whichloc(x, av->a_w.w_symbol)))
+    {
+	*untilp = (loc->l_when - x->x_autoit.i_playloc.l_when) * x->x_tempo;
+	if (*untilp < 0) *untilp = 0;
+    }
+    else
+    {
+	post("render: bad time limit");
+	return (0);
+    }
+    return (1);
+}
+
+static void xeq_render(t_xeq *x, t_symbol *s, int ac, t_atom *av)
+{
+    double until = -1;
+    if (ac && !xeq_renderlimit(x, av, &until))
+	return;
+    xeq_dorender(x, until, 0);
+}
+
+/* render into another host, replacing its contents */
+static void xeq_bounce(t_xeq *x, t_symbol *s, int ac, t_atom *av)
+{
+    double until = -1;
+    t_xeq *target;
+    if (!ac || av->a_type != A_SYMBOL)
+    {
+	post("bounce: missing host name");
+	return;
+    }
+    if (!(target = (t_xeq *)hyphen_findhost((t_hyphen *)x, av->a_w.w_symbol))
+	|| !target->x_binbuf || target == x)
+    {
+	post("bounce: bad host %s", av->a_w.w_symbol->s_name);
+	return;
+    }
+    if (ac > 1 && !xeq_renderlimit(x, av + 1, &until))
+	return;
+    xeq_rewind(target);
+    binbuf_clear(target->x_binbuf);
+    xeq_touch(target);
+    if (xeq_dorender(x, until, target) >= 0)
+	xeq_rewindall(target);
+}
+
+/* HOT SWAP */
+
+/* A sequence may be staged, to replace host's sequence either at the next
+   loop wrap, or as soon as auto playback reaches a given time.  Indices
+   of both sequences are built in advance, so that installing is just a
+   pointer swap, after which every locator of the host and its friends is
+   moved to the same logical time in the new sequence.  Clocks keep
+   running, and sounding notes are carried over. */
+
+static void xeqswap_free(t_xeqswap *sw)
+{
+    if (sw->s_binbuf) binbuf_free(sw->s_binbuf);
+    xeqindex_free(&sw->s_newindex);
+    xeqindex_free(&sw->s_oldindex);
+    freebytes(sw, sizeof(*sw));
+}
+
+#ifdef XEQ_STATS
+static int xeqswap_bytes(t_xeqswap *sw)
+{
+    return (sizeof(*sw) +
+	    (sw->s_binbuf ? binbuf_getnatom(sw->s_binbuf) * sizeof(t_atom) : 0) +
+	    (sw->s_newindex.ix_size + sw->s_oldindex.ix_size) *
+	    sizeof(t_xeqevent));
+}
+#endif
+
+/* rebuild the old index if host's sequence has changed since staging */
+static int xeqswap_checkold(t_xeqswap *sw, t_xeq *host)
+{
+    int natoms = binbuf_getnatom(host->x_binbuf);
+    if (sw->s_generation != host->x_generation || sw->s_oldnatoms != natoms)
+    {
+	if (xeqindex_build(&sw->s_oldindex, host->x_binbuf) < 0)
+	    return (0);
+	sw->s_generation = host->x_generation;
+	sw->s_oldnatoms = natoms;
+    }
+    return (1);
+}
+
+/* Current time of a locator is the onset of its next event, less the
+   delay left.  A play locator goes to the first event of the new sequence
+   not earlier than current time (or than `from'), but if some time is
+   left, events at current time were already played, and are skipped. */
+static void xeqlocator_swap(t_xeqlocator *x, t_xeqswap *sw, t_binbuf *bb,
+			    double from, int play)
+{
+    t_xeqindex *ix = &sw->s_newindex;
+    t_xeqevent *ep;
+    double now, where;
+    int k, strict = play && x->l_delay > 0;
+    if (x->l_atnext < 0)
+	return;  /* hidden */
+    now = sw->s_oldindex.ix_events[xeqindex_findatom(&sw->s_oldindex,
+						     x->l_atnext)].e_onset
+	- x->l_delay;
+    if (from > now)
+	where = from, strict = 0;
+    else
+	where = now;
+    k = xeqindex_findtime(ix, where);
+    if (strict)
+	while (k < ix->ix_nevents && ix->ix_events[k].e_onset <= where) k++;
+    ep = ix->ix_events + k;
+    x->l_firstatom = binbuf_getvec(bb);
+    x->l_natoms = binbuf_getnatom(bb);
+    x->l_when = now;
+    if ((x->l_delay = ep->e_onset - now) < 0)
+	x->l_delay = 0;
+    x->l_delta = ep->e_onset - (k ? ep[-1].e_onset : 0);
+    x->l_atnext = (ep->e_attarget >= 0 ? ep->e_attarget : ep->e_atend);
+    x->l_atdelta = (k < ix->ix_nevents &&
+		    x->l_firstatom[ep->e_atstart].a_type == A_FLOAT ?
+		    ep->e_atstart : -1);
+    x->l_atprevious = (!k ? -1 : (ep[-1].e_attarget >= 0 ?
+				  ep[-1].e_attarget : ep[-1].e_atstart));
+}
+
+static void xeqit_swap(t_xeqit *it, t_xeqswap *sw, t_binbuf *bb)
+{
+    xeqlocator_swap(&it->i_playloc, sw, bb, -1, 1);
+    xeqlocator_swap(&it->i_blooploc, sw, bb, -1, 0);
+    xeqlocator_swap(&it->i_elooploc, sw, bb, -1, 0);
+}
+
+/* The caller is an auto iterator in the middle of a traversal step.
+   Its play locator is moved to `from', unless negative (at loop wrap
+   it is set to loop start anyway). */
+static void xeq_swapbase(t_xeq *x, t_xeqswap *sw,
+			 t_xeqit *caller, double from)
+{
+    t_binbuf *bb = sw->s_binbuf;
+    int running = (x->x_clock && x->x_whenclockset != 0 &&
+		   caller != &x->x_autoit);
+    if (running)
+    {
+	t_xeqlocator *loc = &x->x_autoit.i_playloc;
+	double left = xeq_delayleft(x);
+	loc->l_when += loc->l_delay - left;
+	loc->l_delay = left;
+    }
+    xeq_setbinbuf(x, bb);
+    if (caller == &x->x_autoit)
+    {
+	if (from >= 0)
+	    xeqlocator_swap(&caller->i_playloc, sw, bb, from, 1);
+	xeqlocator_swap(&caller->i_blooploc, sw, bb, -1, 0);
+	xeqlocator_swap(&caller->i_elooploc, sw, bb, -1, 0);
+    }
+    else xeqit_swap(&x->x_autoit, sw, bb);
+    xeqit_swap(&x->x_stepit, sw, bb);
+    xeqit_swap(&x->x_walkit, sw, bb);
+    xeqlocator_swap(&x->x_beditloc, sw, bb, -1, 0);
+    xeqlocator_swap(&x->x_eeditloc, sw, bb, -1, 0);
+    if (running)
+	xeq_start(x);  /* reschedule for the new next event */
+}
+
+static int xeqhook_multicast_swap(t_pd *f, void *sw)
+{
+    t_xeq *host = XEQ_HOST(f);
+    t_xeq *base = XEQ_BASE(f);
+    int nbases = XEQ_NBASES(f);
+    if (host && base)
+	while (nbases-- > 0) xeq_swapbase(base++, (t_xeqswap *)sw, 0, -1);
+    return (1);
+}
+
+static void xeq_swapin(t_xeq *host, t_xeqit *caller, double from)
+{
+    t_xeqswap *sw = host->x_swap;
+    t_binbuf *oldbb = host->x_binbuf;
+    host->x_swap = 0;
+    if (!xeqswap_checkold(sw, host))
+    {
+	error("swap: no memory");
+	xeqswap_free(sw);
+	return;
+    }
+    xeq_swapbase(host, sw, caller, from);
+    hyphen_forallfriends((t_hyphen *)host, xeqhook_multicast_swap, sw);
+    xeq_touch(host);
+    sw->s_binbuf = 0;  /* now owned by host */
+    xeqswap_free(sw);
+    binbuf_free(oldbb);
+}
+
+/* a timed swap is due, once the next event is not earlier than
+   install time */
+static int xeq_swapdue(t_xeq *host, t_xeqit *it)
+{
+    t_xeqswap *sw = host->x_swap;
+    t_xeqindex *ix = &sw->s_oldindex;
+    if (!xeqswap_checkold(sw, host))
+	return (0);
+    return (ix->ix_events[xeqindex_findatom(ix, it->i_playloc.l_atnext)]
+	    .e_onset >= sw->s_when);
+}
+
+/* `swap <host>' stages a copy of another host's sequence, to be installed
+   at the next loop wrap, or at once, if not playing a loop; `swap <host>
+   <msec>' installs it as soon as auto playback gets there; `swap cancel' */
+static void xeq_swap(t_xeq *x, t_symbol *s, int ac, t_atom *av)
+{
+    t_xeq *otherhost;
+    t_xeqswap *sw;
+    if (!ac || av->a_type != A_SYMBOL)
+    {
+	error("swap: host name needed");
+	return;
+    }
+    if (x->x_swap)
+    {
+	xeqswap_free(x->x_swap);
+	x->x_swap = 0;
+    }
+    if (av->a_w.w_symbol == gensym("cancel"))
+	return;
+    if (!(otherhost = (t_xeq *)hyphen_findhost((t_hyphen *)x,
+					       av->a_w.w_symbol))
+	|| !otherhost->x_binbuf)
+    {
+	post("swap: bad host %s", av->a_w.w_symbol->s_name);
+	return;
+    }
+    if (!(sw = getbytes(sizeof(*sw))))
+	return;
+    xeqindex_init(&sw->s_newindex);
+    xeqindex_init(&sw->s_oldindex);
+    sw->s_generation = 0;
+    sw->s_oldnatoms = -1;
+    sw->s_when = -1;
+    if (ac > 1 && av[1].a_type == A_FLOAT)
+	sw->s_when = (av[1].a_w.w_float > 0 ? av[1].a_w.w_float : 0);
+    sw->s_binbuf = binbuf_new();
+    binbuf_add(sw->s_binbuf, binbuf_getnatom(otherhost->x_binbuf),
+	       binbuf_getvec(otherhost->x_binbuf));
+    if (xeqindex_build(&sw->s_newindex, sw->s_binbuf) < 0
+	|| !xeqswap_checkold(sw, x))
+    {
+	error("swap: no memory");
+	xeqswap_free(sw);
+	return;
+    }
+    x->x_swap = sw;
+    if (sw->s_when < 0 && (x->x_whenclockset == 0
+			   || x->x_autoit.i_elooploc.l_atnext < 0))
+	xeq_swapin(x, 0, -1);
+}
+
 /* SEARCHING METHODS */
 
 t_xeqlocator *xeq_dolocate(t_xeq *x, t_symbol *s, int ac, t_atom *av)
 {
     t_symbol *which = 0, *refwhich = 0;
-    float when = 0;
+    double when = 0;
     t_xeqlocator *loc = 0, *refloc = 0;
     int relative = s == gensym("locafter");
     int skipnotes = s == gensym("skipnotes");
@@ -1105,52 +2476,29 @@ postem:
 
 void xeq_locate(t_xeq *x, t_symbol *s, int ac, t_atom *av)
 {
-    xeq_dolocate(x, s, ac, av);
+#ifdef XEQ_STATS
+    double started = xeq_realtime();
+    XEQTRACE(XEQTRACE_SEEK, x, 0, xeq_dolocate(x, s, ac, av));
+    xeqstats_seek(x, started);
+#else
+    XEQTRACE(XEQTRACE_SEEK, x, 0, xeq_dolocate(x, s, ac, av));
+#endif
 }
 
 void xeq_find(t_xeq *x, t_symbol *s, int ac, t_atom *av)
 {
-    float when;
-    int ndx;
-    t_xeqit *it = &x->x_walkit;
-    t_xeqithook_applypp ahook = 0;
-    t_xeqithook_message mhook = 0;
+    double started = xeq_realtime();
     if (!ac) return;
+    /* indexed, see xeq_find.c */
     if (s == gensym("find"))
-    {
-	if (av->a_type == A_SYMBOL)
-	{
-	    it->i_messtarget = av->a_w.w_symbol;
-	    ac--;
-	    av++;
-	}
-	else it->i_messtarget = &s_;
-	it->i_messlength = ac;
-	it->i_message = av;
-	mhook = xeqithook_findmessage;
-    }
-    else if (s == gensym("event"))  /* LATER */
-    {
-	/* store event */
-	mhook = xeqithook_findevent;
-    }
+	xeq_findmessage(x, ac, av);
+    else if (s == gensym("event"))
+	xeq_findevent(x, ac, av);
     else return;
-    xeqit_sethooks(it, 0, ahook, mhook, 0, 0);
-    xeqit_rewind(it);
-    while (!it->i_finish)
-    {
-	ndx = it->i_playloc.l_atnext;
-	xeqit_donext(it);
-	when = it->i_playloc.l_when;
-    }
-    if (it->i_finish == 1)
-	post("not found...");
-    else {
-	post("found after atom %d, onset %f", ndx, when);
-	x->x_beditloc.l_when = when;
-	x->x_beditloc.l_delay = 0;
-	x->x_beditloc.l_atnext = ndx;
-    }
+    if (xeqtrace_enabled) xeqtrace_add(XEQTRACE_SEEK, x, 0, started);
+#ifdef XEQ_STATS
+    xeqstats_seek(x, started);
+#endif
 }
 
 /* EDITING METHODS */
@@ -1188,6 +2536,7 @@ static void xeq_clear(t_xeq *x)
 {
     xeq_rewind(x);
     binbuf_clear(x->x_binbuf);
+    xeq_touch(x);
 }
 
 static void xeq_set(t_xeq *x, t_symbol *s, int ac, t_atom *av)
@@ -1222,29 +2571,35 @@ static void xeq_addclone(t_xeq *x, t_symbol *name)
 static void xeq_mfread(t_xeq *x, t_symbol *s, int ac, t_atom *av)
 {
     t_symbol *filename, *tts = &s_;
+    int failed;
     if (!ac || av->a_type != A_SYMBOL) return;
     filename = av->a_w.w_symbol;
     if (ac > 1 && !(tts = squtt_makesymbol(av + 1))) return;
-    if (mfbb_read(x->x_binbuf, filename->s_name,
-		  canvas_getdir(x->x_canvas)->s_name, tts))
+    XEQTRACE(XEQTRACE_READ, x, 0,
+	     failed = mfbb_read(x->x_binbuf, filename->s_name,
+				canvas_getdir(x->x_canvas)->s_name, tts));
+    if (failed)
 	error("%s: read failed", filename->s_name);
-    xeq_rewind(x);
-    hyphen_forallfriends((t_hyphen *)x, xeqhook_multicast_rewind, 0);
+    xeq_touch(x);
+    xeq_rewindall(x);
 }
 
 static void xeq_mfwrite(t_xeq *x, t_symbol *filename, t_symbol *tts)
 {
     char buf[MAXPDSTRING];
+    int failed;
     canvas_makefilename(x->x_canvas, filename->s_name,
 			buf, MAXPDSTRING);
-    if (mfbb_write(x->x_binbuf, buf, "", tts))
+    XEQTRACE(XEQTRACE_WRITE, x, 0,
+	     failed = mfbb_write(x->x_binbuf, buf, "", tts));
+    if (failed)
 	error("%s: write failed", filename->s_name);
 }
 
 static void xeq_read(t_xeq *x, t_symbol *s, int ac, t_atom *av)
 {
     char *format, *filename;
-    int fid = 0;
+    int fid = 0, failed;
     if (!ac || av->a_type != A_SYMBOL) return;
     format = av->a_w.w_symbol->s_name;
     if (!strcmp(format, "cr"))
@@ -1256,18 +2611,21 @@ static void xeq_read(t_xeq *x, t_symbol *s, int ac, t_atom *av)
     if (fid == 2)
 	xeq_mfread(x, s, ac, av);
     else {
-	if (binbuf_read_via_path(x->x_binbuf, filename,
-				 canvas_getdir(x->x_canvas)->s_name, fid))
+	XEQTRACE(XEQTRACE_READ, x, 0,
+		 failed = binbuf_read_via_path(x->x_binbuf, filename,
+					       canvas_getdir(x->x_canvas)->s_name,
+					       fid));
+	if (failed)
 	    error("%s: read failed", filename);
-	xeq_rewind(x);
-	hyphen_forallfriends((t_hyphen *)x, xeqhook_multicast_rewind, 0);
+	xeq_touch(x);
+	xeq_rewindall(x);
     }
 }
 
 static void xeq_write(t_xeq *x, t_symbol *filename,
 		      t_symbol *format, t_symbol *tts)
 {
-    int cr = 0;
+    int cr = 0, failed;
     char buf[MAXPDSTRING];
     if (!strcmp(format->s_name, "cr"))
     	cr = 1;
@@ -1280,7 +2638,9 @@ static void xeq_write(t_xeq *x, t_symbol *filename,
     	error("xeq_read: unknown flag: %s", format->s_name);
     canvas_makefilename(x->x_canvas, filename->s_name,
     	buf, MAXPDSTRING);
-    if (binbuf_write(x->x_binbuf, buf, "", cr))
+    XEQTRACE(XEQTRACE_WRITE, x, 0,
+	     failed = binbuf_write(x->x_binbuf, buf, "", cr));
+    if (failed)
 	error("%s: write failed", filename->s_name);
 }
 
@@ -1290,23 +2650,116 @@ static void xeq_print(t_xeq *x)
     binbuf_print(x->x_binbuf);
 }
 
-static void xeq_edit(t_xeq *x)
+/* EDITOR WINDOW */
+
+/* The text window gets a sequence in pages of XEQ_EDITPAGE events, the
+   first page on opening, next ones when the window asks for them.  Only
+   pages changed in the window are sent back, and spliced into the
+   sequence.  Page boundaries are kept as atom-indices, and are shifted
+   after every splice, so that they keep matching the window's pages. */
+
+#define XEQ_EDITPAGE    256  /* events per page */
+#define XEQ_EDITCHUNK  2048  /* bytes per GUI message */
+#define XEQ_EDITINISIZE  16
+
+typedef struct _xeqedit
 {
-    t_atom *ap = binbuf_getvec(x->x_binbuf);
-    int natoms = binbuf_getnatom(x->x_binbuf);
-    char buf[MAXPDSTRING+2];
-    int buflen = 0;
-    int i, newline = 1;
-    xeq_window(x, 0, "");
+    unsigned int  e_generation;  /* of host's sequence, when last in sync */
+    int           e_nloaded;     /* pages sent so far */
+    int           e_more;        /* nonzero until last page is sent */
+    int           e_size;        /* allocated size of arrays below */
+    int          *e_pagestart;   /* e_nloaded + 1 atom-indices */
+    t_binbuf    **e_pages;       /* new contents of changed pages */
+    int           e_current;     /* page being received, -1 if none */
+} t_xeqedit;
+
+static void xeqedit_free(t_xeqedit *e)
+{
+    int i;
+    for (i = 0; i < e->e_nloaded; i++)
+	if (e->e_pages[i]) binbuf_free(e->e_pages[i]);
+    freebytes(e->e_pagestart, e->e_size * sizeof(*e->e_pagestart));
+    freebytes(e->e_pages, e->e_size * sizeof(*e->e_pages));
+    freebytes(e, sizeof(*e));
+}
+
+#ifdef XEQ_STATS
+static int xeqedit_bytes(t_xeqedit *e)
+{
+    int i, result = sizeof(*e) +
+	e->e_size * (sizeof(*e->e_pagestart) + sizeof(*e->e_pages));
+    for (i = 0; i < e->e_nloaded; i++)
+	if (e->e_pages[i])
+	    result += binbuf_getnatom(e->e_pages[i]) * sizeof(t_atom);
+    return (result);
+}
+#endif
+
+static t_xeqedit *xeqedit_new(unsigned int generation)
+{
+    t_xeqedit *e = getbytes(sizeof(*e));
+    if (!e)
+	return (0);
+    e->e_generation = generation;
+    e->e_nloaded = 0;
+    e->e_more = 1;
+    e->e_size = XEQ_EDITINISIZE;
+    e->e_pagestart = getbytes(e->e_size * sizeof(*e->e_pagestart));
+    e->e_pages = getbytes(e->e_size * sizeof(*e->e_pages));
+    e->e_current = -1;
+    if (!e->e_pagestart || !e->e_pages)
+    {
+	xeqedit_free(e);
+	return (0);
+    }
+    e->e_pagestart[0] = 0;
+    return (e);
+}
+
+static int xeqedit_checksize(t_xeqedit *e)
+{
+    int newsize = 2 * e->e_size;
+    int *newstart;
+    t_binbuf **newpages;
+    if (e->e_nloaded + 1 < e->e_size)
+	return (1);
+    if (!(newstart = resizebytes(e->e_pagestart,
+				 e->e_size * sizeof(*newstart),
+				 newsize * sizeof(*newstart))))
+	return (0);
+    e->e_pagestart = newstart;
+    if (!(newpages = resizebytes(e->e_pages, e->e_size * sizeof(*newpages),
+				 newsize * sizeof(*newpages))))
+	return (0);  /* (the bigger e_pagestart is fine) */
+    memset(newpages + e->e_size, 0,
+	   (newsize - e->e_size) * sizeof(*newpages));
+    e->e_pages = newpages;
+    e->e_size = newsize;
+    return (1);
+}
+
+/* send the text of atoms [start, end) in chunks, one line per event */
+static void xeq_edit_sendtext(t_xeq *x, t_atom *ap, int start, int end)
+{
+    char chunk[XEQ_EDITCHUNK], buf[MAXPDSTRING+2];
+    int chunklen = 0, buflen = 0, i, newline = 1;
     *buf = '\0';
-    for (i = 0; i < natoms; i++, ap++)
+    ap += start;
+    for (i = start; i < end; i++, ap++)
     {
-	if (i)
+	if (i > start)
 	{
 	    if (newline)
 	    {
 		strcat(buf, "\n");
-		xeq_window_append(x, buf);
+		buflen++;
+		if (chunklen + buflen >= XEQ_EDITCHUNK)
+		{
+		    xeq_window_append(x, chunk);
+		    chunklen = 0;
+		}
+		strcpy(chunk + chunklen, buf);
+		chunklen += buflen;
 		*buf = '\0';
 		buflen = 0;
 	    }
@@ -1320,14 +2773,152 @@ static void xeq_edit(t_xeq *x)
 	buflen = strlen(buf);
 	newline = ap->a_type == A_SEMI;
     }
-    if (natoms) strcat(buf, "\n");
-    if (*buf) xeq_window_append(x, buf);
+    if (buflen)
+    {
+	strcat(buf, "\n");
+	buflen++;
+	if (chunklen + buflen >= XEQ_EDITCHUNK)
+	{
+	    xeq_window_append(x, chunk);
+	    chunklen = 0;
+	}
+	strcpy(chunk + chunklen, buf);
+	chunklen += buflen;
+    }
+    if (chunklen) xeq_window_append(x, chunk);
+}
+
+/* send the page following those already sent */
+static void xeq_edit_sendpage(t_xeq *x)
+{
+    t_xeqedit *e = x->x_edit;
+    t_atom *vec = binbuf_getvec(x->x_binbuf);
+    int natoms = binbuf_getnatom(x->x_binbuf);
+    int page, start, end, nevents = 0;
+    if (!e || !e->e_more)
+	return;
+    if (e->e_generation != xeq_gethost(x)->x_generation)
+    {
+	post("edit: sequence has changed, reopen the editor");
+	return;
+    }
+    if (!xeqedit_checksize(e))
+	return;
+    page = e->e_nloaded;
+    start = e->e_pagestart[page];
+    for (end = start; end < natoms && nevents < XEQ_EDITPAGE; end++)
+	if (vec[end].a_type == A_SEMI) nevents++;
+    e->e_pagestart[++e->e_nloaded] = end;
+    e->e_more = (end < natoms);
+    sprintf(wname, ".%lx", (unsigned long)x);
+    sys_vgui("xeq_window_page %s %d\n", wname, page);
+    xeq_edit_sendtext(x, vec, start, end);
+    sys_vgui("xeq_window_pagedone %s %d %d\n", wname, page, e->e_more);
+}
+
+/* Opening the editor takes constant time, regardless of sequence size. */
+static void xeq_edit(t_xeq *x)
+{
+    if (x->x_edit) xeqedit_free(x->x_edit);
+    if (!(x->x_edit = xeqedit_new(xeq_gethost(x)->x_generation)))
+	return;
+    xeq_window_paged(x, 0);
+    xeq_edit_sendpage(x);
+}
+
+static void xeq_editpage(t_xeq *x, t_floatarg f)
+{
+    /* pages are sent in order, so only the next page may be requested */
+    if (x->x_edit && (int)f == x->x_edit->e_nloaded)
+	xeq_edit_sendpage(x);
+}
+
+static void xeq_editchange(t_xeq *x, t_floatarg f)
+{
+    t_xeqedit *e = x->x_edit;
+    int page = (int)f;
+    if (!e || page < 0 || page >= e->e_nloaded)
+	return;
+    if (e->e_pages[page])
+	binbuf_clear(e->e_pages[page]);
+    else
+	e->e_pages[page] = binbuf_new();
+    e->e_current = page;
+}
+
+static void xeq_editline(t_xeq *x, t_symbol *s, int ac, t_atom *av)
+{
+    t_xeqedit *e = x->x_edit;
+    int i;
+    if (!e || e->e_current < 0)
+	return;
+    for (i = 0; i < ac; i++)
+    {
+	if (av[i].a_type == A_SYMBOL)
+	{
+	    if (!strcmp(av[i].a_w.w_symbol->s_name, "_semi_"))
+		SETSEMI(&av[i]);
+	    else if (!strcmp(av[i].a_w.w_symbol->s_name, "_comma_"))
+		SETCOMMA(&av[i]);
+	}
+    }
+    binbuf_add(e->e_pages[e->e_current], ac, av);
+}
+
+/* splice changed pages into the sequence, in a single pass */
+static void xeq_editdone(t_xeq *x)
+{
+    t_xeqedit *e = x->x_edit;
+    t_binbuf *bb;
+    t_atom *vec;
+    int natoms, page, nchanged = 0, start, end;
+    if (!e)
+	return;
+    e->e_current = -1;
+    for (page = 0; page < e->e_nloaded; page++)
+	if (e->e_pages[page]) nchanged++;
+    if (!nchanged)
+	return;
+    if (e->e_generation != xeq_gethost(x)->x_generation)
+    {
+	post("edit: sequence has changed, edits ignored");
+	for (page = 0; page < e->e_nloaded; page++)
+	{
+	    if (e->e_pages[page]) binbuf_free(e->e_pages[page]);
+	    e->e_pages[page] = 0;
+	}
+	return;
+    }
+    bb = binbuf_new();
+    vec = binbuf_getvec(x->x_binbuf);
+    natoms = binbuf_getnatom(x->x_binbuf);
+    for (page = 0, end = 0; page < e->e_nloaded; page++)
+    {
+	t_binbuf *newpage = e->e_pages[page];
+	start = e->e_pagestart[page];
+	end = e->e_pagestart[page + 1];
+	e->e_pagestart[page] = binbuf_getnatom(bb);
+	if (newpage)
+	{
+	    binbuf_add(bb, binbuf_getnatom(newpage), binbuf_getvec(newpage));
+	    binbuf_free(newpage);
+	    e->e_pages[page] = 0;
+	}
+	else binbuf_add(bb, end - start, vec + start);
+    }
+    e->e_pagestart[page] = binbuf_getnatom(bb);
+    binbuf_add(bb, natoms - end, vec + end);
+    xeq_rewind(x);
+    binbuf_clear(x->x_binbuf);
+    binbuf_add(x->x_binbuf, binbuf_getnatom(bb), binbuf_getvec(bb));
+    binbuf_free(bb);
+    xeq_touch(x);
+    e->e_generation = xeq_gethost(x)->x_generation;
 }
 
 static void xeq_editok(t_xeq *x)
 {
     xeq_window_ok(x);
-
 }
 
 /* INHERITANCE HELPERS */
@@ -1383,6 +2974,7 @@ static t_xeq *xeq_derived_hostify(t_hyphen *x, int tablesize,
     {
 	xeq_newbase(base, bb, tickmethod);
     }
+    xeq_touch(XEQ_BASE(x));
     hyphen_forallfriends((t_hyphen *)XEQ_BASE(x),
 			 xeqhook_multicast_setbinbuf, 0);
     return (XEQ_BASE(x));
@@ -1488,23 +3080,28 @@ void xeq_derived_resizeembed(t_hyphen *x, int newtablesize)
     /* it is not that trivial... perhaps needs splitting into two calls? */
 }
 
+/* Called by friends before any traversal.  Costs a single compare,
+   unless host's sequence has changed, or the friend switched hosts. */
 /* LATER call this in xeq's methods (instead of friend wrappers) */
 int xeq_derived_validate(t_hyphen *x)
 {
     if (x->x_host != x->x_basetable)
     {
 	t_xeq *host = XEQ_HOST(x);
+	t_xeq *base = XEQ_BASE(x);
 	t_binbuf *bb;
-	if (host && (bb = host->x_binbuf))
+	if (!host || !(bb = host->x_binbuf))
+	    return (0);
+	if (base->x_generation != host->x_generation)
 	{
-	    t_xeq *base;
 	    int i;
-	    for (i = 0, base = XEQ_BASE(x); i < XEQ_NBASES(x); i++, base++)
+	    for (i = 0; i < XEQ_NBASES(x); i++)
 	    {
-		base->x_binbuf = bb;  /* LATER rethink (enable multihosting) */
+		/* LATER rethink (enable multihosting) */
+		xeq_setbinbuf(base + i, bb);
 	    }
+	    base->x_generation = host->x_generation;
 	}
-	else return (0);
     }
     return (1);
 }
@@ -1545,16 +3142,31 @@ void xeq_setup(void)
 		    gensym("transpo"), A_DEFFLOAT, 0);
     class_addmethod(xeq_class, (t_method)xeq_tempo,
 		    gensym("tempo"), A_DEFFLOAT, 0);
+    class_addmethod(xeq_class, (t_method)xeq_packed,
+		    gensym("packed"), A_GIMME, 0);
+    class_addmethod(xeq_class, (t_method)xeq_batch,
+		    gensym("batch"), A_DEFFLOAT, 0);
+    class_addmethod(xeq_class, (t_method)xeq_trace,
+		    gensym("trace"), A_GIMME, 0);
 
     class_addbang(xeq_class, xeq_bang);
     class_addmethod(xeq_class, (t_method)xeq_next,
 		    gensym("next"), A_DEFFLOAT, 0);
+    class_addmethod(xeq_class, (t_method)xeq_previous,
+		    gensym("previous"), A_DEFFLOAT, 0);
+    class_addmethod(xeq_class, (t_method)xeq_reverse,
+		    gensym("reverse"), A_DEFFLOAT, 0);
     class_addmethod(xeq_class, (t_method)xeq_loop,
 		    gensym("loop"), A_GIMME, 0);
     class_addmethod(xeq_class, (t_method)xeq_rewind, gensym("rewind"), 0);
     class_addmethod(xeq_class, (t_method)xeq_stop, gensym("stop"), 0);
     class_addmethod(xeq_class, (t_method)xeq_flush, gensym("flush"), 0);
 
+    class_addmethod(xeq_class, (t_method)xeq_render,
+		    gensym("render"), A_GIMME, 0);
+    class_addmethod(xeq_class, (t_method)xeq_bounce,
+		    gensym("bounce"), A_GIMME, 0);
+
     class_addmethod(xeq_class, (t_method)xeq_locate,
 		    gensym("locate"), A_GIMME, 0);
     class_addmethod(xeq_class, (t_method)xeq_locate,
@@ -1567,10 +3179,16 @@ void xeq_setup(void)
 		    gensym("event"), A_GIMME, 0);
 
     class_addmethod(xeq_class, (t_method)xeq_clear, gensym("clear"), 0);
+    class_addmethod(xeq_class, (t_method)xeq_swap,
+		    gensym("swap"), A_GIMME, 0);
     class_addmethod(xeq_class, (t_method)xeq_clone,
 		    gensym("clone"), A_DEFSYM, 0);
     class_addmethod(xeq_class, (t_method)xeq_clone,
 		    gensym("addclone"), A_DEFSYM, 0);
+    class_addmethod(xeq_class, (t_method)xeq_merge,
+		    gensym("merge"), A_GIMME, 0);
+    class_addmethod(xeq_class, (t_method)xeq_split,
+		    gensym("split"), A_GIMME, 0);
     class_addmethod(xeq_class, (t_method)xeq_set,
 		    gensym("set"), A_GIMME, 0);
     class_addmethod(xeq_class, (t_method)xeq_add,
@@ -1584,6 +3202,14 @@ void xeq_setup(void)
 
     class_addmethod(xeq_class, (t_method)xeq_edit, gensym("edit"), 0);
     class_addmethod(xeq_class, (t_method)xeq_editok, gensym("editok"), 0);
+    class_addmethod(xeq_class, (t_method)xeq_editpage,
+		    gensym("editpage"), A_FLOAT, 0);
+    class_addmethod(xeq_class, (t_method)xeq_editchange,
+		    gensym("editchange"), A_FLOAT, 0);
+    class_addmethod(xeq_class, (t_method)xeq_editline,
+		    gensym("editline"), A_GIMME, 0);
+    class_addmethod(xeq_class, (t_method)xeq_editdone,
+		    gensym("editdone"), 0);
 
     class_addmethod(xeq_class, (t_method)xeq_read,
 		    gensym("read"), A_GIMME, 0);
@@ -1594,6 +3220,13 @@ void xeq_setup(void)
     class_addmethod(xeq_class, (t_method)xeq_mfwrite,
 		    gensym("mfwrite"), A_SYMBOL, A_DEFSYM, 0);
 
+    class_addmethod(xeq_class, (t_method)xeq_snapshot,
+		    gensym("snapshot"), A_SYMBOL, 0);
+    class_addmethod(xeq_class, (t_method)xeq_restore,
+		    gensym("restore"), A_SYMBOL, 0);
+    class_addmethod(xeq_class, (t_method)xeq_transform,
+		    gensym("transform"), A_GIMME, 0);
+
     class_addmethod(xeq_class, (t_method)xeq_print, gensym("print"), 0);
     class_addmethod(xeq_class, (t_method)xeq_status, gensym("status"), 0);
 
@@ -1607,4 +3240,5 @@ void xeq_setup(void)
     xeq_polytempo_dosetup();
     xeq_time_dosetup();
     xeq_query_dosetup();
+    xeq_arrays_dosetup();
 }
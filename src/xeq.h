@@ -7,11 +7,16 @@
 
 #define XEQ_VERBOSE
 
+/* per-host performance counters, reported by xeq_query */
+#ifndef XEQ_NOSTATS
+#define XEQ_STATS
+#endif
+
 typedef struct _xeqlocator
 {
-    float      l_when;        /* logical time locator is set to */
-    float      l_delay;       /* logical delay until next event */
-    float      l_delta;       /* logical delta time of next event */
+    double     l_when;        /* logical time locator is set to */
+    double     l_delay;       /* logical delay until next event */
+    double     l_delta;       /* logical delta time of next event */
     int        l_atprevious;  /* atom-index of previous event's target */
     int        l_atdelta;     /* atom-index of next event's delta vector */
     int        l_atnext;      /* atom-index of next event's target symbol */
@@ -21,6 +26,24 @@ typedef struct _xeqlocator
     int        l_natoms;
 } t_xeqlocator;
 
+/* Event index: onset and atom-indices of every event, collected in
+   a single pass over a sequence.  The sequence is not referenced, so
+   an index has to be rebuilt after any change. */
+typedef struct _xeqevent
+{
+    double     e_onset;     /* cumulative logical time */
+    int        e_atstart;   /* atom-index of delta vector (or target) */
+    int        e_attarget;  /* atom-index of target symbol, -1 if none */
+    int        e_atend;     /* atom-index of terminating semi (or natoms) */
+} t_xeqevent;
+
+typedef struct _xeqindex
+{
+    int          ix_nevents;
+    int          ix_size;
+    t_xeqevent  *ix_events;  /* ix_events[ix_nevents] is a guard */
+} t_xeqindex;
+
 /* LATER abstract t_xeqit and hooks into generic squiter handling */
 struct _xeqit;
 typedef void (*t_xeqithook_delay)(struct _xeqit *it, int argc, t_atom *argv);
@@ -32,6 +55,25 @@ typedef void (*t_xeqithook_message)(struct _xeqit *it, t_symbol *target,
 typedef void (*t_xeqithook_finish)(struct _xeqit *it);
 typedef void (*t_xeqithook_loopover)(struct _xeqit *it);
 
+/* A channel event gathered for batched dispatch, after playback
+   parameters were applied.  The message is referenced by atom-index,
+   since the vector may be reallocated by a target of preceding events. */
+typedef struct _xeqmidi
+{
+    t_symbol  *m_target;
+    int        m_atmessage;  /* atom-index of message's first atom */
+    int        m_count;      /* message length */
+    int        m_status;
+    int        m_channel;
+    int        m_data1;
+    int        m_data2;
+} t_xeqmidi;
+
+#define XEQ_MAXBATCH  64  /* larger chords are passed in pieces */
+
+typedef void (*t_xeqithook_batch)(struct _xeqit *it,
+				  int nevents, t_xeqmidi *events);
+
 typedef struct _xeqit
 {
     void  *i_owner;
@@ -40,6 +82,8 @@ typedef struct _xeqit
     t_xeqithook_message   i_message_hook;
     t_xeqithook_finish    i_finish_hook;
     t_xeqithook_loopover  i_loopover_hook;
+    t_xeqithook_batch     i_batch_hook;  /* if set, channel events of
+					    a tick are passed together */
     /* playback position and looping locators */
     t_xeqlocator  i_playloc;  /* next message to look at */
     t_xeqlocator  i_blooploc;
@@ -53,34 +97,86 @@ typedef struct _xeqit
     int    i_channel;
     int    i_data1;
     int    i_data2;
-    /* FIXME patterns used in searching, filtering etc. */
-    t_symbol  *i_messtarget;
-    int        i_messlength;
-    t_atom    *i_message;
+    /* channel events of current tick, not yet passed to batch hook */
+    int        i_nbatched;
+    t_xeqmidi  i_batch[XEQ_MAXBATCH];
+    /* retrograde traversal (see xeqit_doprevious()) */
+    int           i_reverse;
+    int           i_event;        /* next event in forward order */
+    int           i_eventatnext;  /* play locator's l_atnext, as last set */
+    t_xeqindex    i_index;        /* built at first retrograde step */
+    unsigned int  i_indexgeneration;
+    int           i_indexnatoms;
 } t_xeqit;
 
+struct _xeqrender;
+struct _xeqswap;
+
+#ifdef XEQ_STATS
+/* All times are in milliseconds of real time. */
+typedef struct _xeqstats
+{
+    double  s_nevents;       /* events dispatched */
+    double  s_nticks;        /* traversal steps (xeqit_donext() calls) */
+    int     s_maxpertick;    /* most events dispatched in a single step */
+    double  s_steptime;      /* total time spent in xeqit_donext() */
+    double  s_maxsteptime;
+    double  s_nfires;        /* clock fires checked for lateness */
+    double  s_latetime;      /* total lateness of clock fires */
+    double  s_maxlatetime;
+    double  s_nseeks;        /* locate and find requests */
+    double  s_seektime;
+    double  s_maxseektime;
+    double  s_realclockset;  /* real time (sec) clock was last set at */
+    double  s_nbytes;        /* memory held, filled in when collecting */
+} t_xeqstats;
+
+#define XEQSTATS_EVENT(x)  ((x)->x_stats.s_nevents++)
+#else
+#define XEQSTATS_EVENT(x)
+#endif
+
 typedef struct _xeq
 {
     t_hyphen      x_this;
     t_outlet     *x_midiout;
     t_outlet     *x_bangout;
+    t_outlet     *x_renderout;  /* (only in xeq proper) */
     void         *x_binbuf;
     t_clock      *x_clock;
     double        x_whenclockset;  /* real time */
-    float         x_clockdelay;    /* user time */
+    double        x_clockdelay;    /* user time */
     t_symbol     *x_dir;
     t_canvas     *x_canvas;
     signed char   x_noteons[16][128];
     /* playback parameters */
     t_squtt      *x_ttp;
     int           x_transpo;
-    float         x_tempo;
+    double        x_tempo;
     /* iterators and locators */
     t_xeqit       x_autoit;  /* auto playback state */
     t_xeqit       x_stepit;  /* step playback state */
     t_xeqit       x_walkit;  /* walking state (transient) */
     t_xeqlocator  x_beditloc;
     t_xeqlocator  x_eeditloc;
+    struct _xeqrender  *x_render;  /* nonzero while rendering */
+    struct _xeqedit    *x_edit;    /* nonzero after opening the editor */
+    struct _xeqswap    *x_swap;    /* in a host: nonzero while staged */
+    struct _xeqfind    *x_find;    /* in a host: search index, if searched */
+    /* in a host: version of its sequence, unique across all hosts;
+       in a friend's first base: host's version last validated against */
+    unsigned int  x_generation;
+    /* in a host: sequence checksum, and the version and size it was
+       computed for (appending methods do not bump the version) */
+    unsigned int  x_checksum;
+    unsigned int  x_checkedgeneration;
+    int           x_checkednatoms;
+    int           x_packed;  /* midi output mode, XEQ_PACKED_... */
+    /* memory held by a derived object, as reported by it (for stats) */
+    int           x_heldbytes;
+#ifdef XEQ_STATS
+    t_xeqstats    x_stats;
+#endif
 } t_xeq;
 
 #define XEQ_HOST(x)    ((t_xeq *)((t_hyphen *)x)->x_host)
@@ -93,16 +189,87 @@ typedef struct _xeq
 #define XEQ_FAIL_CORRUPT     3  /* corrupt sequence */
 #define XEQ_FAIL_BADREQUEST  4
 
+/* midi output modes: as separate floats or lists (default), or
+   a single list per event, either structured or raw */
+#define XEQ_PACKED_OFF   0
+#define XEQ_PACKED_LIST  1  /* channel (1-16), status, data1, data2 */
+#define XEQ_PACKED_RAW   2  /* status byte, data bytes */
+#define XEQ_PACKED_MAXATOMS  5  /* (including a layer number) */
+
 int xeq_listparse(int argc, t_atom *argv,
 		  int *statusp, int *channelp, int *data1p, int *data2p);
+/* tracing (see xeq_trace.c) */
+#define XEQTRACE_TICK      0
+#define XEQTRACE_STEP      1
+#define XEQTRACE_DELAY     2
+#define XEQTRACE_APPLYPP   3
+#define XEQTRACE_MESSAGE   4
+#define XEQTRACE_BATCH     5
+#define XEQTRACE_FINISH    6
+#define XEQTRACE_LOOPOVER  7
+#define XEQTRACE_SEEK      8
+#define XEQTRACE_READ      9
+#define XEQTRACE_WRITE    10
+#define XEQTRACE_NKINDS   11
+
+extern int xeqtrace_enabled;
+
+/* Performs stmt, timing it if tracing is on.  Note, that stmt appears
+   twice in expansion. */
+#define XEQTRACE(kind, x, it, stmt) do {		\
+    if (xeqtrace_enabled) {				\
+	double xeqtrace_started = xeq_realtime();	\
+	stmt;						\
+	xeqtrace_add(kind, x, it, xeqtrace_started);	\
+    } else { stmt; }					\
+} while (0)
+
+double xeq_realtime(void);
+void xeqtrace_add(int kind, t_xeq *x, t_xeqit *it, double start);
+void xeq_trace(t_xeq *x, t_symbol *s, int ac, t_atom *av);
+
+/* snapshots (see xeq_snapshot.c) */
+unsigned int xeq_checksum(t_xeq *host);
+void xeq_snapshot(t_xeq *x, t_symbol *filename);
+void xeq_restore(t_xeq *x, t_symbol *filename);
+
+/* batch transforms (see xeq_transform.c) */
+void xeq_transform(t_xeq *x, t_symbol *s, int ac, t_atom *av);
+
+/* merging and splitting (see xeq_merge.c) */
+void xeq_merge(t_xeq *x, t_symbol *s, int ac, t_atom *av);
+void xeq_split(t_xeq *x, t_symbol *s, int ac, t_atom *av);
+
+/* indexed searching (see xeq_find.c) */
+void xeq_findmessage(t_xeq *x, int ac, t_atom *av);
+void xeq_findevent(t_xeq *x, int ac, t_atom *av);
+void xeqfind_free(struct _xeqfind *f);
+int xeqfind_bytes(struct _xeqfind *f);
+
+#ifdef XEQ_STATS
+void xeqstats_reset(t_xeqstats *s);
+void xeqstats_collect(t_xeq *host, t_xeqstats *s);
+void xeqstats_resetall(t_xeq *host);
+#endif
+int xeq_packedmode(int ac, t_atom *av);
+int xeq_packmidi(t_atom *at, int mode,
+		 int status, int channel, int data1, int data2);
 int xeq_applypp(t_xeq *x, t_symbol *trackname,
 		int status, int *channelp, int *data1p, int *data2p);
 
+t_xeq *xeq_gethost(t_xeq *x);
+void xeq_touch(t_xeq *x);
+
 void xeq_rewind(t_xeq *x);
+void xeq_rewindall(t_xeq *x);
+void xeq_setsequence(t_xeq *x, t_binbuf *bb);
 void xeq_stop(t_xeq *x);
+double xeq_delayleft(t_xeq *x);
 void xeq_start(t_xeq *x);
 void xeq_loop(t_xeq *x, t_symbol *s, int ac, t_atom *av);
 
+int xeq_dorender(t_xeq *x, double until, t_xeq *target);
+
 void xeq_tracks(t_xeq *x, t_symbol *s, int ac, t_atom *av);
 void xeq_transpo(t_xeq *x, t_floatarg f);
 void xeq_tempo(t_xeq *x, t_float f);
@@ -112,23 +279,32 @@ void xeq_locate(t_xeq *x, t_symbol *s, int ac, t_atom *av);
 void xeq_find(t_xeq *x, t_symbol *s, int ac, t_atom *av);
 
 t_xeqlocator *xeq_whichloc(t_xeq *x, t_symbol *s);
-float xeqlocator_reset(t_xeqlocator *x);
+double xeqlocator_reset(t_xeqlocator *x);
 void xeqlocator_hide(t_xeqlocator *x);
 int xeqlocator_settoindex(t_xeqlocator *x, int ndx);
-float xeqlocator_settotime(t_xeqlocator *x, float when);
-float xeqlocator_settolocator(t_xeqlocator *x, t_xeqlocator *reference);
-float xeqlocator_move(t_xeqlocator *x, float interval);
-float xeqlocator_skipnotes(t_xeqlocator *x, int count);
+double xeqlocator_settotime(t_xeqlocator *x, double when);
+double xeqlocator_settolocator(t_xeqlocator *x, t_xeqlocator *reference);
+double xeqlocator_move(t_xeqlocator *x, double interval);
+double xeqlocator_skipnotes(t_xeqlocator *x, int count);
+void xeqlocator_settoevent(t_xeqlocator *x, t_xeqindex *ix, int k);
 void xeqlocator_post(t_xeqlocator *loc, char *name);
 
+void xeqindex_init(t_xeqindex *ix);
+void xeqindex_free(t_xeqindex *ix);
+int xeqindex_build(t_xeqindex *ix, t_binbuf *bb);
+int xeqindex_findtime(t_xeqindex *ix, double when);
+int xeqindex_findatom(t_xeqindex *ix, int ndx);
+
 void xeqit_sethooks(t_xeqit *it, t_xeqithook_delay dhook,
 		    t_xeqithook_applypp ahook, t_xeqithook_message mhook,
 		    t_xeqithook_finish fhook, t_xeqithook_loopover lhook);
+void xeqit_setbatchhook(t_xeqit *it, t_xeqithook_batch bhook);
 void xeqit_rewind(t_xeqit *it);
-int xeqit_loop(t_xeqit *it, t_float lpos, t_float rpos);
+int xeqit_loop(t_xeqit *it, double lpos, double rpos);
 int xeqit_reloop(t_xeqit *it);
 void xeqit_donext(t_xeqit *it);
 void xeqit_settoit(t_xeqit *it, t_xeqit *reference);
+void xeqit_setreverse(t_xeqit *it, int flag);
 int xeqithook_applypp(t_xeqit *it, t_symbol *trackname,
 		      int status, int *channelp, int *data1p, int *data2p);
 
@@ -156,5 +332,6 @@ void xeq_data_dosetup(void);
 void xeq_polytempo_dosetup(void);
 void xeq_time_dosetup(void);
 void xeq_query_dosetup(void);
+void xeq_arrays_dosetup(void);
 
 #endif
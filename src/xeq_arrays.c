@@ -0,0 +1,392 @@
+/* Copyright (c) 1997-2002 Miller Puckette and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* Columnar export of a sequence: every note of the host goes into
+   a row of six arrays (onset, duration, pitch, velocity, channel, track).
+   Onsets and durations are in logical milliseconds (tempo is not applied),
+   channels are 1-16, track is the number a track name starts with (or 0).
+   Notes are paired in a single pass over the sequence; a note-off ends
+   the earliest open note of the same pitch and channel, and notes still
+   open at the end last until the end of the sequence.  Other events
+   are skipped.
+
+   Import goes the other way: parallel arrays of onsets, durations,
+   pitches and velocities (with optional channels and tracks) replace
+   the host's sequence.  The new sequence is written into a single
+   vector of its final size, without any message passing, and handed
+   over to the host in one piece. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "m_pd.h"
+#include "shared.h"
+#include "sq.h"
+#include "hyphen.h"
+#include "vefl.h"
+#include "xeq.h"
+
+#define XEQ_ARRAYS_ONSET     0
+#define XEQ_ARRAYS_DURATION  1
+#define XEQ_ARRAYS_PITCH     2
+#define XEQ_ARRAYS_VELOCITY  3
+#define XEQ_ARRAYS_CHANNEL   4
+#define XEQ_ARRAYS_TRACK     5
+#define XEQ_ARRAYS_NCOLUMNS  6
+
+#define XEQ_ARRAYS_REDRAWTIME  100.  /* ms, between consecutive redraws */
+
+typedef struct _xeq_arrays
+{
+    t_hyphen   x_this;
+    t_vefl     x_columns[XEQ_ARRAYS_NCOLUMNS];
+    t_xeqindex x_index;
+} t_xeq_arrays;
+
+static t_class *xeq_arrays_class;
+
+/* Column names are given in the order of XEQ_ARRAYS_... indices,
+   a `-' skips a column. */
+static void xeq_arrays_set(t_xeq_arrays *x, t_symbol *s, int ac, t_atom *av)
+{
+    int i;
+    for (i = 0; i < XEQ_ARRAYS_NCOLUMNS; i++)
+    {
+	t_symbol *name = &s_;
+	if (i < ac && av[i].a_type == A_SYMBOL &&
+	    strcmp(av[i].a_w.w_symbol->s_name, "-"))
+	    name = av[i].a_w.w_symbol;
+	x->x_columns[i].v_name = name;
+	x->x_columns[i].v_garray = 0;
+    }
+}
+
+static int xeq_arrays_trackid(t_symbol *trackname)
+{
+    char *p = trackname->s_name;
+    int track = 0;
+    while (*p >= '0' && *p <= '9')
+	track = track * 10 + *p++ - '0';
+    return (track);
+}
+
+/* a note waiting for its note-off */
+typedef struct _xeq_arrays_open
+{
+    double  o_onset;
+    int     o_next;  /* next open note of the same key, or -1 */
+} t_xeq_arrays_open;
+
+/* Without a scratch table, only counts notes.  Otherwise fills columns,
+   which have to be large enough.  Returns number of notes. */
+static int xeq_arrays_donotes(t_xeq_arrays *x, t_binbuf *bb,
+			      t_xeq_arrays_open *open)
+{
+    t_xeqindex *ix = &x->x_index;
+    t_atom *vec = binbuf_getvec(bb);
+    t_word *cols[XEQ_ARRAYS_NCOLUMNS];
+    int first[16][128], last[16][128];  /* queues of open notes */
+    int i, nnotes = 0;
+    double endtime = ix->ix_events[ix->ix_nevents].e_onset;
+    if (open)
+    {
+	for (i = 0; i < XEQ_ARRAYS_NCOLUMNS; i++)
+	    cols[i] = (x->x_columns[i].v_garray ?
+		       x->x_columns[i].v_data : 0);
+	memset(first, -1, sizeof(first));
+    }
+    for (i = 0; i < ix->ix_nevents; i++)
+    {
+	t_xeqevent *ep = ix->ix_events + i;
+	int status, channel, data1, data2;
+	if (ep->e_attarget < 0 || ep->e_atend - ep->e_attarget < 2 ||
+	    vec[ep->e_attarget + 1].a_type != A_FLOAT ||
+	    !xeq_listparse(ep->e_atend - ep->e_attarget - 1,
+			   vec + ep->e_attarget + 1,
+			   &status, &channel, &data1, &data2))
+	    continue;
+	if (status == 0x90 && data2 > 0)
+	{
+	    if (open)
+	    {
+		if (first[channel][data1] < 0)
+		    first[channel][data1] = nnotes;
+		else
+		    open[last[channel][data1]].o_next = nnotes;
+		last[channel][data1] = nnotes;
+		open[nnotes].o_onset = ep->e_onset;
+		open[nnotes].o_next = -1;
+		if (cols[XEQ_ARRAYS_ONSET])
+		    cols[XEQ_ARRAYS_ONSET][nnotes].w_float = ep->e_onset;
+		if (cols[XEQ_ARRAYS_DURATION])  /* until a note-off comes */
+		    cols[XEQ_ARRAYS_DURATION][nnotes].w_float =
+			endtime - ep->e_onset;
+		if (cols[XEQ_ARRAYS_PITCH])
+		    cols[XEQ_ARRAYS_PITCH][nnotes].w_float = data1;
+		if (cols[XEQ_ARRAYS_VELOCITY])
+		    cols[XEQ_ARRAYS_VELOCITY][nnotes].w_float = data2;
+		if (cols[XEQ_ARRAYS_CHANNEL])
+		    cols[XEQ_ARRAYS_CHANNEL][nnotes].w_float = channel + 1;
+		if (cols[XEQ_ARRAYS_TRACK])
+		    cols[XEQ_ARRAYS_TRACK][nnotes].w_float =
+			xeq_arrays_trackid(vec[ep->e_attarget].a_w.w_symbol);
+	    }
+	    nnotes++;
+	}
+	else if (open && (status == 0x80 || status == 0x90))
+	{
+	    int note = first[channel][data1];
+	    if (note >= 0)
+	    {
+		if (cols[XEQ_ARRAYS_DURATION])
+		    cols[XEQ_ARRAYS_DURATION][note].w_float =
+			ep->e_onset - open[note].o_onset;
+		first[channel][data1] = open[note].o_next;
+	    }
+	}
+    }
+    return (nnotes);
+}
+
+static void xeq_arrays_export(t_xeq_arrays *x)
+{
+    t_xeq *host = XEQ_HOST(x);
+    t_binbuf *bb;
+    t_xeq_arrays_open *open;
+    int i, nnotes;
+    if (!host || !(bb = host->x_binbuf))
+	return;
+    if (xeqindex_build(&x->x_index, bb) < 0)
+    {
+	error("xeq_arrays: no memory");
+	return;
+    }
+    nnotes = xeq_arrays_donotes(x, bb, 0);
+    if (!(open = getbytes((nnotes + 1) * sizeof(*open))))
+    {
+	error("xeq_arrays: no memory");
+	return;
+    }
+    for (i = 0; i < XEQ_ARRAYS_NCOLUMNS; i++)
+    {
+	t_vefl *vp = &x->x_columns[i];
+	if (vp->v_name != &s_ &&
+	    vefl_renew(vp, 0, 1) && !vefl_resize(vp, nnotes))
+	    error("%s: cannot resize", vp->v_name->s_name);
+    }
+    xeq_arrays_donotes(x, bb, open);
+    freebytes(open, (nnotes + 1) * sizeof(*open));
+    for (i = 0; i < XEQ_ARRAYS_NCOLUMNS; i++)
+	if (x->x_columns[i].v_garray)
+	    vefl_redraw(&x->x_columns[i], XEQ_ARRAYS_REDRAWTIME);
+    outlet_float(((t_object *)x)->ob_outlet, nnotes);
+}
+
+/* an onset or a note end, sorted for import */
+typedef struct _xeq_arrays_time
+{
+    double  t_when;
+    int     t_note;
+} t_xeq_arrays_time;
+
+static int xeq_arrays_timecompare(const void *p1, const void *p2)
+{
+    const t_xeq_arrays_time *t1 = p1, *t2 = p2;
+    if (t1->t_when < t2->t_when)
+	return (-1);
+    else if (t1->t_when > t2->t_when)
+	return (1);
+    else  /* keep it stable */
+	return (t1->t_note - t2->t_note);
+}
+
+/* Algorithmically generated material usually comes sorted already,
+   so the sort is skipped then. */
+static void xeq_arrays_sort(t_xeq_arrays_time *times, int ntimes)
+{
+    int i;
+    for (i = 1; i < ntimes; i++)
+	if (times[i].t_when < times[i - 1].t_when)
+	    break;
+    if (i < ntimes)
+	qsort(times, ntimes, sizeof(*times), xeq_arrays_timecompare);
+}
+
+static t_float xeq_arrays_getcolumn(t_xeq_arrays *x, int column,
+				    int ndx, t_float dflt)
+{
+    t_vefl *vp = &x->x_columns[column];
+    return (vp->v_garray ? vp->v_data[ndx].w_float : dflt);
+}
+
+static void xeq_arrays_import(t_xeq_arrays *x)
+{
+    t_xeq *host = XEQ_HOST(x);
+    t_xeq_arrays_time *ons = 0, *offs = 0;
+    unsigned char *started = 0;
+    t_atom *vec = 0, *ap;
+    t_binbuf *bb;
+    t_symbol *target = 0;
+    int i, nnotes = -1, nons = 0, ion, ioff, lasttrack = -1;
+    double written = 0;
+    if (!host || !host->x_binbuf)
+	return;
+    for (i = 0; i < XEQ_ARRAYS_NCOLUMNS; i++)
+    {
+	t_vefl *vp = &x->x_columns[i];
+	if (vp->v_name == &s_ || !vefl_renew(vp, 0, 1))
+	{
+	    if (i <= XEQ_ARRAYS_VELOCITY)
+	    {
+		error("xeq_arrays: import needs onset, duration, pitch \
+and velocity arrays");
+		return;
+	    }
+	}
+	else if (nnotes < 0 || vp->v_size < nnotes)
+	    nnotes = vp->v_size;
+    }
+    if (!(ons = getbytes(nnotes * sizeof(*ons))) ||
+	!(offs = getbytes(nnotes * sizeof(*offs))) ||
+	!(started = getbytes(nnotes)))
+    {
+	error("xeq_arrays: no memory to import %d notes", nnotes);
+	goto done;
+    }
+    for (i = nons = 0; i < nnotes; i++)
+    {
+	if (xeq_arrays_getcolumn(x, XEQ_ARRAYS_VELOCITY, i, 0) < 1)
+	    continue;  /* not a note */
+	ons[nons].t_when = xeq_arrays_getcolumn(x, XEQ_ARRAYS_ONSET, i, 0);
+	ons[nons].t_note = i;
+	started[i] = 0;
+	nons++;
+    }
+    xeq_arrays_sort(ons, nons);
+    /* note ends taken in onset order are sorted, if durations are equal */
+    for (i = 0; i < nons; i++)
+    {
+	double duration = xeq_arrays_getcolumn(x, XEQ_ARRAYS_DURATION,
+					       ons[i].t_note, 0);
+	offs[i].t_when = ons[i].t_when + (duration > 0 ? duration : 0);
+	offs[i].t_note = ons[i].t_note;
+    }
+    xeq_arrays_sort(offs, nons);
+    /* every note makes two lines of 7 atoms */
+    if (nons && !(vec = getbytes(14 * nons * sizeof(*vec))))
+    {
+	error("xeq_arrays: no memory to import %d notes", nnotes);
+	goto done;
+    }
+
+    /* Merge note-ons and note-offs.  A note-off goes first on a tie,
+       so that a repeated note is not cut short, unless its own note-on
+       is still waiting (as for a zero duration). */
+    ap = vec;
+    ion = ioff = 0;
+    while (ioff < nons)
+    {
+	t_xeq_arrays_time *tp;
+	int isoff, note, pitch, velocity, channel, track;
+	float delta;
+	if (ion < nons &&
+	    (ons[ion].t_when < offs[ioff].t_when ||
+	     (ons[ion].t_when == offs[ioff].t_when &&
+	      !started[offs[ioff].t_note])))
+	    tp = &ons[ion++], isoff = 0;
+	else
+	    tp = &offs[ioff++], isoff = 1;
+	note = tp->t_note;
+	started[note] = 1;
+	pitch = (int)(xeq_arrays_getcolumn(x, XEQ_ARRAYS_PITCH,
+					   note, 0) + .5);
+	velocity = (int)(xeq_arrays_getcolumn(x, XEQ_ARRAYS_VELOCITY,
+					      note, 0) + .5);
+	channel = (int)xeq_arrays_getcolumn(x, XEQ_ARRAYS_CHANNEL, note, 1);
+	track = (int)xeq_arrays_getcolumn(x, XEQ_ARRAYS_TRACK, note, 1);
+	if (pitch < 0) pitch = 0; else if (pitch > 127) pitch = 127;
+	if (velocity > 127) velocity = 127;
+	if (channel < 1) channel = 1; else if (channel > 16) channel = 16;
+	if (track != lasttrack)
+	{
+	    char buf[32];
+	    sprintf(buf, "%d-track", track);
+	    target = gensym(buf);
+	    lasttrack = track;
+	}
+	delta = tp->t_when - written;
+	if (delta < 0) delta = 0;
+	written += delta;
+	SETFLOAT(ap, delta); ap++;
+	SETSYMBOL(ap, target); ap++;
+	SETFLOAT(ap, isoff ? 0x80 : 0x90); ap++;
+	SETFLOAT(ap, pitch); ap++;
+	SETFLOAT(ap, isoff ? 0 : velocity); ap++;
+	SETFLOAT(ap, channel); ap++;
+	SETSEMI(ap); ap++;
+    }
+    bb = binbuf_new();
+    binbuf_add(bb, ap - vec, vec);
+    xeq_setsequence(host, bb);
+    outlet_float(((t_object *)x)->ob_outlet, nons);
+done:
+    if (ons) freebytes(ons, nnotes * sizeof(*ons));
+    if (offs) freebytes(offs, nnotes * sizeof(*offs));
+    if (started) freebytes(started, nnotes);
+    if (vec) freebytes(vec, 14 * nons * sizeof(*vec));
+}
+
+static void xeq_arrays_host(t_xeq_arrays *x, t_symbol *name)
+{
+    hyphen_attach((t_hyphen *)x, name);
+}
+
+static void *xeq_arrays_new(t_symbol *s, int ac, t_atom *av)
+{
+    t_xeq_arrays *x = (t_xeq_arrays *)hyphen_new(xeq_arrays_class, "xeq");
+    int i;
+    for (i = 0; i < XEQ_ARRAYS_NCOLUMNS; i++)
+	vefl_placement_new(&x->x_columns[i], &s_, 1, 0, 0);
+    xeqindex_init(&x->x_index);
+    hyphen_attach((t_hyphen *)x,
+		  ac && av->a_type == A_SYMBOL ? av->a_w.w_symbol : &s_);
+    if (ac > 1)
+	xeq_arrays_set(x, 0, ac - 1, av + 1);
+    outlet_new((t_object *)x, &s_float);
+    return (x);
+}
+
+static void xeq_arrays_free(t_xeq_arrays *x)
+{
+    int i;
+    for (i = 0; i < XEQ_ARRAYS_NCOLUMNS; i++)
+	vefl_free(&x->x_columns[i]);
+    xeqindex_free(&x->x_index);
+    hyphen_detach((t_hyphen *)x);
+}
+
+void xeq_arrays_dosetup(void)
+{
+    xeq_arrays_class = class_new(gensym("xeq_arrays"),
+				 (t_newmethod)xeq_arrays_new,
+				 (t_method)xeq_arrays_free,
+				 sizeof(t_xeq_arrays), 0, A_GIMME, 0);
+    class_addcreator((t_newmethod)xeq_arrays_new,
+		     gensym("xeq-arrays"), A_GIMME, 0);
+    class_addbang(xeq_arrays_class, xeq_arrays_export);
+    class_addmethod(xeq_arrays_class, (t_method)xeq_arrays_export,
+		    gensym("export"), 0);
+    class_addmethod(xeq_arrays_class, (t_method)xeq_arrays_import,
+		    gensym("import"), 0);
+    class_addmethod(xeq_arrays_class, (t_method)xeq_arrays_set,
+		    gensym("set"), A_GIMME, 0);
+    class_addmethod(xeq_arrays_class, (t_method)xeq_arrays_host,
+		    gensym("host"), A_DEFSYM, 0);
+}
+
+void xeq_arrays_setup(void)
+{
+    xeq_setup();
+}
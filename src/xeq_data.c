@@ -7,9 +7,11 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "m_pd.h"
+#include "g_canvas.h"
 #include "shared.h"
 #include "sq.h"
 #include "hyphen.h"
@@ -29,6 +31,13 @@ typedef struct _xeq_data
     float      x_duration;
     uchar      x_pitch;
     uchar      x_channel;
+    int        x_bulk;       /* replace own scalars, drawing suspended */
+    t_gobj   **x_scalars;    /* scalars created by us */
+    int        x_nscalars;
+    int        x_maxscalars;
+    t_glist   *x_glist;      /* ...in this canvas */
+    int        x_valid;      /* ...as of this validity stamp */
+    t_gobj    *x_lastgobj;   /* last one created during current bang */
 } t_xeq_data;
 
 static t_class *xeq_data_class;
@@ -39,6 +48,7 @@ static t_symbol *xeq_data_selector;  /* `scalar' selector */
 #define XEQ_DATA_PCOEF  10
 #define XEQ_DATA_VCOEF   0.1
 #define XEQ_NCOLORS     17  /* FIXME for channels: 0 (omni), 1..16 */
+#define XEQ_DATA_INISCALARS  256
 
 /* channel color table */
 static int xeq_data_color[XEQ_NCOLORS] =
@@ -46,6 +56,109 @@ static int xeq_data_color[XEQ_NCOLORS] =
     9, 90, 900, 99, 990, 909, 3, 30, 300, 33, 330, 303, 335, 533, 373, 737, 0
 };
 
+/* SCALAR BOOKKEEPING */
+
+/* Created scalars are remembered, so that they may later be deleted
+   without touching anything else in the data canvas.  Pd bumps the
+   canvas' validity stamp whenever something is deleted from it.  If that
+   happens behind our back, a scalar of ours may be gone, and its address
+   reused by another one, so the whole list is forgotten rather than
+   trusted.  LATER validate against template. */
+
+static t_glist *xeq_data_glist(t_xeq_data *x)
+{
+    return (x->x_target && *x->x_target == canvas_class ?
+	    (t_glist *)x->x_target : 0);
+}
+
+/* returns zero, after forgetting our scalars, if the list is stale */
+static int xeq_data_checkvalid(t_xeq_data *x, t_glist *gl)
+{
+    if (x->x_nscalars &&
+	(gl != x->x_glist || gl->gl_valid != x->x_valid))
+    {
+	post("xeq_data: data canvas changed, %d scalars left there",
+	     x->x_nscalars);
+	x->x_nscalars = 0;
+	return (0);
+    }
+    return (1);
+}
+
+static void xeq_data_setvalid(t_xeq_data *x, t_glist *gl)
+{
+    x->x_glist = gl;
+    x->x_valid = gl->gl_valid;
+}
+
+/* returns the last object of the data canvas, taken before a scalar is
+   requested, so that only an object appended after it counts as ours */
+static t_gobj *xeq_data_tail(t_xeq_data *x, t_glist *gl)
+{
+    t_gobj *y = (x->x_lastgobj && gl == x->x_glist &&
+		 gl->gl_valid == x->x_valid ? x->x_lastgobj : gl->gl_list);
+    if (y)
+	while (y->g_next)
+	    y = y->g_next;
+    return (y);
+}
+
+/* store the scalar appended to the data canvas after tail */
+static void xeq_data_track(t_xeq_data *x, t_glist *gl, t_gobj *tail)
+{
+    t_gobj *y = (tail ? tail->g_next : gl->gl_list);
+    if (!y)
+	return;  /* nothing created */
+    while (y->g_next)
+	y = y->g_next;
+    if (pd_class(&y->g_pd) != scalar_class)
+	return;
+    x->x_lastgobj = y;
+    xeq_data_checkvalid(x, gl);
+    xeq_data_setvalid(x, gl);
+    if (x->x_nscalars == x->x_maxscalars)
+    {
+	int newmax = (x->x_maxscalars ?
+		      2 * x->x_maxscalars : XEQ_DATA_INISCALARS);
+	t_gobj **newscalars = (x->x_scalars ?
+			       resizebytes(x->x_scalars,
+					   x->x_maxscalars * sizeof(*newscalars),
+					   newmax * sizeof(*newscalars)) :
+			       getbytes(newmax * sizeof(*newscalars)));
+	if (!newscalars)
+	    return;
+	x->x_scalars = newscalars;
+	x->x_maxscalars = newmax;
+    }
+    x->x_scalars[x->x_nscalars++] = y;
+}
+
+static int xeq_data_gobjcompare(const void *p1, const void *p2)
+{
+    t_gobj *y1 = *(t_gobj **)p1, *y2 = *(t_gobj **)p2;
+    return (y1 < y2 ? -1 : (y1 > y2));
+}
+
+/* deletes all our scalars in a single pass over the data canvas */
+static void xeq_data_doclear(t_xeq_data *x, t_glist *gl)
+{
+    t_gobj *y, *next;
+    if (!xeq_data_checkvalid(x, gl) || !x->x_nscalars)
+	return;
+    qsort(x->x_scalars, x->x_nscalars, sizeof(*x->x_scalars),
+	  xeq_data_gobjcompare);
+    for (y = gl->gl_list; y; y = next)
+    {
+	next = y->g_next;
+	if (pd_class(&y->g_pd) == scalar_class &&
+	    bsearch(&y, x->x_scalars, x->x_nscalars, sizeof(*x->x_scalars),
+		    xeq_data_gobjcompare))
+	    glist_delete(gl, y);
+    }
+    x->x_nscalars = 0;
+    xeq_data_setvalid(x, gl);
+}
+
 static void xeqithook_data_delay(t_xeqit *it, int argc, t_atom *argv)
 {
     t_xeq *base = (t_xeq *)it->i_owner;
@@ -65,6 +178,8 @@ static void xeqithook_data_message(t_xeqit *it,
 {
     t_xeq *base = (t_xeq *)it->i_owner;
     t_xeq_data *x = (t_xeq_data *)((t_hyphen *)base)->x_self;
+    t_glist *gl;
+    t_gobj *tail;
     if (it->i_status == 144 && it->i_data2 &&
 	it->i_channel >= 0 && it->i_channel <= 16)
     {
@@ -88,7 +203,11 @@ static void xeqithook_data_message(t_xeqit *it,
 	SETFLOAT(&x->x_argv[6],
 		 (x->x_duration - offit->i_playloc.l_delay) * x->x_tcoef);
 	SETFLOAT(&x->x_argv[7], xeq_data_color[it->i_channel]);
+	gl = xeq_data_glist(x);
+	tail = (gl ? xeq_data_tail(x, gl) : 0);
 	pd_typedmess(x->x_target, xeq_data_selector, 8, x->x_argv);
+	if (gl)
+	    xeq_data_track(x, gl, tail);
     }
 }
 
@@ -138,11 +257,18 @@ static void *xeq_data_new(t_symbol *seqname, t_symbol *dsym, t_symbol *tsym)
     x->x_pcoef = XEQ_DATA_PCOEF;
     x->x_vcoef = XEQ_DATA_VCOEF;
     x->x_time = 0;
+    x->x_bulk = 0;
+    x->x_scalars = 0;
+    x->x_nscalars = x->x_maxscalars = 0;
+    x->x_glist = 0;
+    x->x_valid = 0;
     return (x);
 }
 
 static void xeq_data_free(t_xeq_data *x)
 {
+    if (x->x_scalars)
+	freebytes(x->x_scalars, x->x_maxscalars * sizeof(*x->x_scalars));
     xeq_derived_free((t_hyphen *)x);
 }
 
@@ -155,6 +281,7 @@ static void xeq_data_data(t_xeq_data *x, t_symbol *s)
 {
     x->x_dsym = s;
     x->x_target = x->x_dsym->s_thing;
+    x->x_nscalars = 0;  /* forget scalars of a previous canvas */
 }
 
 static void xeq_data_template(t_xeq_data *x, t_symbol *s)
@@ -171,22 +298,58 @@ static void xeq_data_scale(t_xeq_data *x,
     x->x_vcoef = f3 ? f3 : XEQ_DATA_VCOEF;
 }
 
+/* In bulk mode, scalars created by a previous bang are replaced, and
+   the data canvas is not drawn until all new scalars are there.
+   LATER redraw a graph-on-parent through its parent */
 static void xeq_data_bang(t_xeq_data *x)
 {
     t_xeq *host = XEQ_HOST(x);
+    if (x->x_dsym != &s_)
+	x->x_target = x->x_dsym->s_thing;
     if (host && x->x_dsym != &s_ && x->x_tsym != &s_ && x->x_target)
     {
 	t_xeq *base = XEQ_BASE(x);
 	t_xeqit *it = &base->x_stepit;
+	t_glist *gl = (x->x_bulk ? xeq_data_glist(x) : 0);
+	int wasloading = 0;
+	if (gl)
+	{
+	    wasloading = gl->gl_loading;
+	    gl->gl_loading = 1;  /* this makes glist_isvisible() false */
+	    xeq_data_doclear(x, gl);
+	}
 	x->x_time = 0;
+	x->x_lastgobj = 0;
 	xeqit_rewind(it);
 	while (!it->i_finish)
 	{
 	    xeqit_donext(it);
 	}
+	if (gl)
+	{
+	    gl->gl_loading = wasloading;
+	    canvas_redraw(gl);
+	}
     }
 }
 
+static void xeq_data_bulk(t_xeq_data *x, t_floatarg f)
+{
+    x->x_bulk = (f != 0);
+}
+
+/* delete scalars created by us */
+static void xeq_data_clear(t_xeq_data *x)
+{
+    t_glist *gl;
+    if (x->x_dsym != &s_)
+	x->x_target = x->x_dsym->s_thing;
+    if ((gl = xeq_data_glist(x)) != 0)
+	xeq_data_doclear(x, gl);
+    else
+	x->x_nscalars = 0;
+}
+
 void xeq_data_dosetup(void)
 {
     xeq_data_class = class_new(gensym("xeq_data"), (t_newmethod)xeq_data_new,
@@ -202,6 +365,10 @@ void xeq_data_dosetup(void)
 		    gensym("template"), A_DEFSYM, 0);
     class_addmethod(xeq_data_class, (t_method)xeq_data_scale,
 		    gensym("scale"), A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, 0);
+    class_addmethod(xeq_data_class, (t_method)xeq_data_bulk,
+		    gensym("bulk"), A_DEFFLOAT, 0);
+    class_addmethod(xeq_data_class, (t_method)xeq_data_clear,
+		    gensym("clear"), 0);
     class_addbang(xeq_data_class, xeq_data_bang);
     xeq_data_selector = gensym("scalar");
 }
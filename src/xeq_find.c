@@ -0,0 +1,683 @@
+/* Copyright (c) 1997-2002 Miller Puckette and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* Indexed searching.  A host keeps a search index, built at the first
+   search after any change of its sequence.  Every message (a target and
+   its arguments, or arguments following a comma, which go to the same
+   target) is keyed by a hash of its target and of its first few atoms,
+   for each prefix length up to XEQFIND_KEYSIZE, and also by a hash of
+   its atoms alone.  Keys are sorted by hash and then by position, so
+   that a search is a binary search for the first candidate at or after
+   (or before) a given position, and candidates are then checked atom by
+   atom, only hash collisions and longer patterns taking more than that.
+
+   `find [<target>] <atom> ...' searches from the start of a sequence,
+   `find next [<locator>]' and `find prev [<locator>]' search for the
+   same pattern after (before) a locator, bedit by default.  A match
+   sets bedit to the event found.  (Targets `next' and `prev' cannot
+   be searched for, then.)
+
+   Channel events are also listed by status and channel, each list
+   holding event numbers in sequence order, together with both data
+   bytes.  `event' takes any of the criteria
+
+     note|off|poly|control|program|touch|bend|<status> ...
+     channel <channel> ...
+     pitch <low> [<high>]       (first data byte)
+     velocity <low> [<high>]    (second data byte, if any)
+     track <target>
+     after <onset>|<locator>
+
+   and finds the first event meeting them, by a binary search in each
+   of the lists selected by status and channel.  Note-ons of velocity
+   zero are listed as note-offs.  `event next [<locator>]' and
+   `event prev [<locator>]' repeat the last query, as `find' does. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "m_pd.h"
+#include "shared.h"
+#include "sq.h"
+#include "hyphen.h"
+#include "xeq.h"
+
+#define XEQFIND_KEYSIZE  2  /* message atoms hashed */
+#define XEQFIND_NSTATUSES  7  /* 0x80 to 0xe0 */
+#define XEQFIND_NLISTS  (XEQFIND_NSTATUSES * 16)
+
+typedef struct _xeqfind_key
+{
+    unsigned int  k_hash;
+    int           k_at;  /* atom-index of message's target, or of its first
+			    atom, if it follows a comma */
+} t_xeqfind_key;
+
+typedef struct _xeqfind_midi
+{
+    int    m_event;  /* index in f_index */
+    short  m_data1;
+    short  m_data2;  /* -1 if none */
+} t_xeqfind_midi;
+
+typedef struct _xeqfind
+{
+    unsigned int    f_generation;  /* of the sequence indexed */
+    int             f_natoms;
+    t_xeqindex      f_index;
+    int             f_haskeys;
+    int             f_nkeys;
+    t_xeqfind_key  *f_keys;
+    int             f_hasmidi;
+    int             f_nmidi;
+    t_xeqfind_midi *f_midi;  /* grouped by status and channel */
+    int             f_midistart[XEQFIND_NLISTS + 1];
+    /* last pattern, and where it was found */
+    t_symbol       *f_target;  /* null if any */
+    int             f_length;
+    t_atom         *f_pattern;
+    int             f_at;      /* message position, -1 if none */
+    int             f_atnext;  /* bedit's l_atnext, as set by a match */
+    /* last event criteria, and where they were met */
+    int             f_hascriteria;
+    int             f_statuses;  /* bit per status (zero for any) */
+    int             f_channels;  /* bit per channel (zero for any) */
+    int             f_data1lo, f_data1hi;
+    int             f_data2lo, f_data2hi;
+    t_symbol       *f_track;     /* null if any */
+    int             f_event;     /* -1 if none */
+    int             f_eventatnext;
+} t_xeqfind;
+
+static unsigned int xeqfind_hash(t_symbol *target, int ac, t_atom *av)
+{
+    unsigned int hash = 2166136261u;
+    unsigned char *p = (unsigned char *)&target;
+    unsigned int i;
+    for (i = 0; i < sizeof(target); i++)
+	hash = (hash ^ p[i]) * 16777619u;
+    hash = (hash ^ ac) * 16777619u;
+    for (; ac--; av++)
+    {
+	t_float f = (av->a_type == A_FLOAT ? av->a_w.w_float : 0);
+	t_symbol *s = (av->a_type == A_SYMBOL ? av->a_w.w_symbol : 0);
+	if (f == 0)
+	    f = 0;  /* the same for -0 */
+	hash = (hash ^ av->a_type) * 16777619u;
+	for (p = (unsigned char *)&f, i = 0; i < sizeof(f); i++)
+	    hash = (hash ^ p[i]) * 16777619u;
+	for (p = (unsigned char *)&s, i = 0; i < sizeof(s); i++)
+	    hash = (hash ^ p[i]) * 16777619u;
+    }
+    return (hash);
+}
+
+static int xeqfind_compare(const void *p1, const void *p2)
+{
+    const t_xeqfind_key *k1 = p1, *k2 = p2;
+    if (k1->k_hash != k2->k_hash)
+	return (k1->k_hash < k2->k_hash ? -1 : 1);
+    return (k1->k_at - k2->k_at);
+}
+
+/* number of message atoms (floats and symbols) starting at ndx */
+static int xeqfind_length(t_atom *vec, int natoms, int ndx)
+{
+    int n = ndx;
+    while (n < natoms &&
+	   (vec[n].a_type == A_FLOAT || vec[n].a_type == A_SYMBOL))
+	n++;
+    return (n - ndx);
+}
+
+/* Calls back for every message, first the one at a target, then those
+   following commas.  If keys is null, only counts them. */
+static int xeqfind_dokeys(t_xeqfind *f, t_atom *vec, int natoms,
+			  t_xeqfind_key *keys)
+{
+    t_xeqindex *ix = &f->f_index;
+    int i, nkeys = 0;
+    for (i = 0; i < ix->ix_nevents; i++)
+    {
+	t_xeqevent *ep = ix->ix_events + i;
+	t_symbol *target;
+	int at, ndx, length, n;
+	if (ep->e_attarget < 0)
+	    continue;
+	target = vec[ep->e_attarget].a_w.w_symbol;
+	at = ep->e_attarget;
+	ndx = at + 1;
+	while (1)
+	{
+	    length = xeqfind_length(vec, natoms, ndx);
+	    if (length > XEQFIND_KEYSIZE)
+		length = XEQFIND_KEYSIZE;
+	    for (n = 0; n <= length; n++)
+	    {
+		if (keys)
+		{
+		    keys[nkeys].k_hash = xeqfind_hash(target, n, vec + ndx);
+		    keys[nkeys].k_at = at;
+		    if (n)
+		    {
+			keys[nkeys + 1].k_hash = xeqfind_hash(0, n, vec + ndx);
+			keys[nkeys + 1].k_at = at;
+		    }
+		}
+		nkeys += (n ? 2 : 1);
+	    }
+	    ndx += xeqfind_length(vec, natoms, ndx);
+	    if (ndx >= ep->e_atend || vec[ndx].a_type != A_COMMA)
+		break;
+	    at = ++ndx;
+	}
+    }
+    return (nkeys);
+}
+
+void xeqfind_free(t_xeqfind *f)
+{
+    xeqindex_free(&f->f_index);
+    if (f->f_keys)
+	freebytes(f->f_keys, f->f_nkeys * sizeof(*f->f_keys));
+    if (f->f_midi)
+	freebytes(f->f_midi, f->f_nmidi * sizeof(*f->f_midi));
+    if (f->f_pattern)
+	freebytes(f->f_pattern, f->f_length * sizeof(*f->f_pattern));
+    freebytes(f, sizeof(*f));
+}
+
+int xeqfind_bytes(t_xeqfind *f)
+{
+    return (sizeof(*f) + f->f_index.ix_size * sizeof(*f->f_index.ix_events) +
+	    (f->f_keys ? f->f_nkeys * sizeof(*f->f_keys) : 0) +
+	    (f->f_midi ? f->f_nmidi * sizeof(*f->f_midi) : 0) +
+	    (f->f_pattern ? f->f_length * sizeof(*f->f_pattern) : 0));
+}
+
+/* Channel event of an index is returned as the number of its list
+   (-1 if it is not a channel event). */
+static int xeqfind_midilist(t_atom *vec, int natoms, t_xeqevent *ep,
+			    int *data1p, int *data2p)
+{
+    int at = ep->e_attarget + 1, length, status, channel;
+    if (ep->e_attarget < 0)
+	return (-1);
+    length = xeqfind_length(vec, natoms, at);
+    if (length < 3 || vec[at].a_type != A_FLOAT ||
+	!xeq_listparse(length, vec + at, &status, &channel, data1p, data2p))
+	return (-1);
+    if (status == 0x90 && !*data2p)
+	status = 0x80;
+    return (((status >> 4) - 8) * 16 + channel);
+}
+
+static void xeqfind_domidi(t_xeqfind *f, t_atom *vec, int natoms)
+{
+    t_xeqindex *ix = &f->f_index;
+    int *start = f->f_midistart, i, list, data1, data2;
+    for (list = 0; list <= XEQFIND_NLISTS; list++)
+	start[list] = 0;
+    for (i = 0; i < ix->ix_nevents; i++)
+	if ((list = xeqfind_midilist(vec, natoms, ix->ix_events + i,
+				     &data1, &data2)) >= 0)
+	    start[list + 1]++;
+    for (list = 0; list < XEQFIND_NLISTS; list++)
+	start[list + 1] += start[list];
+    if (!f->f_midi)
+	return;  /* counting only */
+    /* fill, advancing starts to ends, then shift them back */
+    for (i = 0; i < ix->ix_nevents; i++)
+    {
+	if ((list = xeqfind_midilist(vec, natoms, ix->ix_events + i,
+				     &data1, &data2)) >= 0)
+	{
+	    t_xeqfind_midi *mp = f->f_midi + start[list]++;
+	    mp->m_event = i;
+	    mp->m_data1 = data1;
+	    mp->m_data2 = data2;
+	}
+    }
+    for (list = XEQFIND_NLISTS - 1; list >= 0; list--)
+	start[list + 1] = start[list];
+    start[0] = 0;
+}
+
+/* returns host's search index, up to date, or null if out of memory;
+   keys and channel event lists are built when first asked for */
+static t_xeqfind *xeqfind_get(t_xeq *host, int keys, int midi)
+{
+    t_xeqfind *f = host->x_find;
+    t_atom *vec = binbuf_getvec(host->x_binbuf);
+    int natoms = binbuf_getnatom(host->x_binbuf), n;
+    if (!f)
+    {
+	if (!(f = host->x_find = getbytes(sizeof(*f))))
+	    return (0);
+	xeqindex_init(&f->f_index);
+	f->f_generation = 0;
+	f->f_natoms = -1;
+	f->f_haskeys = f->f_hasmidi = 0;
+	f->f_nkeys = f->f_nmidi = 0;
+	f->f_keys = 0;
+	f->f_midi = 0;
+	f->f_target = 0;
+	f->f_length = 0;
+	f->f_pattern = 0;
+	f->f_at = f->f_atnext = -1;
+	f->f_hascriteria = 0;
+	f->f_event = f->f_eventatnext = -1;
+    }
+    if (f->f_generation != host->x_generation || f->f_natoms != natoms)
+    {
+	f->f_at = f->f_atnext = -1;
+	f->f_event = f->f_eventatnext = -1;
+	if (f->f_keys)
+	    freebytes(f->f_keys, f->f_nkeys * sizeof(*f->f_keys));
+	if (f->f_midi)
+	    freebytes(f->f_midi, f->f_nmidi * sizeof(*f->f_midi));
+	f->f_keys = 0;
+	f->f_midi = 0;
+	f->f_nkeys = f->f_nmidi = 0;
+	f->f_haskeys = f->f_hasmidi = 0;
+	f->f_generation = 0;
+	if (xeqindex_build(&f->f_index, host->x_binbuf) < 0)
+	    return (0);
+	f->f_generation = host->x_generation;
+	f->f_natoms = natoms;
+    }
+    if (keys && !f->f_haskeys)
+    {
+	if ((n = xeqfind_dokeys(f, vec, natoms, 0)))
+	{
+	    if (!(f->f_keys = getbytes(n * sizeof(*f->f_keys))))
+		return (0);
+	    f->f_nkeys = n;
+	    xeqfind_dokeys(f, vec, natoms, f->f_keys);
+	    qsort(f->f_keys, n, sizeof(*f->f_keys), xeqfind_compare);
+	}
+	f->f_haskeys = 1;
+    }
+    if (midi && !f->f_hasmidi)
+    {
+	xeqfind_domidi(f, vec, natoms);
+	if ((n = f->f_midistart[XEQFIND_NLISTS]))
+	{
+	    if (!(f->f_midi = getbytes(n * sizeof(*f->f_midi))))
+		return (0);
+	    f->f_nmidi = n;
+	    xeqfind_domidi(f, vec, natoms);
+	}
+	f->f_hasmidi = 1;
+    }
+    return (f);
+}
+
+/* does the message at a position match the pattern? */
+static int xeqfind_check(t_xeqfind *f, t_atom *vec, int natoms, int at)
+{
+    t_atom *ap, *pp = f->f_pattern;
+    int i;
+    if (at > 0 && vec[at - 1].a_type == A_COMMA)
+    {
+	t_xeqevent *ep = f->f_index.ix_events +
+	    xeqindex_findatom(&f->f_index, at);
+	if (f->f_target && (ep->e_attarget < 0 ||
+			    vec[ep->e_attarget].a_w.w_symbol != f->f_target))
+	    return (0);
+    }
+    else
+    {
+	if (f->f_target && vec[at].a_w.w_symbol != f->f_target)
+	    return (0);
+	at++;
+    }
+    if (xeqfind_length(vec, natoms, at) < f->f_length)
+	return (0);
+    for (i = 0, ap = vec + at; i < f->f_length; i++, ap++, pp++)
+    {
+	if (ap->a_type != pp->a_type)
+	    return (0);
+	if (ap->a_type == A_FLOAT ? ap->a_w.w_float != pp->a_w.w_float :
+	    ap->a_w.w_symbol != pp->a_w.w_symbol)
+	    return (0);
+    }
+    return (1);
+}
+
+/* Returns position of the first match not before `from' (if forward),
+   or of the last one before it, or -1 if there is none. */
+static int xeqfind_search(t_xeqfind *f, t_atom *vec, int natoms,
+			  int from, int forward)
+{
+    t_xeqfind_key *keys = f->f_keys;
+    unsigned int hash = xeqfind_hash(f->f_target,
+				     (f->f_length > XEQFIND_KEYSIZE ?
+				      XEQFIND_KEYSIZE : f->f_length),
+				     f->f_pattern);
+    int lo = 0, hi = f->f_nkeys;
+    /* first key not less than (hash, from) */
+    while (lo < hi)
+    {
+	int mid = (lo + hi) >> 1;
+	if (keys[mid].k_hash < hash ||
+	    (keys[mid].k_hash == hash && keys[mid].k_at < from))
+	    lo = mid + 1;
+	else hi = mid;
+    }
+    if (forward)
+    {
+	for (; lo < f->f_nkeys && keys[lo].k_hash == hash; lo++)
+	    if (xeqfind_check(f, vec, natoms, keys[lo].k_at))
+		return (keys[lo].k_at);
+    }
+    else
+    {
+	for (lo--; lo >= 0 && keys[lo].k_hash == hash; lo--)
+	    if (xeqfind_check(f, vec, natoms, keys[lo].k_at))
+		return (keys[lo].k_at);
+    }
+    return (-1);
+}
+
+static int xeqfind_setpattern(t_xeqfind *f, int ac, t_atom *av)
+{
+    int i;
+    if (f->f_pattern)
+	freebytes(f->f_pattern, f->f_length * sizeof(*f->f_pattern));
+    f->f_pattern = 0;
+    f->f_length = 0;
+    f->f_target = 0;
+    if (ac && av->a_type == A_SYMBOL)
+    {
+	f->f_target = av->a_w.w_symbol;
+	ac--;
+	av++;
+    }
+    for (i = 0; i < ac; i++)
+	if (av[i].a_type != A_FLOAT && av[i].a_type != A_SYMBOL)
+	    return (0);
+    if (ac && !(f->f_pattern = getbytes(ac * sizeof(*f->f_pattern))))
+	return (0);
+    if (ac)
+	memcpy(f->f_pattern, av, ac * sizeof(*av));
+    f->f_length = ac;
+    return (1);
+}
+
+/* `find [<target>] <atom> ...', `find next [<locator>]',
+   `find prev [<locator>]' */
+void xeq_findmessage(t_xeq *x, int ac, t_atom *av)
+{
+    t_xeq *host = xeq_gethost(x);
+    t_xeqfind *f;
+    t_atom *vec;
+    int natoms, from = 0, forward = 1, at;
+    if (!host->x_binbuf)
+	return;
+    if (!(f = xeqfind_get(host, 1, 0)))
+    {
+	error("find: no memory");
+	return;
+    }
+    vec = binbuf_getvec(host->x_binbuf);
+    natoms = binbuf_getnatom(host->x_binbuf);
+    if (av->a_type == A_SYMBOL && (av->a_w.w_symbol == gensym("next") ||
+				   av->a_w.w_symbol == gensym("prev")))
+    {
+	t_xeqlocator *loc = &x->x_beditloc;
+	forward = (av->a_w.w_symbol == gensym("next"));
+	if (ac > 1 && av[1].a_type == A_SYMBOL &&
+	    !(loc = xeq_whichloc(x, av[1].a_w.w_symbol)))
+	{
+	    error("find: bad locator %s", av[1].a_w.w_symbol->s_name);
+	    return;
+	}
+	if (!f->f_target && !f->f_length)
+	{
+	    post("find: nothing to search for");
+	    return;
+	}
+	/* continue from the last match, unless bedit was moved since */
+	if (f->f_at >= 0 && loc == &x->x_beditloc &&
+	    loc->l_atnext == f->f_atnext)
+	    from = (forward ? f->f_at + 1 : f->f_at);
+	else if (loc->l_atnext >= 0)
+	    from = loc->l_atnext;
+	else
+	    from = (forward ? 0 : natoms);
+    }
+    else if (!xeqfind_setpattern(f, ac, av))
+    {
+	error("find: bad pattern");
+	return;
+    }
+    if ((at = xeqfind_search(f, vec, natoms, from, forward)) < 0)
+	post("not found...");
+    else
+    {
+	int k = xeqindex_findatom(&f->f_index, at);
+	xeqlocator_settoevent(&x->x_beditloc, &f->f_index, k);
+	f->f_at = at;
+	f->f_atnext = x->x_beditloc.l_atnext;
+	post("found at atom %d, onset %f", at, x->x_beditloc.l_when);
+    }
+}
+
+static int xeqfind_checkevent(t_xeqfind *f, t_atom *vec, t_xeqfind_midi *mp)
+{
+    return (mp->m_data1 >= f->f_data1lo && mp->m_data1 <= f->f_data1hi &&
+	    mp->m_data2 >= f->f_data2lo && mp->m_data2 <= f->f_data2hi &&
+	    (!f->f_track || f->f_track == vec[f->f_index.ix_events[
+		mp->m_event].e_attarget].a_w.w_symbol));
+}
+
+/* Returns number of the first event meeting the criteria, not before
+   `from' (if forward), or of the last one before it, or -1 if there is
+   none.  Scanning a list stops at the best event found in other lists. */
+static int xeqfind_searchevent(t_xeqfind *f, t_atom *vec,
+			       int from, int forward)
+{
+    int best = -1, status, channel;
+    for (status = 0; status < XEQFIND_NSTATUSES; status++)
+    {
+	if (f->f_statuses && !(f->f_statuses & (1 << status)))
+	    continue;
+	for (channel = 0; channel < 16; channel++)
+	{
+	    int list = status * 16 + channel;
+	    t_xeqfind_midi *first = f->f_midi + f->f_midistart[list];
+	    t_xeqfind_midi *last = f->f_midi + f->f_midistart[list + 1];
+	    t_xeqfind_midi *lo = first, *hi = last, *mp;
+	    if (f->f_channels && !(f->f_channels & (1 << channel)))
+		continue;
+	    while (lo < hi)
+	    {
+		t_xeqfind_midi *mid = lo + ((hi - lo) >> 1);
+		if (mid->m_event < from) lo = mid + 1;
+		else hi = mid;
+	    }
+	    if (forward)
+	    {
+		for (mp = lo; mp < last && (best < 0 || mp->m_event < best);
+		     mp++)
+		    if (xeqfind_checkevent(f, vec, mp))
+		    {
+			best = mp->m_event;
+			break;
+		    }
+	    }
+	    else
+	    {
+		for (mp = lo - 1; mp >= first && mp->m_event > best; mp--)
+		    if (xeqfind_checkevent(f, vec, mp))
+		    {
+			best = mp->m_event;
+			break;
+		    }
+	    }
+	}
+    }
+    return (best);
+}
+
+static int xeqfind_range(int ac, t_atom *av, int *lop, int *hip)
+{
+    if (!ac || av->a_type != A_FLOAT)
+	return (0);
+    *lop = *hip = (int)av->a_w.w_float;
+    if (ac > 1 && av[1].a_type == A_FLOAT)
+    {
+	*hip = (int)av[1].a_w.w_float;
+	return (2);
+    }
+    return (1);
+}
+
+/* Parses criteria of `event' into f, and the start of a search into
+   *fromp.  Returns zero if criteria are bad. */
+static int xeqfind_setcriteria(t_xeqfind *f, t_xeq *x,
+			       int ac, t_atom *av, int *fromp)
+{
+    static char *statusnames[XEQFIND_NSTATUSES] =
+	{ "off", "note", "poly", "control", "program", "touch", "bend" };
+    int i, n;
+    f->f_hascriteria = 0;
+    f->f_statuses = f->f_channels = 0;
+    f->f_data1lo = 0;
+    f->f_data1hi = 127;
+    f->f_data2lo = -1;
+    f->f_data2hi = 127;
+    f->f_track = 0;
+    *fromp = 0;
+    while (ac)
+    {
+	char *name;
+	if (av->a_type == A_FLOAT)
+	{
+	    int status = (int)av->a_w.w_float;
+	    if (status < 0x80 || status > 0xef || (status & 0x0f))
+		return (0);
+	    f->f_statuses |= 1 << ((status >> 4) - 8);
+	    ac--, av++;
+	    continue;
+	}
+	if (av->a_type != A_SYMBOL)
+	    return (0);
+	name = av->a_w.w_symbol->s_name;
+	ac--, av++;
+	for (i = 0; i < XEQFIND_NSTATUSES; i++)
+	    if (!strcmp(name, statusnames[i]))
+		break;
+	if (i < XEQFIND_NSTATUSES)
+	    f->f_statuses |= 1 << i;
+	else if (!strcmp(name, "channel"))
+	{
+	    for (n = 0; n < ac && av[n].a_type == A_FLOAT; n++)
+	    {
+		int channel = (int)av[n].a_w.w_float;
+		if (channel < 1 || channel > 16)
+		    return (0);
+		f->f_channels |= 1 << (channel - 1);
+	    }
+	    if (!n)
+		return (0);
+	    ac -= n, av += n;
+	}
+	else if (!strcmp(name, "pitch"))
+	{
+	    if (!(n = xeqfind_range(ac, av, &f->f_data1lo, &f->f_data1hi)))
+		return (0);
+	    ac -= n, av += n;
+	}
+	else if (!strcmp(name, "velocity"))
+	{
+	    if (!(n = xeqfind_range(ac, av, &f->f_data2lo, &f->f_data2hi)))
+		return (0);
+	    ac -= n, av += n;
+	}
+	else if (!strcmp(name, "track") && ac && av->a_type == A_SYMBOL)
+	{
+	    f->f_track = av->a_w.w_symbol;
+	    ac--, av++;
+	}
+	else if (!strcmp(name, "after") && ac)
+	{
+	    if (av->a_type == A_FLOAT)
+		*fromp = xeqindex_findtime(&f->f_index, av->a_w.w_float);
+	    else
+	    {
+		t_xeqlocator *loc;
+		if (av->a_type != A_SYMBOL ||
+		    !(loc = xeq_whichloc(x, av->a_w.w_symbol)))
+		    return (0);
+		if (loc->l_atnext >= 0)
+		    *fromp = xeqindex_findatom(&f->f_index, loc->l_atnext);
+	    }
+	    ac--, av++;
+	}
+	else return (0);
+    }
+    f->f_hascriteria = 1;
+    return (1);
+}
+
+/* `event <criterion> ...', `event next [<locator>]',
+   `event prev [<locator>]' */
+void xeq_findevent(t_xeq *x, int ac, t_atom *av)
+{
+    t_xeq *host = xeq_gethost(x);
+    t_xeqfind *f;
+    t_atom *vec;
+    int from = 0, forward = 1, k;
+    if (!host->x_binbuf)
+	return;
+    if (!(f = xeqfind_get(host, 0, 1)))
+    {
+	error("event: no memory");
+	return;
+    }
+    vec = binbuf_getvec(host->x_binbuf);
+    if (av->a_type == A_SYMBOL && (av->a_w.w_symbol == gensym("next") ||
+				   av->a_w.w_symbol == gensym("prev")))
+    {
+	t_xeqlocator *loc = &x->x_beditloc;
+	forward = (av->a_w.w_symbol == gensym("next"));
+	if (ac > 1 && av[1].a_type == A_SYMBOL &&
+	    !(loc = xeq_whichloc(x, av[1].a_w.w_symbol)))
+	{
+	    error("event: bad locator %s", av[1].a_w.w_symbol->s_name);
+	    return;
+	}
+	if (!f->f_hascriteria)
+	{
+	    post("event: nothing to search for");
+	    return;
+	}
+	/* continue from the last match, unless bedit was moved since */
+	if (f->f_event >= 0 && loc == &x->x_beditloc &&
+	    loc->l_atnext == f->f_eventatnext)
+	    from = (forward ? f->f_event + 1 : f->f_event);
+	else if (loc->l_atnext >= 0)
+	    from = xeqindex_findatom(&f->f_index, loc->l_atnext);
+	else
+	    from = (forward ? 0 : f->f_index.ix_nevents);
+    }
+    else if (!xeqfind_setcriteria(f, x, ac, av, &from))
+    {
+	error("event: bad criteria");
+	return;
+    }
+    if ((k = xeqfind_searchevent(f, vec, from, forward)) < 0)
+	post("not found...");
+    else
+    {
+	xeqlocator_settoevent(&x->x_beditloc, &f->f_index, k);
+	f->f_event = k;
+	f->f_eventatnext = x->x_beditloc.l_atnext;
+	post("found at atom %d, onset %f",
+	     x->x_beditloc.l_atnext, x->x_beditloc.l_when);
+    }
+}
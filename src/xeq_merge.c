@@ -0,0 +1,460 @@
+/* Copyright (c) 1997-2002 Miller Puckette and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* Merging and splitting of sequences.  `merge <host> ...' replaces the sequence of
+   a host with the sequences of the hosts given (the host itself may be
+   among them), interleaved by onset.  Events are taken from a heap of
+   sources, keyed by onset of a source's next event, so that merging
+   n events of k sources takes n log k steps.  Simultaneous events keep
+   their order within a source, and sources keep the order they are
+   given in.  With `merge -tracks <host> ...' channel events of the i-th
+   source are sent to track `i-<host>'.
+
+   Deltas are recomputed from onsets, delays alone are dropped (but the
+   end of the longest sequence is kept).  The merge is run twice, first
+   to count output atoms, and then to fill an output vector of exactly
+   that size.
+
+   `split' goes the other way: events of every target go to the host
+   of the same name, or, as in `split <target> <host> ...', to the
+   hosts given, several targets possibly sharing a host.  Events of
+   other targets are skipped, and the host split is left untouched.
+   Every part keeps the length of the whole.  As with merging, a pass
+   over the event index counts atoms of every part, and another one
+   fills them.  LATER create missing hosts? */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "m_pd.h"
+#include "shared.h"
+#include "sq.h"
+#include "hyphen.h"
+#include "xeq.h"
+
+typedef struct _xeqmerge_source
+{
+    t_atom      *s_vec;
+    int          s_natoms;
+    t_xeqindex   s_index;
+    int          s_next;   /* index of next event */
+    t_symbol    *s_track;  /* retargeting channel events, if nonzero */
+} t_xeqmerge_source;
+
+typedef struct _xeqmerge
+{
+    int                 m_nsources;
+    t_xeqmerge_source  *m_sources;
+    int                 m_nheap;
+    int                *m_heap;  /* sources having events left */
+} t_xeqmerge;
+
+/* Writes an event (if out is nonzero) at a given delta from previous one,
+   with its target replaced, if track is nonzero.  Returns number of atoms
+   (zero for a delay alone). */
+static int xeqmerge_putevent(t_atom *out, t_atom *vec, int natoms,
+			     t_xeqevent *ep, double delta, t_symbol *track)
+{
+    t_atom *ap = out;
+    int body = ep->e_atstart, count = 0;
+    while (body < ep->e_atend && vec[body].a_type == A_FLOAT)
+	body++;
+    if (body == ep->e_atend)
+	return (0);
+    if (ep->e_atstart < body)
+	count = body - ep->e_atstart;
+    else if (delta > 0)
+	count = 1;
+    count += ep->e_atend - body + 1;
+    if (!out)
+	return (count);
+    if (ep->e_atstart < body)
+    {
+	memcpy(ap, vec + ep->e_atstart, (body - ep->e_atstart) * sizeof(*ap));
+	SETFLOAT(ap, delta);
+	ap += body - ep->e_atstart;
+    }
+    else if (delta > 0)
+    {
+	SETFLOAT(ap, delta);
+	ap++;
+    }
+    memcpy(ap, vec + body, (ep->e_atend - body) * sizeof(*ap));
+    if (track && body == ep->e_attarget)
+    {
+	int status, channel, data1, data2;
+	if (ep->e_atend - body > 1 && ap[1].a_type == A_FLOAT &&
+	    xeq_listparse(ep->e_atend - body - 1, ap + 1,
+			  &status, &channel, &data1, &data2))
+	    SETSYMBOL(ap, track);
+    }
+    ap += ep->e_atend - body;
+    if (ep->e_atend < natoms)
+	*ap = vec[ep->e_atend];
+    else
+	SETSEMI(ap);
+    return (count);
+}
+
+static int xeqmerge_before(t_xeqmerge *m, int s1, int s2)
+{
+    t_xeqmerge_source *sp1 = m->m_sources + s1, *sp2 = m->m_sources + s2;
+    double t1 = sp1->s_index.ix_events[sp1->s_next].e_onset;
+    double t2 = sp2->s_index.ix_events[sp2->s_next].e_onset;
+    return (t1 < t2 || (t1 == t2 && s1 < s2));
+}
+
+static void xeqmerge_siftdown(t_xeqmerge *m, int ndx)
+{
+    int *heap = m->m_heap, n = m->m_nheap, source = heap[ndx];
+    while (1)
+    {
+	int child = 2 * ndx + 1;
+	if (child >= n)
+	    break;
+	if (child + 1 < n && xeqmerge_before(m, heap[child + 1], heap[child]))
+	    child++;
+	if (!xeqmerge_before(m, heap[child], source))
+	    break;
+	heap[ndx] = heap[child];
+	ndx = child;
+    }
+    heap[ndx] = source;
+}
+
+static void xeqmerge_start(t_xeqmerge *m)
+{
+    int i;
+    m->m_nheap = 0;
+    for (i = 0; i < m->m_nsources; i++)
+    {
+	m->m_sources[i].s_next = 0;
+	if (m->m_sources[i].s_index.ix_nevents)
+	    m->m_heap[m->m_nheap++] = i;
+    }
+    for (i = m->m_nheap / 2 - 1; i >= 0; i--)
+	xeqmerge_siftdown(m, i);
+}
+
+/* Returns number of atoms merged, writing them if out is nonzero. */
+static int xeqmerge_run(t_xeqmerge *m, t_atom *out)
+{
+    double written = 0, end = 0;
+    int i, count = 0;
+    xeqmerge_start(m);
+    while (m->m_nheap)
+    {
+	t_xeqmerge_source *sp = m->m_sources + m->m_heap[0];
+	t_xeqevent *ep = sp->s_index.ix_events + sp->s_next;
+	double delta = ep->e_onset - written;
+	int n = xeqmerge_putevent((out ? out + count : 0), sp->s_vec,
+				  sp->s_natoms, ep, delta, sp->s_track);
+	if (n)
+	{
+	    count += n;
+	    written = ep->e_onset;
+	}
+	if (++sp->s_next == sp->s_index.ix_nevents)
+	    m->m_heap[0] = m->m_heap[--m->m_nheap];
+	if (m->m_nheap)
+	    xeqmerge_siftdown(m, 0);
+    }
+    for (i = 0; i < m->m_nsources; i++)
+    {
+	t_xeqindex *ix = &m->m_sources[i].s_index;
+	if (ix->ix_events[ix->ix_nevents].e_onset > end)
+	    end = ix->ix_events[ix->ix_nevents].e_onset;
+    }
+    if (end > written)
+    {
+	if (out)
+	{
+	    SETFLOAT(out + count, end - written);
+	    SETSEMI(out + count + 1);
+	}
+	count += 2;
+    }
+    return (count);
+}
+
+/* `merge [-tracks] <host> ...' */
+void xeq_merge(t_xeq *x, t_symbol *s, int ac, t_atom *av)
+{
+    t_xeqmerge m;
+    t_atom *out = 0;
+    t_binbuf *bb;
+    int i, retarget = 0, natoms = 0;
+    if (ac && av->a_type == A_SYMBOL &&
+	!strcmp(av->a_w.w_symbol->s_name, "-tracks"))
+	retarget = 1, ac--, av++;
+    if (!ac)
+    {
+	error("merge: host names needed");
+	return;
+    }
+    m.m_nsources = ac;
+    m.m_sources = getbytes(ac * sizeof(*m.m_sources));
+    m.m_heap = getbytes(ac * sizeof(*m.m_heap));
+    if (m.m_sources)
+	for (i = 0; i < ac; i++)
+	    xeqindex_init(&m.m_sources[i].s_index);
+    if (!m.m_sources || !m.m_heap)
+	goto nomemory;
+    for (i = 0; i < ac; i++)
+    {
+	t_xeqmerge_source *sp = m.m_sources + i;
+	t_xeq *host;
+	if (av[i].a_type != A_SYMBOL ||
+	    !(host = (t_xeq *)hyphen_findhost((t_hyphen *)x,
+					      av[i].a_w.w_symbol)) ||
+	    !host->x_binbuf)
+	{
+	    if (av[i].a_type == A_SYMBOL)
+		post("merge: bad host %s", av[i].a_w.w_symbol->s_name);
+	    else
+		post("merge: bad host");
+	    goto done;
+	}
+	sp->s_vec = binbuf_getvec(host->x_binbuf);
+	sp->s_natoms = binbuf_getnatom(host->x_binbuf);
+	sp->s_track = 0;
+	if (retarget)
+	{
+	    char buf[MAXPDSTRING];
+	    sprintf(buf, "%d-%.*s", i + 1, MAXPDSTRING - 16,
+		    av[i].a_w.w_symbol->s_name);
+	    sp->s_track = gensym(buf);
+	}
+	if (xeqindex_build(&sp->s_index, host->x_binbuf) < 0)
+	    goto nomemory;
+    }
+    natoms = xeqmerge_run(&m, 0);
+    if (natoms && !(out = getbytes(natoms * sizeof(*out))))
+	goto nomemory;
+    xeqmerge_run(&m, out);
+    bb = binbuf_new();
+    binbuf_add(bb, natoms, out);
+    xeq_setsequence(x, bb);
+    goto done;
+nomemory:
+    error("merge: no memory");
+done:
+    if (out) freebytes(out, natoms * sizeof(*out));
+    if (m.m_sources)
+    {
+	for (i = 0; i < ac; i++)
+	    xeqindex_free(&m.m_sources[i].s_index);
+	freebytes(m.m_sources, ac * sizeof(*m.m_sources));
+    }
+    if (m.m_heap) freebytes(m.m_heap, ac * sizeof(*m.m_heap));
+}
+
+typedef struct _xeqsplit_target
+{
+    t_symbol  *t_target;
+    int        t_part;  /* -1 if skipped */
+} t_xeqsplit_target;
+
+typedef struct _xeqsplit_part
+{
+    t_xeq   *p_host;
+    double   p_written;
+    int      p_natoms;
+    t_atom  *p_out;
+} t_xeqsplit_part;
+
+static int xeqsplit_compare(const void *p1, const void *p2)
+{
+    t_symbol *s1 = ((t_xeqsplit_target *)p1)->t_target;
+    t_symbol *s2 = ((t_xeqsplit_target *)p2)->t_target;
+    return (s1 < s2 ? -1 : (s1 > s2 ? 1 : 0));
+}
+
+/* Distinct targets of a sequence, sorted by address, parts unset.
+   Returns their number, or -1 if out of memory. */
+static int xeqsplit_gettargets(t_xeqindex *ix, t_atom *vec,
+			       t_xeqsplit_target **targetsp)
+{
+    t_xeqsplit_target *targets;
+    int i, ntargets = 0, nunique;
+    for (i = 0; i < ix->ix_nevents; i++)
+	if (ix->ix_events[i].e_attarget >= 0)
+	    ntargets++;
+    *targetsp = 0;
+    if (!ntargets)
+	return (0);
+    if (!(targets = getbytes(ntargets * sizeof(*targets))))
+	return (-1);
+    for (i = 0, ntargets = 0; i < ix->ix_nevents; i++)
+	if (ix->ix_events[i].e_attarget >= 0)
+	{
+	    targets[ntargets].t_target =
+		vec[ix->ix_events[i].e_attarget].a_w.w_symbol;
+	    targets[ntargets++].t_part = -1;
+	}
+    qsort(targets, ntargets, sizeof(*targets), xeqsplit_compare);
+    for (i = 1, nunique = 1; i < ntargets; i++)
+	if (targets[i].t_target != targets[nunique - 1].t_target)
+	    targets[nunique++] = targets[i];
+    *targetsp = resizebytes(targets, ntargets * sizeof(*targets),
+			    nunique * sizeof(*targets));
+    return (nunique);
+}
+
+/* returns part index of a host, adding a part if needed */
+static int xeqsplit_getpart(t_xeq *host, t_xeqsplit_part *parts, int *nparts)
+{
+    int i;
+    for (i = 0; i < *nparts; i++)
+	if (parts[i].p_host == host)
+	    return (i);
+    parts[i].p_host = host;
+    parts[i].p_natoms = 0;
+    parts[i].p_out = 0;
+    (*nparts)++;
+    return (i);
+}
+
+/* Counts atoms of every part or, if filling, writes them (counts come
+   out the same, and are those of allocated vectors). */
+static void xeqsplit_run(t_xeqindex *ix, t_atom *vec, int natoms,
+			 t_xeqsplit_target *targets, int ntargets,
+			 t_xeqsplit_part *parts, int nparts, int filling)
+{
+    double end = ix->ix_events[ix->ix_nevents].e_onset;
+    int i, count;
+    for (i = 0; i < nparts; i++)
+    {
+	parts[i].p_written = 0;
+	if (filling)
+	    parts[i].p_natoms = 0;
+    }
+    for (i = 0; i < ix->ix_nevents; i++)
+    {
+	t_xeqevent *ep = ix->ix_events + i;
+	t_xeqsplit_target key, *tp;
+	t_xeqsplit_part *pp;
+	if (ep->e_attarget < 0)
+	    continue;
+	key.t_target = vec[ep->e_attarget].a_w.w_symbol;
+	if (!(tp = bsearch(&key, targets, ntargets, sizeof(*targets),
+			   xeqsplit_compare)) || tp->t_part < 0)
+	    continue;
+	pp = parts + tp->t_part;
+	count = xeqmerge_putevent((filling ? pp->p_out + pp->p_natoms : 0),
+				  vec, natoms, ep, ep->e_onset - pp->p_written, 0);
+	if (count)
+	{
+	    pp->p_natoms += count;
+	    pp->p_written = ep->e_onset;
+	}
+    }
+    for (i = 0; i < nparts; i++)
+    {
+	t_xeqsplit_part *pp = parts + i;
+	if (end > pp->p_written)
+	{
+	    if (filling)
+	    {
+		SETFLOAT(pp->p_out + pp->p_natoms, end - pp->p_written);
+		SETSEMI(pp->p_out + pp->p_natoms + 1);
+	    }
+	    pp->p_natoms += 2;
+	}
+    }
+}
+
+/* `split' or `split <target> <host> ...' */
+void xeq_split(t_xeq *x, t_symbol *s, int ac, t_atom *av)
+{
+    t_xeq *host = xeq_gethost(x);
+    t_xeqsplit_target *targets = 0;
+    t_xeqsplit_part *parts = 0;
+    t_xeqindex ix;
+    t_atom *vec;
+    int i, ntargets = 0, nparts = 0, natoms;
+    if (!host->x_binbuf)
+	return;
+    if (ac & 1)
+    {
+	error("split: targets and hosts should come in pairs");
+	return;
+    }
+    xeqindex_init(&ix);
+    vec = binbuf_getvec(host->x_binbuf);
+    natoms = binbuf_getnatom(host->x_binbuf);
+    if (xeqindex_build(&ix, host->x_binbuf) < 0 ||
+	(ntargets = xeqsplit_gettargets(&ix, vec, &targets)) < 0)
+	goto nomemory;
+    if (!ntargets)
+	goto done;
+    if (!(parts = getbytes(ntargets * sizeof(*parts))))
+	goto nomemory;
+    if (ac)
+    {
+	for (i = 0; i < ac; i += 2)
+	{
+	    t_xeqsplit_target key, *tp;
+	    t_xeq *parthost;
+	    if (av[i].a_type != A_SYMBOL || av[i + 1].a_type != A_SYMBOL)
+	    {
+		error("split: bad arguments");
+		goto done;
+	    }
+	    if (!(parthost = (t_xeq *)hyphen_findhost((t_hyphen *)host,
+						      av[i + 1].a_w.w_symbol))
+		|| parthost == host || !parthost->x_binbuf)
+	    {
+		post("split: bad host %s", av[i + 1].a_w.w_symbol->s_name);
+		goto done;
+	    }
+	    key.t_target = av[i].a_w.w_symbol;
+	    tp = bsearch(&key, targets, ntargets, sizeof(*targets),
+			 xeqsplit_compare);
+	    /* no target goes twice, so there are no more parts than
+	       targets */
+	    if (tp && tp->t_part >= 0)
+	    {
+		post("split: %s given twice", av[i].a_w.w_symbol->s_name);
+		goto done;
+	    }
+	    else if (tp)
+		tp->t_part = xeqsplit_getpart(parthost, parts, &nparts);
+	    else
+		post("split: no events of %s", av[i].a_w.w_symbol->s_name);
+	}
+    }
+    else for (i = 0; i < ntargets; i++)
+    {
+	t_xeq *parthost = (t_xeq *)hyphen_findhost((t_hyphen *)host,
+						   targets[i].t_target);
+	if (parthost && parthost != host && parthost->x_binbuf)
+	    targets[i].t_part = xeqsplit_getpart(parthost, parts, &nparts);
+    }
+    xeqsplit_run(&ix, vec, natoms, targets, ntargets, parts, nparts, 0);
+    for (i = 0; i < nparts; i++)
+	if (parts[i].p_natoms &&
+	    !(parts[i].p_out = getbytes(parts[i].p_natoms *
+					sizeof(*parts[i].p_out))))
+	    goto nomemory;
+    xeqsplit_run(&ix, vec, natoms, targets, ntargets, parts, nparts, 1);
+    for (i = 0; i < nparts; i++)
+    {
+	t_binbuf *bb = binbuf_new();
+	binbuf_add(bb, parts[i].p_natoms, parts[i].p_out);
+	xeq_setsequence(parts[i].p_host, bb);
+    }
+    goto done;
+nomemory:
+    error("split: no memory");
+done:
+    for (i = 0; i < nparts; i++)
+	if (parts[i].p_out)
+	    freebytes(parts[i].p_out, parts[i].p_natoms *
+		      sizeof(*parts[i].p_out));
+    if (parts) freebytes(parts, ntargets * sizeof(*parts));
+    if (targets) freebytes(targets, ntargets * sizeof(*targets));
+    xeqindex_free(&ix);
+}
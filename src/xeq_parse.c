@@ -23,6 +23,8 @@ typedef struct _xeq_parse
     t_outlet  *x_bendout;
     t_outlet  *x_chanout;
     t_outlet  *x_bangout;
+    int        x_packed;  /* XEQ_PACKED_... */
+    int        x_batch;   /* pass simultaneous events together */
 } t_xeq_parse;
 
 static t_class *xeq_parse_class;
@@ -43,46 +45,59 @@ static void xeqithook_parse_stepdelay(t_xeqit *it, int argc, t_atom *argv)
     post("parse step");
 }
 
+static void xeq_parse_outevent(t_xeq_parse *x, int status, int channel,
+			       int data1, int data2)
+{
+    t_atom at[3];
+    outlet_float(x->x_chanout, channel + 1);
+    SETFLOAT(&at[0], data1);
+    if (data2 >= 0) SETFLOAT(&at[1], data2);
+    switch (status)
+    {
+    case 0x80:
+	SETFLOAT(&at[1], 0);
+    case 0x90:
+	outlet_list(((t_object *)x)->ob_outlet, 0, 2, at);
+	break;
+    case 0xa0:
+	at[2] = at[0];
+	outlet_list(x->x_polyout, 0, 2, &at[1]);
+	break;
+    case 0xb0:
+	at[2] = at[0];
+	outlet_list(x->x_ctlout, 0, 2, &at[1]);
+	break;
+    case 0xc0:
+	outlet_float(x->x_pgmout, data1);
+	break;
+    case 0xd0:
+	outlet_float(x->x_touchout, data1);
+	break;
+    case 0xe0:
+	/* LATER check this */
+	outlet_float(x->x_bendout, (data1 << 7) + data2);
+	break;
+    default:;
+    }
+}
+
 static void xeqithook_parse_message(t_xeqit *it,
 				    t_symbol *target, int argc, t_atom *argv)
 {
     t_xeq *base = (t_xeq *)it->i_owner;
     t_xeq_parse *x = (t_xeq_parse *)((t_hyphen *)base)->x_self;
     t_pd *dest = target->s_thing;
-    t_atom at[3];
-    if (it->i_status)
+    t_atom at[XEQ_PACKED_MAXATOMS];
+    if (it->i_status && x->x_packed)
     {
-	outlet_float(x->x_chanout, it->i_channel + 1);
-	SETFLOAT(&at[0], it->i_data1);
-	if (it->i_data2 >= 0) SETFLOAT(&at[1], it->i_data2);
-	switch (it->i_status)
-	{
-	case 0x80:
-	    SETFLOAT(&at[1], 0);
-	case 0x90:
-	    outlet_list(((t_object *)x)->ob_outlet, 0, 2, at);
-	    break;
-	case 0xa0:
-	    at[2] = at[0];
-	    outlet_list(x->x_polyout, 0, 2, &at[1]);
-	    break;
-	case 0xb0:
-	    at[2] = at[0];
-	    outlet_list(x->x_ctlout, 0, 2, &at[1]);
-	    break;
-	case 0xc0:
-	    outlet_float(x->x_pgmout, it->i_data1);
-	    break;
-	case 0xd0:
-	    outlet_float(x->x_touchout, it->i_data1);
-	    break;
-	case 0xe0:
-	    /* LATER check this */
-	    outlet_float(x->x_bendout, (it->i_data1 << 7) + it->i_data2);
-	    break;
-	default:;
-	}
+	/* whole event, through the left outlet */
+	outlet_list(((t_object *)x)->ob_outlet, 0,
+		    xeq_packmidi(at, x->x_packed, it->i_status, it->i_channel,
+				 it->i_data1, it->i_data2), at);
     }
+    else if (it->i_status)
+	xeq_parse_outevent(x, it->i_status, it->i_channel,
+			   it->i_data1, it->i_data2);
     else if (dest)
     {
 	if (argv->a_type == A_FLOAT)
@@ -92,6 +107,47 @@ static void xeqithook_parse_message(t_xeqit *it,
     }
 }
 
+/* Simultaneous notes go out as a single list of pitch-velocity pairs,
+   one per channel, other channel events as usual.  In packed mode,
+   all events are put in a single list. */
+static void xeqithook_parse_batch(t_xeqit *it, int nevents,
+				  t_xeqmidi *events)
+{
+    t_xeq *base = (t_xeq *)it->i_owner;
+    t_xeq_parse *x = (t_xeq_parse *)((t_hyphen *)base)->x_self;
+    t_atom at[XEQ_MAXBATCH * XEQ_PACKED_MAXATOMS];
+    t_xeqmidi *mp = events, *endp = events + nevents;
+    if (x->x_packed)
+    {
+	int natoms = 0;
+	for (; mp < endp; mp++)
+	    natoms += xeq_packmidi(at + natoms, x->x_packed, mp->m_status,
+				   mp->m_channel, mp->m_data1, mp->m_data2);
+	outlet_list(((t_object *)x)->ob_outlet, 0, natoms, at);
+	return;
+    }
+    while (mp < endp)
+    {
+	int channel = mp->m_channel, natoms = 0;
+	if (mp->m_status != 0x80 && mp->m_status != 0x90)
+	{
+	    xeq_parse_outevent(x, mp->m_status, channel,
+			       mp->m_data1, mp->m_data2);
+	    mp++;
+	    continue;
+	}
+	for (; mp < endp && mp->m_channel == channel &&
+		 (mp->m_status == 0x80 || mp->m_status == 0x90); mp++)
+	{
+	    SETFLOAT(&at[natoms], mp->m_data1); natoms++;
+	    SETFLOAT(&at[natoms], mp->m_status == 0x80 ? 0 : mp->m_data2);
+	    natoms++;
+	}
+	outlet_float(x->x_chanout, channel + 1);
+	outlet_list(((t_object *)x)->ob_outlet, 0, natoms, at);
+    }
+}
+
 static void xeqithook_parse_finish(t_xeqit *it)
 {
     t_xeq *base = (t_xeq *)it->i_owner;
@@ -142,6 +198,8 @@ static void *xeq_parse_new(t_symbol *seqname, t_symbol *refname)
     x->x_bendout = outlet_new((t_object *)x, &s_float);
     x->x_chanout = outlet_new((t_object *)x, &s_float);
     x->x_bangout = outlet_new((t_object *)x, &s_bang);
+    x->x_packed = XEQ_PACKED_OFF;
+    x->x_batch = 0;
     return (x);
 }
 
@@ -172,25 +230,44 @@ static void xeq_parse_tempo(t_xeq_parse *x, t_floatarg f)
     xeq_tempo(XEQ_BASE(x), f);
 }
 
+static void xeq_parse_packed(t_xeq_parse *x, t_symbol *s, int ac, t_atom *av)
+{
+    int mode = xeq_packedmode(ac, av);
+    if (mode >= 0) x->x_packed = mode;
+}
+
+static void xeq_parse_batch(t_xeq_parse *x, t_floatarg f)
+{
+    x->x_batch = (f != 0);
+    xeqit_setbatchhook(&XEQ_BASE(x)->x_autoit,
+		       x->x_batch ? xeqithook_parse_batch : 0);
+}
+
 /* PLAYBACK CONTROL METHODS */
 
 static void xeq_parse_flush(t_xeq_parse *x)
 {
     t_xeq *base = XEQ_BASE(x);
     int channel, key, transposed;
-    t_atom at[2];
-    SETFLOAT(&at[1], 0);
+    t_atom at[XEQ_PACKED_MAXATOMS];
     for (channel = 0; channel < 16; channel++)
     {
 	for (key = 0; key < 128; key++)
 	{
-	    if ((transposed = base->x_noteons[channel][key]) >= 0)
+	    if ((transposed = base->x_noteons[channel][key]) < 0)
+		continue;
+	    if (x->x_packed)
+		outlet_list(((t_object *)x)->ob_outlet, 0,
+			    xeq_packmidi(at, x->x_packed,
+					 0x90, channel, transposed, 0), at);
+	    else
 	    {
 		outlet_float(x->x_chanout, channel);
 		SETFLOAT(&at[0], transposed);
+		SETFLOAT(&at[1], 0);
 		outlet_list(((t_object *)x)->ob_outlet, 0, 2, at);
-		base->x_noteons[channel][key] = -1;
 	    }
+	    base->x_noteons[channel][key] = -1;
 	}
     }
 }
@@ -227,6 +304,8 @@ static void xeq_parse_dobang(t_xeq_parse *x)
 	xeqit_sethooks(&base->x_autoit, xeqithook_parse_autodelay,
 		       xeqithook_applypp, xeqithook_parse_message,
 		       xeqithook_parse_finish, xeqithook_parse_loopover);
+	xeqit_setbatchhook(&base->x_autoit,
+			   x->x_batch ? xeqithook_parse_batch : 0);
 	xeq_start(base);
     }
 }
@@ -283,6 +362,10 @@ void xeq_parse_dosetup(void)
 		    gensym("transpo"), A_DEFFLOAT, 0);
     class_addmethod(xeq_parse_class, (t_method)xeq_parse_tempo,
 		    gensym("tempo"), A_DEFFLOAT, 0);
+    class_addmethod(xeq_parse_class, (t_method)xeq_parse_packed,
+		    gensym("packed"), A_GIMME, 0);
+    class_addmethod(xeq_parse_class, (t_method)xeq_parse_batch,
+		    gensym("batch"), A_DEFFLOAT, 0);
 
     class_addbang(xeq_parse_class, xeq_parse_bang);
     class_addmethod(xeq_parse_class, (t_method)xeq_parse_next,
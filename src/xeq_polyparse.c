@@ -26,8 +26,21 @@ typedef struct _xeq_polyparse
     t_outlet  *x_chanout;
     t_outlet  *x_layerout;
     t_outlet  *x_finout;
+    int        x_packed;  /* XEQ_PACKED_... */
 } t_xeq_polyparse;
 
+/* whole event, prefixed with a layer number, through the left outlet */
+static void xeq_polyparse_outpacked(t_xeq_polyparse *x, int layer,
+				    int status, int channel,
+				    int data1, int data2)
+{
+    t_atom at[XEQ_PACKED_MAXATOMS];
+    SETFLOAT(at, layer + 1);
+    outlet_list(((t_object *)x)->ob_outlet, 0,
+		1 + xeq_packmidi(at + 1, x->x_packed,
+				 status, channel, data1, data2), at);
+}
+
 static t_class *xeq_polyparse_class;
 
 /* SEQUENCE TRAVERSING HOOKS */
@@ -53,7 +66,10 @@ static void xeqithook_polyparse_message(t_xeqit *it, t_symbol *target,
     t_xeq_polyparse *x = (t_xeq_polyparse *)((t_hyphen *)base)->x_self;
     t_pd *dest = target->s_thing;
     t_atom at[2];
-    if (it->i_status)
+    if (it->i_status && x->x_packed)
+	xeq_polyparse_outpacked(x, ((t_hyphen *)base)->x_id, it->i_status,
+				it->i_channel, it->i_data1, it->i_data2);
+    else if (it->i_status)
     {
 	outlet_float(x->x_layerout, ((t_hyphen *)base)->x_id + 1);
 	outlet_float(x->x_chanout, it->i_channel + 1);
@@ -102,7 +118,13 @@ static void xeqithook_polyparse_muted(t_xeqit *it, t_symbol *target,
     t_atom at[2];
     if (it->i_status)
     {
-	if (it->i_status == 0x80 || (it->i_status == 0x90 && !it->i_data2))
+	if (x->x_packed &&
+	    (it->i_status == 0x80 || (it->i_status == 0x90 && !it->i_data2)))
+	    xeq_polyparse_outpacked(x, ((t_hyphen *)base)->x_id,
+				    it->i_status, it->i_channel,
+				    it->i_data1, it->i_data2);
+	else if (it->i_status == 0x80 ||
+		 (it->i_status == 0x90 && !it->i_data2))
 	{
 	    outlet_float(x->x_layerout, ((t_hyphen *)base)->x_id + 1);
 	    outlet_float(x->x_chanout, it->i_channel + 1);
@@ -180,6 +202,7 @@ static void *xeq_polyparse_new(t_symbol *seqname, t_symbol *refname,
     x->x_chanout = outlet_new((t_object *)x, &s_float);
     x->x_layerout = outlet_new((t_object *)x, &s_float);
     x->x_finout = outlet_new((t_object *)x, &s_float);
+    x->x_packed = XEQ_PACKED_OFF;
     return (x);
 }
 
@@ -255,6 +278,13 @@ static void xeq_polyparse_tempo(t_xeq_polyparse *x, t_floatarg f)
     }
 }
 
+static void xeq_polyparse_packed(t_xeq_polyparse *x,
+				 t_symbol *s, int ac, t_atom *av)
+{
+    int mode = xeq_packedmode(ac, av);
+    if (mode >= 0) x->x_packed = mode;
+}
+
 /* PLAYBACK CONTROL METHODS */
 
 static void xeq_polyparse_flush(t_xeq_polyparse *x)
@@ -270,14 +300,19 @@ static void xeq_polyparse_flush(t_xeq_polyparse *x)
 	{
 	    for (key = 0; key < 128; key++)
 	    {
-		if ((transposed = base->x_noteons[channel][key]) >= 0)
+		if ((transposed = base->x_noteons[channel][key]) < 0)
+		    continue;
+		if (x->x_packed)
+		    xeq_polyparse_outpacked(x, layer, 0x90, channel,
+					    transposed, 0);
+		else
 		{
 		    outlet_float(x->x_layerout, layer + 1);
 		    outlet_float(x->x_chanout, channel);
 		    SETFLOAT(&at[0], transposed);
 		    outlet_list(((t_object *)x)->ob_outlet, 0, 2, at);
-		    base->x_noteons[channel][key] = -1;
 		}
+		base->x_noteons[channel][key] = -1;
 	    }
 	}
     }
@@ -401,10 +436,10 @@ static void xeq_polyparse_sync(t_xeq_polyparse *x, t_floatarg f)
 	t_xeqit *refit = &base->x_autoit;
 	t_xeqlocator *loc, *refloc = &refit->i_playloc;
 	int i;
-	float clockleft = 0;  /* FIXME */
+	double clockleft = 0;  /* FIXME */
 	if (base->x_whenclockset != 0)
 	{
-	    float elapsed = clock_gettimesince(base->x_whenclockset);
+	    double elapsed = clock_gettimesince(base->x_whenclockset);
 	    clockleft = base->x_clockdelay - elapsed;
 	    if (clockleft < 0) clockleft = 0;
 	}
@@ -499,6 +534,8 @@ void xeq_polyparse_dosetup(void)
 		    gensym("transpo"), A_DEFFLOAT, 0);
     class_addmethod(xeq_polyparse_class, (t_method)xeq_polyparse_tempo,
 		    gensym("tempo"), A_DEFFLOAT, 0);
+    class_addmethod(xeq_polyparse_class, (t_method)xeq_polyparse_packed,
+		    gensym("packed"), A_GIMME, 0);
 
     class_addbang(xeq_polyparse_class, xeq_polyparse_bang);
     class_addmethod(xeq_polyparse_class, (t_method)xeq_polyparse_next,
@@ -85,6 +85,49 @@ static void xeq_query_natoms(t_xeq_query *x, t_symbol *s, int ac, t_atom *av)
     }
 }
 
+#ifdef XEQ_STATS
+static void xeq_query_outstat(t_xeq_query *x, t_symbol *s,
+			      char *name, double value)
+{
+    SETSYMBOL(&x->x_buffer[0], gensym(name));
+    SETFLOAT(&x->x_buffer[1], value);
+    outlet_anything(((t_object *)x)->ob_outlet, s, 2, x->x_buffer);
+}
+#endif
+
+/* Counters of the host and all its friends, one message per counter:
+   `stats <name> <value>', times in milliseconds.  `stats reset' clears
+   them. */
+static void xeq_query_stats(t_xeq_query *x, t_symbol *s, int ac, t_atom *av)
+{
+#ifdef XEQ_STATS
+    t_xeq *host = XEQ_HOST(x);
+    t_xeqstats st;
+    if (!host)
+	return;
+    if (ac && av->a_type == A_SYMBOL && av->a_w.w_symbol == gensym("reset"))
+    {
+	xeqstats_resetall(host);
+	return;
+    }
+    xeqstats_collect(host, &st);
+    xeq_query_outstat(x, s, "events", st.s_nevents);
+    xeq_query_outstat(x, s, "ticks", st.s_nticks);
+    xeq_query_outstat(x, s, "maxpertick", st.s_maxpertick);
+    xeq_query_outstat(x, s, "steptime", st.s_steptime);
+    xeq_query_outstat(x, s, "maxsteptime", st.s_maxsteptime);
+    xeq_query_outstat(x, s, "fires", st.s_nfires);
+    xeq_query_outstat(x, s, "latetime", st.s_latetime);
+    xeq_query_outstat(x, s, "maxlatetime", st.s_maxlatetime);
+    xeq_query_outstat(x, s, "seeks", st.s_nseeks);
+    xeq_query_outstat(x, s, "seektime", st.s_seektime);
+    xeq_query_outstat(x, s, "maxseektime", st.s_maxseektime);
+    xeq_query_outstat(x, s, "bytes", st.s_nbytes);
+#else
+    post("xeq_query: no stats (compiled with XEQ_NOSTATS)");
+#endif
+}
+
 void xeq_query_dosetup(void)
 {
     xeq_query_class = class_new(gensym("xeq_query"),
@@ -104,6 +147,8 @@ void xeq_query_dosetup(void)
 		    gensym("tempo"), A_GIMME, 0);
     class_addmethod(xeq_query_class, (t_method)xeq_query_natoms,
 		    gensym("natoms"), A_GIMME, 0);
+    class_addmethod(xeq_query_class, (t_method)xeq_query_stats,
+		    gensym("stats"), A_GIMME, 0);
 }
 
 void xeq_query_setup(void)
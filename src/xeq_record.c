@@ -4,6 +4,21 @@
 
 /* sequence recorder (a host) */
 
+/* Incoming events are not added to the binbuf directly, because dense
+   controller streams would then cause three reallocations per event.
+   Instead, they are appended to fixed-size records, kept in chunks which
+   are allocated only when all previous chunks are full, and never freed
+   before the object is.  Pending records are committed to the binbuf
+   in a single batch, either periodically, or at `restop'.
+
+   Memory held by the arena, the commit vector and the merge index is
+   reported to the base, to be counted by `stats'.
+
+   In overdub and punch modes a take is committed only at `restop', by
+   merging it with the existing sequence in a single linear pass.  Both
+   streams are already sorted by time, and events of the existing sequence
+   come first, if simultaneous. */
+
 #include <stdio.h>
 #include <string.h>
 
@@ -13,15 +28,294 @@
 #include "hyphen.h"
 #include "xeq.h"
 
+#define XEQ_RECORD_NATOMS        8     /* longer messages get a private vector */
+#define XEQ_RECORD_CHUNKSIZE     1024  /* records per chunk */
+#define XEQ_RECORD_COMMITPERIOD  1000. /* msec */
+
+#define XEQ_RECORD_REPLACE  0
+#define XEQ_RECORD_OVERDUB  1
+#define XEQ_RECORD_PUNCH    2
+
+typedef struct _xeq_record_event
+{
+    double     r_when;    /* msec since recording started */
+    t_symbol  *r_target;
+    int        r_natoms;
+    t_atom    *r_vec;     /* either r_atoms, or a private vector */
+    t_atom     r_atoms[XEQ_RECORD_NATOMS];
+} t_xeq_record_event;
+
+typedef struct _xeq_record_chunk
+{
+    struct _xeq_record_chunk  *c_next;
+    int                        c_nevents;
+    t_xeq_record_event         c_events[XEQ_RECORD_CHUNKSIZE];
+} t_xeq_record_chunk;
+
 typedef struct _xeq_record
 {
     t_hyphen   x_this;  /* (using outlet pointers of the base) */
     t_symbol  *x_trackname;
-    double     x_prevtime;
+    double     x_starttime;   /* zero if not recording */
+    double     x_committed;   /* msec since start, as already committed */
+    t_xeq_record_chunk  *x_firstchunk;
+    t_xeq_record_chunk  *x_lastchunk;   /* the one being filled */
+    int        x_npending;
+    t_atom    *x_commitvec;   /* nonshrinking */
+    int        x_commitsize;
+    t_clock   *x_commitclock;
+    int        x_mode;
+    double     x_punchfrom;
+    double     x_punchto;
+    t_xeqindex x_index;       /* of the existing sequence, while merging */
 } t_xeq_record;
 
 static t_class *xeq_record_class;
 
+/* RECORD ARENA */
+
+static void xeq_record_hold(t_xeq_record *x, int nbytes)
+{
+    XEQ_BASE(x)->x_heldbytes += nbytes;
+}
+
+static t_xeq_record_chunk *xeq_record_newchunk(t_xeq_record *x)
+{
+    t_xeq_record_chunk *cp = getbytes(sizeof(*cp));
+    if (cp)
+    {
+	cp->c_next = 0;
+	cp->c_nevents = 0;
+	xeq_record_hold(x, sizeof(*cp));
+    }
+    return (cp);
+}
+
+/* Returns a record to be filled, or zero if out of memory. */
+static t_xeq_record_event *xeq_record_newevent(t_xeq_record *x)
+{
+    t_xeq_record_chunk *cp = x->x_lastchunk;
+    if (!cp)
+    {
+	if (!(cp = x->x_firstchunk = x->x_lastchunk = xeq_record_newchunk(x)))
+	    return (0);
+    }
+    else if (cp->c_nevents == XEQ_RECORD_CHUNKSIZE)
+    {
+	if (!cp->c_next && !(cp->c_next = xeq_record_newchunk(x)))
+	    return (0);
+	cp = x->x_lastchunk = cp->c_next;
+    }
+    x->x_npending++;
+    return (cp->c_events + cp->c_nevents++);
+}
+
+/* Empties the arena without releasing any chunk. */
+static void xeq_record_reset(t_xeq_record *x)
+{
+    t_xeq_record_chunk *cp;
+    for (cp = x->x_firstchunk; cp; cp = cp->c_next)
+    {
+	int i;
+	t_xeq_record_event *ep;
+	for (i = 0, ep = cp->c_events; i < cp->c_nevents; i++, ep++)
+	    if (ep->r_vec != ep->r_atoms)
+	    {
+		freebytes(ep->r_vec, ep->r_natoms * sizeof(*ep->r_vec));
+		xeq_record_hold(x, -ep->r_natoms * (int)sizeof(*ep->r_vec));
+	    }
+	cp->c_nevents = 0;
+	if (cp == x->x_lastchunk) break;
+    }
+    x->x_lastchunk = x->x_firstchunk;
+    x->x_npending = 0;
+}
+
+static int xeq_record_checkcommitsize(t_xeq_record *x, int natoms)
+{
+    if (natoms > x->x_commitsize)
+    {
+	int newsize = (natoms > 2 * x->x_commitsize ?
+		       natoms : 2 * x->x_commitsize);
+	t_atom *newvec = (x->x_commitvec ?
+			  resizebytes(x->x_commitvec,
+				      x->x_commitsize * sizeof(*newvec),
+				      newsize * sizeof(*newvec)) :
+			  getbytes(newsize * sizeof(*newvec)));
+	if (!newvec)
+	{
+	    post("xeq_record: no memory to commit %d events", x->x_npending);
+	    return (0);
+	}
+	xeq_record_hold(x, (newsize - x->x_commitsize) * sizeof(*newvec));
+	x->x_commitvec = newvec;
+	x->x_commitsize = newsize;
+    }
+    return (1);
+}
+
+/* Appends all pending records to the binbuf, using a single binbuf_add()
+   call.  Deltas are taken against what has already been committed, so that
+   float rounding does not accumulate over a long take. */
+static void xeq_record_commit(t_xeq_record *x)
+{
+    t_xeq_record_chunk *cp;
+    t_atom *ap;
+    int natoms = 0;
+    if (!x->x_npending)
+	return;
+    for (cp = x->x_firstchunk; cp; cp = cp->c_next)
+    {
+	int i;
+	for (i = 0; i < cp->c_nevents; i++)
+	    natoms += cp->c_events[i].r_natoms + 3;
+	if (cp == x->x_lastchunk) break;
+    }
+    if (!xeq_record_checkcommitsize(x, natoms))
+	return;
+    ap = x->x_commitvec;
+    for (cp = x->x_firstchunk; cp; cp = cp->c_next)
+    {
+	int i;
+	t_xeq_record_event *ep;
+	for (i = 0, ep = cp->c_events; i < cp->c_nevents; i++, ep++)
+	{
+	    float delta = ep->r_when - x->x_committed;
+	    if (delta < 0) delta = 0;
+	    x->x_committed += delta;
+	    SETFLOAT(ap, delta); ap++;
+	    SETSYMBOL(ap, ep->r_target); ap++;
+	    memcpy(ap, ep->r_vec, ep->r_natoms * sizeof(*ap));
+	    ap += ep->r_natoms;
+	    SETSEMI(ap); ap++;
+	}
+	if (cp == x->x_lastchunk) break;
+    }
+    binbuf_add(XEQ_BASE(x)->x_binbuf, natoms, x->x_commitvec);
+    xeq_record_reset(x);
+}
+
+/* records are kept inside punch range, existing events outside of it */
+static int xeq_record_inpunch(t_xeq_record *x, double when)
+{
+    return (x->x_mode == XEQ_RECORD_PUNCH &&
+	    when >= x->x_punchfrom && when < x->x_punchto);
+}
+
+#define XEQ_RECORD_KEEPRECORD(x, when) \
+    ((x)->x_mode != XEQ_RECORD_PUNCH || xeq_record_inpunch(x, when))
+#define XEQ_RECORD_KEEPEVENT(x, when)  (!xeq_record_inpunch(x, when))
+
+/* Replaces the sequence with the merge of its events and pending records.
+   Deltas are recomputed, extra elements of delta vectors are lost. */
+static void xeq_record_merge(t_xeq_record *x)
+{
+    t_xeq *base = XEQ_BASE(x);
+    t_binbuf *bb = base->x_binbuf;
+    t_atom *vec, *ap;
+    t_xeqevent *ep, *endp;
+    t_xeq_record_chunk *cp;
+    t_xeq_record_event *rp;
+    int i, natoms = 0, nleft, oldsize = x->x_index.ix_size;
+    double written = 0;
+    if (!x->x_npending || !bb)
+	return;
+    i = xeqindex_build(&x->x_index, bb);
+    xeq_record_hold(x, (x->x_index.ix_size - oldsize) * sizeof(*ep));
+    if (i < 0)
+    {
+	post("xeq_record: no memory to merge %d events", x->x_npending);
+	return;
+    }
+    /* count atoms */
+    for (ep = x->x_index.ix_events, endp = ep + x->x_index.ix_nevents;
+	 ep < endp; ep++)
+	if (XEQ_RECORD_KEEPEVENT(x, ep->e_onset))
+	    natoms += (ep->e_attarget < 0 ? 2 : ep->e_atend - ep->e_attarget + 2);
+    for (cp = x->x_firstchunk; cp; cp = cp->c_next)
+    {
+	for (i = 0, rp = cp->c_events; i < cp->c_nevents; i++, rp++)
+	    if (XEQ_RECORD_KEEPRECORD(x, rp->r_when))
+		natoms += rp->r_natoms + 3;
+	if (cp == x->x_lastchunk) break;
+    }
+    if (!xeq_record_checkcommitsize(x, natoms))
+	return;
+
+    vec = binbuf_getvec(bb);
+    ap = x->x_commitvec;
+    ep = x->x_index.ix_events;
+    cp = x->x_firstchunk;
+    rp = cp->c_events;
+    nleft = cp->c_nevents;
+    while (ep < endp || rp)
+    {
+	t_symbol *target = 0;
+	t_atom *from = 0;
+	int count = 0, keep;
+	double when;
+	if (rp && (ep == endp || rp->r_when < ep->e_onset))
+	{
+	    when = rp->r_when;
+	    if ((keep = XEQ_RECORD_KEEPRECORD(x, when)) != 0)
+	    {
+		target = rp->r_target;
+		from = rp->r_vec;
+		count = rp->r_natoms;
+	    }
+	    rp++;
+	    if (!--nleft)
+	    {
+		if (cp != x->x_lastchunk && (cp = cp->c_next)
+		    && (nleft = cp->c_nevents))
+		    rp = cp->c_events;
+		else rp = 0;
+	    }
+	}
+	else
+	{
+	    when = ep->e_onset;
+	    if ((keep = XEQ_RECORD_KEEPEVENT(x, when)) && ep->e_attarget >= 0)
+	    {
+		from = vec + ep->e_attarget;
+		count = ep->e_atend - ep->e_attarget;
+	    }
+	    ep++;
+	}
+	if (keep)
+	{
+	    float delta = when - written;
+	    if (delta < 0) delta = 0;
+	    written += delta;
+	    SETFLOAT(ap, delta); ap++;
+	    if (target)
+	    {
+		SETSYMBOL(ap, target); ap++;
+	    }
+	    if (count)
+	    {
+		memcpy(ap, from, count * sizeof(*ap));
+		ap += count;
+	    }
+	    SETSEMI(ap); ap++;
+	}
+    }
+    binbuf_clear(bb);
+    binbuf_add(bb, ap - x->x_commitvec, x->x_commitvec);
+    xeq_touch(base);
+    xeq_record_reset(x);
+    xeq_rewindall(base);
+}
+
+static void xeq_record_tick(t_xeq_record *x)
+{
+    if (x->x_starttime != 0)
+    {
+	xeq_record_commit(x);
+	clock_delay(x->x_commitclock, XEQ_RECORD_COMMITPERIOD);
+    }
+}
+
 /* CREATION/DESTRUCTION */
 
 static void *xeq_record_new(t_symbol *name)
@@ -33,13 +327,33 @@ static void *xeq_record_new(t_symbol *name)
     {
 	xeq_derived_clone((t_hyphen *)x);
 	x->x_trackname = gensym("Track-1");
-	x->x_prevtime = 0;
+	x->x_starttime = 0;
+	x->x_committed = 0;
+	x->x_firstchunk = x->x_lastchunk = xeq_record_newchunk(x);
+	x->x_npending = 0;
+	x->x_commitvec = 0;
+	x->x_commitsize = 0;
+	x->x_commitclock = clock_new(x, (t_method)xeq_record_tick);
+	x->x_mode = XEQ_RECORD_REPLACE;
+	x->x_punchfrom = x->x_punchto = 0;
+	xeqindex_init(&x->x_index);
     }
     return (x);
 }
 
 static void xeq_record_free(t_xeq_record *x)
 {
+    t_xeq_record_chunk *cp, *next;
+    clock_free(x->x_commitclock);
+    xeq_record_reset(x);
+    for (cp = x->x_firstchunk; cp; cp = next)
+    {
+	next = cp->c_next;
+	freebytes(cp, sizeof(*cp));
+    }
+    if (x->x_commitvec)
+	freebytes(x->x_commitvec, x->x_commitsize * sizeof(*x->x_commitvec));
+    xeqindex_free(&x->x_index);
     xeq_derived_free((t_hyphen *)x);
 }
 
@@ -47,13 +361,69 @@ static void xeq_record_record(t_xeq_record *x)
 {
     t_xeq *base = XEQ_BASE(x);
     xeq_rewind(base);
-    binbuf_clear(base->x_binbuf);
-    x->x_prevtime = clock_getsystime();
+    xeq_record_reset(x);
+    x->x_committed = 0;
+    x->x_starttime = clock_getsystime();
+    if (x->x_mode == XEQ_RECORD_REPLACE)
+    {
+	binbuf_clear(base->x_binbuf);
+	xeq_touch(base);
+	clock_delay(x->x_commitclock, XEQ_RECORD_COMMITPERIOD);
+    }
 }
 
 static void xeq_record_restop(t_xeq_record *x)
 {
-    x->x_prevtime = 0;
+    clock_unset(x->x_commitclock);
+    if (x->x_mode == XEQ_RECORD_REPLACE)
+	xeq_record_commit(x);
+    else
+	xeq_record_merge(x);
+    x->x_starttime = 0;
+}
+
+static void xeq_record_replace(t_xeq_record *x)
+{
+    x->x_mode = XEQ_RECORD_REPLACE;
+}
+
+static void xeq_record_overdub(t_xeq_record *x)
+{
+    x->x_mode = XEQ_RECORD_OVERDUB;
+}
+
+/* punch range is given by two times or locator names */
+static void xeq_record_punch(t_xeq_record *x, t_symbol *s, int ac, t_atom *av)
+{
+    double bounds[2];
+    int i;
+    if (ac < 2)
+    {
+	post("xeq_record: punch needs two locators");
+	return;
+    }
+    for (i = 0; i < 2; i++, av++)
+    {
+	t_xeqlocator *loc;
+	if (av->a_type == A_FLOAT)
+	    bounds[i] = av->a_w.w_float;
+	else if (av->a_type == A_SYMBOL
+		 && (loc = xeq_whichloc(XEQ_BASE(x), av->a_w.w_symbol)))
+	    bounds[i] = loc->l_when;
+	else
+	{
+	    post("xeq_record: bad punch locator");
+	    return;
+	}
+    }
+    if (bounds[1] <= bounds[0])
+    {
+	post("xeq_record: empty punch range");
+	return;
+    }
+    x->x_mode = XEQ_RECORD_PUNCH;
+    x->x_punchfrom = bounds[0];
+    x->x_punchto = bounds[1];
 }
 
 static void xeq_record_retrack(t_xeq_record *x, t_symbol *s)
@@ -63,18 +433,21 @@ static void xeq_record_retrack(t_xeq_record *x, t_symbol *s)
 
 static void xeq_record_readd(t_xeq_record *x, t_symbol *s, int ac, t_atom *av)
 {
-    if (x->x_prevtime != 0)
+    t_xeq_record_event *ep;
+    if (x->x_starttime != 0 && (ep = xeq_record_newevent(x)))
     {
-	t_binbuf *bb = XEQ_BASE(x)->x_binbuf;
-	t_atom at[2];
-    	float elapsed = clock_gettimesince(x->x_prevtime);
-	SETFLOAT(&at[0], elapsed);
-	SETSYMBOL(&at[1], x->x_trackname);
-	binbuf_add(bb, 2, at);
-	binbuf_add(bb, ac, av);
-	SETSEMI(&at[0]);
-	binbuf_add(bb, 1, at);
-	x->x_prevtime = clock_getsystime();
+	ep->r_when = clock_gettimesince(x->x_starttime);
+	ep->r_target = x->x_trackname;
+	ep->r_natoms = ac;
+	if (ac <= XEQ_RECORD_NATOMS)
+	    ep->r_vec = ep->r_atoms;
+	else if (!(ep->r_vec = getbytes(ac * sizeof(*ep->r_vec))))
+	{
+	    ep->r_vec = ep->r_atoms;
+	    ep->r_natoms = ac = XEQ_RECORD_NATOMS;
+	}
+	else xeq_record_hold(x, ac * sizeof(*ep->r_vec));
+	memcpy(ep->r_vec, av, ac * sizeof(*av));
     }
 }
 
@@ -94,6 +467,12 @@ void xeq_record_dosetup(void)
 		    gensym("record"), 0);
     class_addmethod(xeq_record_class, (t_method)xeq_record_restop,
 		    gensym("restop"), 0);
+    class_addmethod(xeq_record_class, (t_method)xeq_record_replace,
+		    gensym("replace"), 0);
+    class_addmethod(xeq_record_class, (t_method)xeq_record_overdub,
+		    gensym("overdub"), 0);
+    class_addmethod(xeq_record_class, (t_method)xeq_record_punch,
+		    gensym("punch"), A_GIMME, 0);
     class_addmethod(xeq_record_class, (t_method)xeq_record_retrack,
 		    gensym("retrack"), A_DEFSYM, 0);
     class_addmethod(xeq_record_class, (t_method)xeq_record_readd,
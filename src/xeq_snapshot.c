@@ -0,0 +1,395 @@
+/* Copyright (c) 1997-2002 Miller Puckette and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* Snapshots of playback state.  A snapshot holds the state of every base
+   of a host and of its friends (locators, flags, sounding notes, tempo,
+   transposition, pending delay of a running playback), but not the
+   sequence itself.  Positions are stored as atom-indices, so restoring
+   costs nothing per event.  The sequence a snapshot was taken from is
+   identified by its length and checksum, which is computed once per
+   sequence version.  Files are in native byte order.
+
+   Friends are matched by class, in order of attachment, so that a
+   snapshot survives reloading of a patch, but not its editing.
+   LATER store state of friends proper (e.g. rubato envelopes
+   of xeq_polytempo) */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "m_pd.h"
+#include "shared.h"
+#include "sq.h"
+#include "bifi.h"
+#include "hyphen.h"
+#include "xeq.h"
+
+#define XEQSNAP_VERSION   1
+#define XEQSNAP_NAMESIZE  32
+
+typedef struct _xeqsnap_header
+{
+    char          h_magic[4];  /* "XEQS" */
+    unsigned int  h_version;
+    unsigned int  h_natoms;    /* of the sequence */
+    unsigned int  h_checksum;
+    unsigned int  h_nrecords;  /* host's record comes first */
+} t_xeqsnap_header;
+
+typedef struct _xeqsnap_record
+{
+    char          r_classname[XEQSNAP_NAMESIZE];
+    unsigned int  r_nbases;
+} t_xeqsnap_record;
+
+typedef struct _xeqsnap_locator
+{
+    double  l_when;
+    double  l_delay;
+    double  l_delta;
+    int     l_atprevious;
+    int     l_atdelta;
+    int     l_atnext;
+} t_xeqsnap_locator;
+
+typedef struct _xeqsnap_iterator
+{
+    t_xeqsnap_locator  i_playloc;
+    t_xeqsnap_locator  i_blooploc;
+    t_xeqsnap_locator  i_elooploc;
+    int                i_finish;
+    int                i_restarted;
+    int                i_loopover;
+} t_xeqsnap_iterator;
+
+typedef struct _xeqsnap_base
+{
+    t_xeqsnap_iterator  b_autoit;
+    t_xeqsnap_iterator  b_stepit;
+    t_xeqsnap_locator   b_beditloc;
+    t_xeqsnap_locator   b_eeditloc;
+    double              b_tempo;
+    int                 b_transpo;
+    int                 b_packed;
+    int                 b_playing;  /* then pending delay is in b_autoit */
+    signed char         b_noteons[16][128];
+} t_xeqsnap_base;
+
+/* a record read in, waiting for its friend */
+typedef struct _xeqsnap_loaded
+{
+    t_xeqsnap_record  l_record;
+    t_xeqsnap_base   *l_bases;
+    int               l_used;
+} t_xeqsnap_loaded;
+
+typedef struct _xeqsnap_restoring
+{
+    t_xeq             *r_host;
+    int                r_nloaded;
+    t_xeqsnap_loaded  *r_loaded;
+    int                r_nrestored;
+} t_xeqsnap_restoring;
+
+/* FNV-1a over atom types and contents, cached per sequence version and
+   size, as `add' and friends append without bumping the version */
+unsigned int xeq_checksum(t_xeq *host)
+{
+    unsigned int sum = 2166136261u;
+    t_atom *ap;
+    int natoms = (host->x_binbuf ? binbuf_getnatom(host->x_binbuf) : 0);
+    if (host->x_checkedgeneration == host->x_generation &&
+	host->x_checkednatoms == natoms && host->x_generation)
+	return (host->x_checksum);
+    host->x_checkednatoms = natoms;
+    ap = (natoms ? binbuf_getvec(host->x_binbuf) : 0);
+    for (; natoms--; ap++)
+    {
+	sum = (sum ^ ap->a_type) * 16777619u;
+	if (ap->a_type == A_FLOAT)
+	{
+	    unsigned char *p = (unsigned char *)&ap->a_w.w_float;
+	    unsigned int i;
+	    for (i = 0; i < sizeof(ap->a_w.w_float); i++)
+		sum = (sum ^ p[i]) * 16777619u;
+	}
+	else if (ap->a_type == A_SYMBOL)
+	{
+	    unsigned char *p = (unsigned char *)ap->a_w.w_symbol->s_name;
+	    while (*p)
+		sum = (sum ^ *p++) * 16777619u;
+	}
+    }
+    host->x_checksum = sum;
+    host->x_checkedgeneration = host->x_generation;
+    return (sum);
+}
+
+static void xeqsnap_getlocator(t_xeqsnap_locator *s, t_xeqlocator *loc)
+{
+    s->l_when = loc->l_when;
+    s->l_delay = loc->l_delay;
+    s->l_delta = loc->l_delta;
+    s->l_atprevious = loc->l_atprevious;
+    s->l_atdelta = loc->l_atdelta;
+    s->l_atnext = loc->l_atnext;
+}
+
+static void xeqsnap_getiterator(t_xeqsnap_iterator *s, t_xeqit *it)
+{
+    xeqsnap_getlocator(&s->i_playloc, &it->i_playloc);
+    xeqsnap_getlocator(&s->i_blooploc, &it->i_blooploc);
+    xeqsnap_getlocator(&s->i_elooploc, &it->i_elooploc);
+    s->i_finish = it->i_finish;
+    s->i_restarted = it->i_restarted;
+    s->i_loopover = it->i_loopover;
+}
+
+static void xeqsnap_getbase(t_xeqsnap_base *s, t_xeq *x)
+{
+    memset(s, 0, sizeof(*s));
+    xeqsnap_getiterator(&s->b_autoit, &x->x_autoit);
+    xeqsnap_getiterator(&s->b_stepit, &x->x_stepit);
+    xeqsnap_getlocator(&s->b_beditloc, &x->x_beditloc);
+    xeqsnap_getlocator(&s->b_eeditloc, &x->x_eeditloc);
+    s->b_tempo = x->x_tempo;
+    s->b_transpo = x->x_transpo;
+    s->b_packed = x->x_packed;
+    s->b_playing = (x->x_whenclockset != 0);
+    if (s->b_playing)
+    {
+	/* as if stopped (see xeq_stop()) */
+	double left = xeq_delayleft(x);
+	s->b_autoit.i_playloc.l_when += s->b_autoit.i_playloc.l_delay - left;
+	s->b_autoit.i_playloc.l_delay = left;
+    }
+    memcpy(s->b_noteons, x->x_noteons, sizeof(s->b_noteons));
+}
+
+/* Atom-indices are checked against the sequence, the rest is trusted. */
+static int xeqsnap_setlocator(t_xeqlocator *loc, t_xeqsnap_locator *s,
+			      t_binbuf *bb, int natoms)
+{
+    if (s->l_atprevious < -1 || s->l_atprevious > natoms ||
+	s->l_atdelta < -1 || s->l_atdelta > natoms ||
+	s->l_atnext < -1 || s->l_atnext > natoms)
+	return (0);
+    loc->l_when = s->l_when;
+    loc->l_delay = s->l_delay;
+    loc->l_delta = s->l_delta;
+    loc->l_atprevious = s->l_atprevious;
+    loc->l_atdelta = s->l_atdelta;
+    loc->l_atnext = s->l_atnext;
+    loc->l_binbuf = bb;
+    loc->l_firstatom = binbuf_getvec(bb);
+    loc->l_natoms = natoms;
+    return (1);
+}
+
+static int xeqsnap_setiterator(t_xeqit *it, t_xeqsnap_iterator *s,
+			       t_binbuf *bb, int natoms)
+{
+    if (!xeqsnap_setlocator(&it->i_playloc, &s->i_playloc, bb, natoms) ||
+	!xeqsnap_setlocator(&it->i_blooploc, &s->i_blooploc, bb, natoms) ||
+	!xeqsnap_setlocator(&it->i_elooploc, &s->i_elooploc, bb, natoms))
+	return (0);
+    it->i_finish = s->i_finish;
+    it->i_restarted = s->i_restarted;
+    it->i_loopover = s->i_loopover;
+    it->i_nbatched = 0;
+    return (1);
+}
+
+static int xeqsnap_setbase(t_xeq *x, t_xeqsnap_base *s)
+{
+    t_binbuf *bb = x->x_binbuf;
+    int natoms = binbuf_getnatom(bb);
+    xeq_stop(x);
+    if (!xeqsnap_setiterator(&x->x_autoit, &s->b_autoit, bb, natoms) ||
+	!xeqsnap_setiterator(&x->x_stepit, &s->b_stepit, bb, natoms) ||
+	!xeqsnap_setlocator(&x->x_beditloc, &s->b_beditloc, bb, natoms) ||
+	!xeqsnap_setlocator(&x->x_eeditloc, &s->b_eeditloc, bb, natoms))
+    {
+	xeq_rewind(x);
+	return (0);
+    }
+    x->x_tempo = (s->b_tempo > 0 ? s->b_tempo : 1);
+    x->x_transpo = s->b_transpo;
+    x->x_packed = s->b_packed;
+    memcpy(x->x_noteons, s->b_noteons, sizeof(x->x_noteons));
+    if (s->b_playing)
+	xeq_start(x);
+    return (1);
+}
+
+static char *xeqsnap_classname(t_pd *f)
+{
+    return (class_getname(*f));
+}
+
+static void xeqsnap_setrecord(t_xeqsnap_record *r, t_pd *f, int nbases)
+{
+    memset(r, 0, sizeof(*r));
+    strncpy(r->r_classname, xeqsnap_classname(f), XEQSNAP_NAMESIZE - 1);
+    r->r_nbases = nbases;
+}
+
+static int xeqhook_snapshot_count(t_pd *f, void *countp)
+{
+    if (XEQ_BASE(f) && XEQ_NBASES(f) > 0)
+	(*(int *)countp)++;
+    return (1);
+}
+
+static void xeqsnap_write(FILE *fp, t_pd *f, t_xeq *base, int nbases)
+{
+    t_xeqsnap_record r;
+    t_xeqsnap_base s;
+    xeqsnap_setrecord(&r, f, nbases);
+    fwrite(&r, sizeof(r), 1, fp);
+    while (nbases--)
+    {
+	xeqsnap_getbase(&s, base++);
+	fwrite(&s, sizeof(s), 1, fp);
+    }
+}
+
+static int xeqhook_snapshot_write(t_pd *f, void *fp)
+{
+    if (XEQ_BASE(f) && XEQ_NBASES(f) > 0)
+	xeqsnap_write((FILE *)fp, f, XEQ_BASE(f), XEQ_NBASES(f));
+    return (1);
+}
+
+static int xeqhook_snapshot_restore(t_pd *f, void *arg)
+{
+    t_xeqsnap_restoring *r = arg;
+    t_xeq *base = XEQ_BASE(f);
+    int i, j, nbases = XEQ_NBASES(f);
+    char *name = xeqsnap_classname(f);
+    if (!base || nbases <= 0)
+	return (1);
+    for (i = 1; i < r->r_nloaded; i++)
+    {
+	t_xeqsnap_loaded *lp = r->r_loaded + i;
+	if (!lp->l_used && lp->l_record.r_nbases == (unsigned int)nbases &&
+	    !strncmp(lp->l_record.r_classname, name, XEQSNAP_NAMESIZE - 1))
+	{
+	    lp->l_used = 1;
+	    if (base->x_binbuf != r->r_host->x_binbuf)
+		post("restore: %s skipped (not in sync with its host)", name);
+	    else for (j = 0; j < nbases; j++)
+		if (xeqsnap_setbase(base + j, lp->l_bases + j))
+		    r->r_nrestored++;
+	    return (1);
+	}
+    }
+    post("restore: no state of %s", name);
+    return (1);
+}
+
+/* `snapshot <file>' */
+void xeq_snapshot(t_xeq *x, t_symbol *filename)
+{
+    t_xeq *host = xeq_gethost(x);
+    t_xeqsnap_header hdr;
+    t_bifi bifi;
+    char buf[MAXPDSTRING];
+    int nrecords = 1, failed;
+    if (!host->x_binbuf)
+	return;
+    memcpy(hdr.h_magic, "XEQS", 4);
+    hdr.h_version = XEQSNAP_VERSION;
+    hdr.h_natoms = binbuf_getnatom(host->x_binbuf);
+    hdr.h_checksum = xeq_checksum(host);
+    hyphen_forallfriends((t_hyphen *)host, xeqhook_snapshot_count, &nrecords);
+    hdr.h_nrecords = nrecords;
+    bifi_new(&bifi, (char *)&hdr, sizeof(hdr));
+    canvas_makefilename(x->x_canvas, filename->s_name, buf, MAXPDSTRING);
+    if (!bifi_write_start(&bifi, buf, ""))
+    {
+	bifi_error_report(&bifi);
+	bifi_free(&bifi);
+	return;
+    }
+    xeqsnap_write(bifi.b_fp, (t_pd *)host, host, 1);
+    hyphen_forallfriends((t_hyphen *)host, xeqhook_snapshot_write, bifi.b_fp);
+    failed = ferror(bifi.b_fp);
+    if (fclose(bifi.b_fp))
+	failed = 1;
+    bifi.b_fp = 0;
+    bifi_free(&bifi);
+    if (failed)
+	error("%s: write failed", filename->s_name);
+}
+
+/* `restore <file>' */
+void xeq_restore(t_xeq *x, t_symbol *filename)
+{
+    t_xeq *host = xeq_gethost(x);
+    t_xeqsnap_header hdr;
+    t_xeqsnap_restoring r;
+    t_bifi bifi;
+    int i, nstates = 0;
+    if (!host->x_binbuf)
+	return;
+    r.r_host = host;
+    r.r_nloaded = 0;
+    r.r_loaded = 0;
+    r.r_nrestored = 0;
+    bifi_new(&bifi, (char *)&hdr, sizeof(hdr));
+    if (!bifi_read_start(&bifi, filename->s_name,
+			 canvas_getdir(x->x_canvas)->s_name))
+    {
+	bifi_error_report(&bifi);
+	goto done;
+    }
+    if (memcmp(hdr.h_magic, "XEQS", 4) || hdr.h_version != XEQSNAP_VERSION)
+    {
+	error("%s: not an xeq snapshot (or of another version)",
+	      filename->s_name);
+	goto done;
+    }
+    if (hdr.h_natoms != (unsigned int)binbuf_getnatom(host->x_binbuf) ||
+	hdr.h_checksum != xeq_checksum(host))
+    {
+	error("%s: snapshot of another sequence", filename->s_name);
+	goto done;
+    }
+    if (!hdr.h_nrecords || hdr.h_nrecords > 65536 ||
+	!(r.r_loaded = getbytes(hdr.h_nrecords * sizeof(*r.r_loaded))))
+	goto corrupt;
+    for (i = 0; i < (int)hdr.h_nrecords; i++)
+    {
+	t_xeqsnap_loaded *lp = r.r_loaded + i;
+	if (fread(&lp->l_record, sizeof(lp->l_record), 1, bifi.b_fp) < 1 ||
+	    lp->l_record.r_nbases < 1 || lp->l_record.r_nbases > 65536)
+	    goto corrupt;
+	r.r_nloaded = i + 1;
+	nstates += lp->l_record.r_nbases;
+	if (!(lp->l_bases =
+	      getbytes(lp->l_record.r_nbases * sizeof(*lp->l_bases))) ||
+	    fread(lp->l_bases, sizeof(*lp->l_bases), lp->l_record.r_nbases,
+		  bifi.b_fp) < lp->l_record.r_nbases)
+	    goto corrupt;
+    }
+    /* the host is always first */
+    if (xeqsnap_setbase(host, r.r_loaded->l_bases))
+	r.r_nrestored++;
+    hyphen_forallfriends((t_hyphen *)host, xeqhook_snapshot_restore, &r);
+    if (r.r_nrestored < nstates)
+	post("restore: %d of %d states restored", r.r_nrestored, nstates);
+    goto done;
+corrupt:
+    error("%s: corrupt snapshot", filename->s_name);
+done:
+    for (i = 0; i < r.r_nloaded; i++)
+	if (r.r_loaded[i].l_bases)
+	    freebytes(r.r_loaded[i].l_bases,
+		      r.r_loaded[i].l_record.r_nbases *
+		      sizeof(*r.r_loaded[i].l_bases));
+    if (r.r_loaded)
+	freebytes(r.r_loaded, hdr.h_nrecords * sizeof(*r.r_loaded));
+    bifi_free(&bifi);
+}
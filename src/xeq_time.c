@@ -55,19 +55,14 @@ static void xeq_time_bang(t_xeq_time *x)
     if (host)
     {
 	t_xeqit *hostit = &host->x_autoit;
-	float lasttime = hostit->i_playloc.l_when;
-	float nexttime = lasttime + hostit->i_playloc.l_delay;
-	float curtime = lasttime;
+	double lasttime = hostit->i_playloc.l_when;
+	double nexttime = lasttime + hostit->i_playloc.l_delay;
+	double curtime = lasttime;
 	outlet_float(x->x_indxout, hostit->i_playloc.l_atnext);
 	outlet_float(x->x_nextout, nexttime);
 	outlet_float(x->x_lastout, lasttime);
 	if (host->x_whenclockset != 0)
-	{
-	     curtime +=
-		 clock_gettimesince(host->x_whenclockset) * host->x_tempo;
-	     if (curtime > nexttime) curtime = nexttime;
-	    
-	}
+	    curtime = nexttime - xeq_delayleft(host);
 	outlet_float(((t_object *)x)->ob_outlet, curtime);
     }
 }
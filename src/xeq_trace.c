@@ -0,0 +1,234 @@
+/* Copyright (c) 1997-2002 Miller Puckette and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* Event tracer, common to all xeq objects.  While tracing is on, every
+   clock tick, traversal step, hook call, seek and file access is stored
+   in a fixed-size ring buffer, which may then be written out as a trace
+   viewable in chrome://tracing or Perfetto.  Only the latest entries
+   are kept.  While tracing is off, the cost is a single test per site
+   (see XEQTRACE in xeq.h). */
+
+#include <stdio.h>
+#include <string.h>
+#ifdef UNIX
+#include <time.h>
+#endif
+
+#include "m_pd.h"
+#include "shared.h"
+#include "sq.h"
+#include "hyphen.h"
+#include "xeq.h"
+
+#define XEQTRACE_SIZE  65536  /* entries, must be a power of two */
+#define XEQTRACE_MAXHOSTS  256  /* processes in a dump */
+
+typedef struct _xeqtrace_entry
+{
+    double      e_start;   /* real time, seconds */
+    double      e_dur;
+    t_xeq      *e_host;    /* or null */
+    t_symbol   *e_hostname;  /* as of the entry, or null */
+    void       *e_object;  /* owner of the iterator, or any xeq */
+    short       e_kind;    /* XEQTRACE_... */
+    short       e_iter;    /* 0 none, 1 auto, 2 step, 3 walk */
+} t_xeqtrace_entry;
+
+int xeqtrace_enabled = 0;
+
+static t_xeqtrace_entry *xeqtrace_buffer = 0;
+static unsigned long xeqtrace_head = 0;  /* total number of entries */
+static double xeqtrace_origin = 0;
+
+static char *xeqtrace_names[XEQTRACE_NKINDS] =
+{
+    "tick", "step", "delay", "applypp", "message", "batch",
+    "finish", "loopover", "seek", "read", "write"
+};
+
+static char *xeqtrace_iternames[4] = { "other", "auto", "step", "walk" };
+
+/* real time in seconds, from a monotonic clock where available */
+double xeq_realtime(void)
+{
+#if defined(UNIX) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec * 1e-9);
+#else
+    return (sys_getrealtime());
+#endif
+}
+
+/* Slots are claimed by an atomic increment, so that entries may come
+   from any thread without locking.  An entry being overwritten while
+   dumping may come out garbled, but the dump itself is safe. */
+void xeqtrace_add(int kind, t_xeq *x, t_xeqit *it, double start)
+{
+    double now = xeq_realtime();
+    unsigned long ndx;
+    t_xeqtrace_entry *ep;
+    t_xeq *host;
+    if (!xeqtrace_buffer)
+	return;
+#ifdef __GNUC__
+    ndx = __sync_fetch_and_add(&xeqtrace_head, 1);
+#else
+    ndx = xeqtrace_head++;
+#endif
+    ep = xeqtrace_buffer + (ndx & (XEQTRACE_SIZE - 1));
+    ep->e_start = start;
+    ep->e_dur = now - start;
+    ep->e_kind = kind;
+    ep->e_object = x;
+    host = (x ? xeq_gethost(x) : 0);
+    ep->e_host = host;
+    ep->e_hostname = (host ? host->x_this.x_hostname : 0);
+    if (!it || !x)
+	ep->e_iter = 0;
+    else if (it == &x->x_autoit)
+	ep->e_iter = 1;
+    else if (it == &x->x_stepit)
+	ep->e_iter = 2;
+    else if (it == &x->x_walkit)
+	ep->e_iter = 3;
+    else
+	ep->e_iter = 0;
+}
+
+static void xeqtrace_start(void)
+{
+    if (!xeqtrace_buffer &&
+	!(xeqtrace_buffer = getbytes(XEQTRACE_SIZE * sizeof(*xeqtrace_buffer))))
+    {
+	error("trace: no memory");
+	return;
+    }
+    if (!xeqtrace_enabled)
+    {
+	xeqtrace_head = 0;
+	xeqtrace_origin = xeq_realtime();
+	xeqtrace_enabled = 1;
+    }
+}
+
+/* a JSON string, quotes and backslashes escaped */
+static void xeqtrace_putstring(FILE *fp, char *s)
+{
+    putc('"', fp);
+    for (; *s; s++)
+    {
+	if (*s == '"' || *s == '\\')
+	    fprintf(fp, "\\%c", *s);
+	else if ((unsigned char)*s < ' ')
+	    fprintf(fp, "\\u%04x", *s);
+	else
+	    putc(*s, fp);
+    }
+    putc('"', fp);
+}
+
+/* metadata records naming a process and its threads */
+static void xeqtrace_putprocess(FILE *fp, int pid, char *name, int first)
+{
+    int i;
+    fprintf(fp, "%s{\"name\": \"process_name\", \"ph\": \"M\", \
+\"pid\": %d, \"args\": {\"name\": ", (first ? "" : ",\n"), pid);
+    xeqtrace_putstring(fp, name);
+    fprintf(fp, "}}");
+    for (i = 0; i < 4; i++)
+	fprintf(fp, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \
+\"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+		pid, i, xeqtrace_iternames[i]);
+}
+
+/* Every host becomes a process, every iterator a thread, so that each
+   host's playback shows up as a separate track.  Hosts are told apart
+   by address, so that unnamed ones do not merge, and are labelled with
+   the name they had first.  Hosts beyond XEQTRACE_MAXHOSTS share a
+   single process. */
+static int xeqtrace_dump(char *path)
+{
+    t_xeq *hosts[XEQTRACE_MAXHOSTS];
+    int nhosts = 0, pid, first = 1, others = 0;
+    unsigned long ndx, head = xeqtrace_head;
+    unsigned long tail = (head > XEQTRACE_SIZE ? head - XEQTRACE_SIZE : 0);
+    FILE *fp;
+    if (!(fp = fopen(path, "w")))
+	return (0);
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (ndx = tail; ndx < head; ndx++)
+    {
+	t_xeqtrace_entry *ep = xeqtrace_buffer + (ndx & (XEQTRACE_SIZE - 1));
+	for (pid = 0; pid < nhosts; pid++)
+	    if (hosts[pid] == ep->e_host) break;
+	if (pid < XEQTRACE_MAXHOSTS && pid == nhosts)
+	{
+	    char buf[64];
+	    hosts[nhosts++] = ep->e_host;
+	    if (ep->e_hostname && *ep->e_hostname->s_name)
+		xeqtrace_putprocess(fp, pid + 1, ep->e_hostname->s_name, first);
+	    else
+	    {
+		if (ep->e_host)
+		    sprintf(buf, "(unnamed %p)", (void *)ep->e_host);
+		else
+		    strcpy(buf, "(none)");
+		xeqtrace_putprocess(fp, pid + 1, buf, first);
+	    }
+	    first = 0;
+	}
+	else if (pid == XEQTRACE_MAXHOSTS && !others)
+	{
+	    xeqtrace_putprocess(fp, pid + 1, "(other hosts)", first);
+	    first = 0;
+	    others = 1;
+	}
+	fprintf(fp, "%s{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \
+\"dur\": %.3f, \"pid\": %d, \"tid\": %d, \"args\": {\"object\": \"%p\"}}",
+		(first ? "" : ",\n"), xeqtrace_names[ep->e_kind],
+		(ep->e_start - xeqtrace_origin) * 1e6, ep->e_dur * 1e6,
+		pid + 1, ep->e_iter, ep->e_object);
+	first = 0;
+    }
+    fprintf(fp, "\n]}\n");
+    if (fclose(fp))
+	return (0);
+    post("trace: %lu entries written to %s", head - tail, path);
+    return (1);
+}
+
+/* `trace on', `trace off', `trace clear', `trace dump <file>' */
+void xeq_trace(t_xeq *x, t_symbol *s, int ac, t_atom *av)
+{
+    t_symbol *cmd = (ac && av->a_type == A_SYMBOL ? av->a_w.w_symbol : 0);
+    if (!cmd)
+	post("trace: %s, %lu entries", (xeqtrace_enabled ? "on" : "off"),
+	     (xeqtrace_head > XEQTRACE_SIZE ? XEQTRACE_SIZE : xeqtrace_head));
+    else if (!strcmp(cmd->s_name, "on"))
+	xeqtrace_start();
+    else if (!strcmp(cmd->s_name, "off"))
+	xeqtrace_enabled = 0;
+    else if (!strcmp(cmd->s_name, "clear"))
+	xeqtrace_head = 0;
+    else if (!strcmp(cmd->s_name, "dump"))
+    {
+	char buf[MAXPDSTRING];
+	if (ac < 2 || av[1].a_type != A_SYMBOL)
+	{
+	    error("trace dump: file name needed");
+	    return;
+	}
+	if (!xeqtrace_buffer)
+	{
+	    post("trace: nothing to dump");
+	    return;
+	}
+	canvas_makefilename(x->x_canvas, av[1].a_w.w_symbol->s_name,
+			    buf, MAXPDSTRING);
+	if (!xeqtrace_dump(buf))
+	    error("%s: write failed", av[1].a_w.w_symbol->s_name);
+    }
+    else error("trace: unknown command %s", cmd->s_name);
+}
@@ -0,0 +1,422 @@
+/* Copyright (c) 1997-2002 Miller Puckette and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* Batch transforms of a host's sequence.  `transform' takes a pipeline
+   of operations, e.g.
+
+	transform transpose -12 scale 1.5 quantize 125 drop 208
+
+   which are applied, in the order given, to a decoded copy of the
+   sequence: an array per field (onset, status, channel, data bytes),
+   each operation being a single loop over one or two arrays.  The
+   result goes into a new binbuf, which then replaces the sequence, so
+   that it is either transformed as a whole, or not at all.
+
+   Operations:
+	transpose <semitones>       notes and poly aftertouch; events
+				    going out of range are dropped
+	scale <factor>              onsets (tempo is not applied)
+	quantize <grid> [<amount>]  onsets, moved by amount (0-1, default
+				    1) toward the nearest grid line
+	velocity <exponent> [<min> <max>]
+				    maps note-on velocities 1-127 onto
+				    min-max (default 1-127) along a power
+				    curve
+	channel [<from>] <to>       channels are 1-16, all if no `from'
+	keep <status> ...           channel events of other status are
+				    dropped (status as 128, 144, ...)
+	drop <status> ...           channel events of given status are
+				    dropped
+
+   Time operations are monotonic, so events never change order, and
+   deltas are just recomputed from onsets.  Other events (messages,
+   lone delays) are only moved in time.  Note-offs are quantized as
+   well, so notes shorter than half the grid may shrink to nothing.
+   LATER keep durations in quantizing (needs note pairing and resorting) */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "m_pd.h"
+#include "shared.h"
+#include "sq.h"
+#include "hyphen.h"
+#include "xeq.h"
+
+#define XEQTR_TRANSPOSE  0
+#define XEQTR_SCALE      1
+#define XEQTR_QUANTIZE   2
+#define XEQTR_VELOCITY   3
+#define XEQTR_CHANNEL    4
+#define XEQTR_KEEP       5
+#define XEQTR_DROP       6
+#define XEQTR_NTYPES     7
+
+#define XEQTR_MAXOPS     64
+#define XEQTR_CHUNKSIZE  4096  /* atoms, added to a binbuf at once */
+
+static char *xeqtr_names[XEQTR_NTYPES] =
+{
+    "transpose", "scale", "quantize", "velocity", "channel", "keep", "drop"
+};
+
+typedef struct _xeqtr_op
+{
+    int     o_type;
+    int     o_ac;
+    double  o_av[3];
+    char    o_statuses[8];  /* keep and drop: indexed by (status >> 4) - 8 */
+} t_xeqtr_op;
+
+/* A decoded sequence, one entry per indexed event (plus the guard,
+   for time operations).  Status is zero for events other than
+   channel events. */
+typedef struct _xeqtr_events
+{
+    int            t_nevents;
+    double        *t_onset;
+    int           *t_status;
+    int           *t_channel;  /* 0-15 */
+    int           *t_data1;
+    int           *t_data2;    /* -1 for two-byte messages */
+    unsigned char *t_keep;
+} t_xeqtr_events;
+
+static int xeqtr_parse(int ac, t_atom *av, t_xeqtr_op *ops)
+{
+    int nops = 0;
+    while (ac)
+    {
+	t_xeqtr_op *op = ops + nops;
+	int type;
+	if (av->a_type != A_SYMBOL)
+	{
+	    error("transform: operation name expected");
+	    return (-1);
+	}
+	for (type = 0; type < XEQTR_NTYPES; type++)
+	    if (!strcmp(av->a_w.w_symbol->s_name, xeqtr_names[type]))
+		break;
+	if (type == XEQTR_NTYPES)
+	{
+	    error("transform: unknown operation %s", av->a_w.w_symbol->s_name);
+	    return (-1);
+	}
+	if (nops == XEQTR_MAXOPS)
+	{
+	    error("transform: too many operations");
+	    return (-1);
+	}
+	op->o_type = type;
+	op->o_ac = 0;
+	memset(op->o_statuses, 0, sizeof(op->o_statuses));
+	for (ac--, av++; ac && av->a_type == A_FLOAT; ac--, av++)
+	{
+	    if (type == XEQTR_KEEP || type == XEQTR_DROP)
+	    {
+		int status = (int)av->a_w.w_float;
+		if (status < 0x80 || status > 0xef)
+		{
+		    error("transform: bad status %d", status);
+		    return (-1);
+		}
+		op->o_statuses[(status >> 4) - 8] = 1;
+		op->o_ac = 1;
+	    }
+	    else if (op->o_ac < 3)
+		op->o_av[op->o_ac++] = av->a_w.w_float;
+	}
+	switch (type)
+	{
+	case XEQTR_TRANSPOSE:
+	    if (op->o_ac != 1) goto bad;
+	    break;
+	case XEQTR_SCALE:
+	    if (op->o_ac != 1 || op->o_av[0] <= 0) goto bad;
+	    break;
+	case XEQTR_QUANTIZE:
+	    if (op->o_ac < 1 || op->o_ac > 2 || op->o_av[0] <= 0) goto bad;
+	    if (op->o_ac < 2) op->o_av[1] = 1;
+	    else if (op->o_av[1] < 0 || op->o_av[1] > 1) goto bad;
+	    break;
+	case XEQTR_VELOCITY:
+	    if ((op->o_ac != 1 && op->o_ac != 3) || op->o_av[0] <= 0) goto bad;
+	    if (op->o_ac < 3) op->o_av[1] = 1, op->o_av[2] = 127;
+	    break;
+	case XEQTR_CHANNEL:
+	    if (op->o_ac < 1 || op->o_ac > 2) goto bad;
+	    if (op->o_ac < 2) op->o_av[1] = op->o_av[0], op->o_av[0] = 0;
+	    else if (op->o_av[0] < 1 || op->o_av[0] > 16) goto bad;
+	    if (op->o_av[1] < 1 || op->o_av[1] > 16) goto bad;
+	    break;
+	default:
+	    if (!op->o_ac) goto bad;
+	}
+	nops++;
+    }
+    return (nops);
+bad:
+    error("transform: bad arguments of %s", xeqtr_names[ops[nops].o_type]);
+    return (-1);
+}
+
+static void xeqtr_freeevents(t_xeqtr_events *t, int size)
+{
+    if (t->t_onset) freebytes(t->t_onset, size * sizeof(*t->t_onset));
+    if (t->t_status) freebytes(t->t_status, size * sizeof(*t->t_status));
+    if (t->t_channel) freebytes(t->t_channel, size * sizeof(*t->t_channel));
+    if (t->t_data1) freebytes(t->t_data1, size * sizeof(*t->t_data1));
+    if (t->t_data2) freebytes(t->t_data2, size * sizeof(*t->t_data2));
+    if (t->t_keep) freebytes(t->t_keep, size * sizeof(*t->t_keep));
+}
+
+static int xeqtr_decode(t_xeqtr_events *t, t_xeqindex *ix, t_atom *vec)
+{
+    int i, size = ix->ix_nevents + 1;
+    t->t_nevents = ix->ix_nevents;
+    t->t_onset = getbytes(size * sizeof(*t->t_onset));
+    t->t_status = getbytes(size * sizeof(*t->t_status));
+    t->t_channel = getbytes(size * sizeof(*t->t_channel));
+    t->t_data1 = getbytes(size * sizeof(*t->t_data1));
+    t->t_data2 = getbytes(size * sizeof(*t->t_data2));
+    t->t_keep = getbytes(size * sizeof(*t->t_keep));
+    if (!t->t_onset || !t->t_status || !t->t_channel ||
+	!t->t_data1 || !t->t_data2 || !t->t_keep)
+	return (0);
+    for (i = 0; i < size; i++)
+    {
+	t_xeqevent *ep = ix->ix_events + i;
+	t->t_onset[i] = ep->e_onset;
+	t->t_keep[i] = 1;
+	if (i == t->t_nevents || ep->e_attarget < 0 ||
+	    ep->e_atend - ep->e_attarget < 2 ||
+	    vec[ep->e_attarget + 1].a_type != A_FLOAT ||
+	    !xeq_listparse(ep->e_atend - ep->e_attarget - 1,
+			   vec + ep->e_attarget + 1, &t->t_status[i],
+			   &t->t_channel[i], &t->t_data1[i], &t->t_data2[i]))
+	{
+	    t->t_status[i] = 0;
+	    t->t_channel[i] = t->t_data1[i] = t->t_data2[i] = 0;
+	}
+    }
+    return (1);
+}
+
+/* Loops are kept free of calls and of dependencies between iterations,
+   so that they may be vectorized. */
+static void xeqtr_apply(t_xeqtr_op *op, t_xeqtr_events *t)
+{
+    int i, n = t->t_nevents;
+    int *status = t->t_status, *channel = t->t_channel;
+    int *data1 = t->t_data1, *data2 = t->t_data2;
+    unsigned char *keep = t->t_keep;
+    double *onset = t->t_onset;
+    switch (op->o_type)
+    {
+    case XEQTR_TRANSPOSE:
+    {
+	int interval = (int)op->o_av[0];
+	for (i = 0; i < n; i++)
+	{
+	    int haskey = (status[i] >= 0x80 && status[i] < 0xb0);
+	    int key = data1[i] + (haskey ? interval : 0);
+	    data1[i] = key;
+	    keep[i] &= (key >= 0 && key <= 127);
+	}
+	break;
+    }
+    case XEQTR_SCALE:
+    {
+	double factor = op->o_av[0];
+	for (i = 0; i <= n; i++)
+	    onset[i] *= factor;
+	break;
+    }
+    case XEQTR_QUANTIZE:
+    {
+	double grid = op->o_av[0], amount = op->o_av[1];
+	for (i = 0; i <= n; i++)
+	    onset[i] += amount * (floor(onset[i] / grid + .5) * grid - onset[i]);
+	break;
+    }
+    case XEQTR_VELOCITY:
+    {
+	int curve[128];
+	double lo = op->o_av[1], hi = op->o_av[2];
+	curve[0] = 0;
+	for (i = 1; i < 128; i++)
+	{
+	    int v = (int)(lo + (hi - lo) * pow((i - 1) / 126., op->o_av[0]) + .5);
+	    curve[i] = (v < 1 ? 1 : (v > 127 ? 127 : v));
+	}
+	for (i = 0; i < n; i++)
+	    if (status[i] == 0x90)
+		data2[i] = curve[data2[i]];
+	break;
+    }
+    case XEQTR_CHANNEL:
+    {
+	int map[16], from = (int)op->o_av[0], to = (int)op->o_av[1];
+	for (i = 0; i < 16; i++)
+	    map[i] = (!from || i == from - 1 ? to - 1 : i);
+	for (i = 0; i < n; i++)
+	    channel[i] = map[channel[i]];
+	break;
+    }
+    case XEQTR_KEEP:
+    case XEQTR_DROP:
+    {
+	/* entry 8 is for events other than channel events */
+	char mask[9];
+	for (i = 0; i < 8; i++)
+	    mask[i] = (op->o_type == XEQTR_KEEP ?
+		       op->o_statuses[i] : !op->o_statuses[i]);
+	mask[8] = 1;
+	for (i = 0; i < n; i++)
+	    keep[i] &= mask[status[i] ? (status[i] >> 4) - 8 : 8];
+	break;
+    }
+    }
+}
+
+/* output of encoding, gathered in chunks, to be added to a binbuf */
+typedef struct _xeqtr_out
+{
+    t_binbuf  *o_binbuf;
+    t_atom    *o_vec;
+    int        o_size;
+    int        o_count;
+} t_xeqtr_out;
+
+/* returns room for count atoms, or null if out of memory */
+static t_atom *xeqtr_reserve(t_xeqtr_out *o, int count)
+{
+    if (o->o_count + count > o->o_size)
+    {
+	binbuf_add(o->o_binbuf, o->o_count, o->o_vec);
+	o->o_count = 0;
+	if (count > o->o_size)
+	{
+	    t_atom *newvec = resizebytes(o->o_vec, o->o_size * sizeof(*newvec),
+					 count * sizeof(*newvec));
+	    if (!newvec)
+		return (0);
+	    o->o_vec = newvec;
+	    o->o_size = count;
+	}
+    }
+    return (o->o_vec + o->o_count);
+}
+
+/* Writes kept events, with deltas recomputed and channel messages
+   patched.  Lone delays are dropped, since time is carried by onsets,
+   but the end of the sequence is kept.  Returns zero if out of memory. */
+static int xeqtr_encode(t_xeqtr_events *t, t_xeqindex *ix,
+			t_atom *vec, int natoms, t_xeqtr_out *o)
+{
+    double written = 0, end = t->t_onset[t->t_nevents];
+    t_atom *ap;
+    int i;
+    for (i = 0; i < t->t_nevents; i++)
+    {
+	t_xeqevent *ep = ix->ix_events + i;
+	double delta = t->t_onset[i] - written;
+	int body = ep->e_atstart, count;
+	while (body < ep->e_atend && vec[body].a_type == A_FLOAT)
+	    body++;
+	if (!t->t_keep[i] || body == ep->e_atend)
+	    continue;
+	if (delta < 0)
+	    delta = 0;
+	/* a delta may be added, and a semi, if the last one is missing */
+	if (!(ap = xeqtr_reserve(o, ep->e_atend - ep->e_atstart + 2)))
+	    return (0);
+	if (ep->e_atstart < body)
+	{
+	    count = body - ep->e_atstart;
+	    memcpy(ap, vec + ep->e_atstart, count * sizeof(*ap));
+	    SETFLOAT(ap, delta);
+	    ap += count;
+	}
+	else if (delta > 0)
+	{
+	    SETFLOAT(ap, delta);
+	    ap++;
+	}
+	written += delta;
+	count = ep->e_atend - body;
+	memcpy(ap, vec + body, count * sizeof(*ap));
+	if (t->t_status[i])
+	{
+	    SETFLOAT(ap + 2, t->t_data1[i]);
+	    if (t->t_data2[i] >= 0)
+	    {
+		SETFLOAT(ap + 3, t->t_data2[i]);
+		SETFLOAT(ap + 4, t->t_channel[i] + 1);
+	    }
+	    else SETFLOAT(ap + 3, t->t_channel[i] + 1);
+	}
+	ap += count;
+	if (ep->e_atend < natoms)
+	    *ap++ = vec[ep->e_atend];
+	else
+	{
+	    SETSEMI(ap);
+	    ap++;
+	}
+	o->o_count = ap - o->o_vec;
+    }
+    if (end > written)
+    {
+	if (!(ap = xeqtr_reserve(o, 2)))
+	    return (0);
+	SETFLOAT(ap, end - written);
+	SETSEMI(ap + 1);
+	o->o_count += 2;
+    }
+    binbuf_add(o->o_binbuf, o->o_count, o->o_vec);
+    return (1);
+}
+
+/* `transform <operation> <arguments> ...' */
+void xeq_transform(t_xeq *x, t_symbol *s, int ac, t_atom *av)
+{
+    t_xeq *host = xeq_gethost(x);
+    t_xeqtr_op ops[XEQTR_MAXOPS];
+    t_xeqtr_events t;
+    t_xeqindex ix;
+    t_atom *vec;
+    t_xeqtr_out o;
+    int i, nops, size = 0;
+    if (!host->x_binbuf || (nops = xeqtr_parse(ac, av, ops)) <= 0)
+	return;
+    memset(&t, 0, sizeof(t));
+    xeqindex_init(&ix);
+    o.o_binbuf = 0;
+    o.o_size = XEQTR_CHUNKSIZE;
+    o.o_count = 0;
+    vec = binbuf_getvec(host->x_binbuf);
+    if (!(o.o_vec = getbytes(o.o_size * sizeof(*o.o_vec))) ||
+	xeqindex_build(&ix, host->x_binbuf) < 0)
+	goto nomemory;
+    size = ix.ix_nevents + 1;
+    if (!xeqtr_decode(&t, &ix, vec))
+	goto nomemory;
+    for (i = 0; i < nops; i++)
+	xeqtr_apply(ops + i, &t);
+    o.o_binbuf = binbuf_new();
+    if (!xeqtr_encode(&t, &ix, vec, binbuf_getnatom(host->x_binbuf), &o))
+	goto nomemory;
+    xeq_setsequence(host, o.o_binbuf);
+    o.o_binbuf = 0;
+    goto done;
+nomemory:
+    error("transform: no memory");
+done:
+    if (o.o_binbuf) binbuf_free(o.o_binbuf);
+    if (o.o_vec) freebytes(o.o_vec, o.o_size * sizeof(*o.o_vec));
+    xeqtr_freeevents(&t, size);
+    xeqindex_free(&ix);
+}
@@ -0,0 +1,32 @@
+/* Copyright (c) 1997-2002 Miller Puckette and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* stand-in for Pd's g_canvas.h (see m_pd.h) */
+
+#ifndef __g_canvas_h_
+#define __g_canvas_h_
+
+#include "m_pd.h"
+
+struct _glist
+{
+    t_object   gl_obj;
+    t_gobj    *gl_list;
+    t_float    gl_x1;
+    t_float    gl_y1;
+    t_float    gl_x2;
+    t_float    gl_y2;
+    unsigned int  gl_havewindow:1;
+    unsigned int  gl_mapped:1;
+    unsigned int  gl_loading:1;
+    int        gl_valid;  /* bumped on every deletion */
+};
+
+EXTERN t_class *canvas_class;
+EXTERN t_class *scalar_class;
+
+EXTERN void glist_delete(t_glist *x, t_gobj *y);
+EXTERN int glist_isvisible(t_glist *x);
+
+#endif
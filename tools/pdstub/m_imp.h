@@ -0,0 +1,38 @@
+/* Copyright (c) 1997-2002 Miller Puckette and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* stand-in for Pd's m_imp.h (see m_pd.h) */
+
+#ifndef __m_imp_h_
+#define __m_imp_h_
+
+#include "m_pd.h"
+
+#define PDSTUB_MAXARGS  6
+
+typedef struct _methodentry
+{
+    t_symbol    *me_name;
+    t_method     me_fun;
+    t_atomtype   me_arg[PDSTUB_MAXARGS];
+} t_methodentry;
+
+struct _class
+{
+    t_symbol        *c_name;
+    t_symbol        *c_helpname;
+    size_t           c_size;
+    t_methodentry   *c_methods;
+    int              c_nmethods;
+    t_method         c_bangmethod;
+    t_method         c_floatmethod;
+    t_method         c_listmethod;
+    t_method         c_anymethod;
+    t_method         c_freemethod;
+    t_newmethod      c_newmethod;
+    t_atomtype       c_newargs[PDSTUB_MAXARGS];
+    char             c_patchable;
+};
+
+#endif
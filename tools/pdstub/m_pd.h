@@ -0,0 +1,205 @@
+/* Copyright (c) 1997-2002 Miller Puckette and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* A tiny stand-in for Pd's m_pd.h, declaring only what is needed to build
+   shared/ and src/ outside of Pd (see pdstub.c).  Do not use it for
+   building the library itself. */
+
+#ifndef __m_pd_h_
+#define __m_pd_h_
+
+#include <stddef.h>
+
+#define PD_MAJOR_VERSION  0
+#define PD_MINOR_VERSION  54
+
+#define EXTERN extern
+#define MAXPDSTRING 1000
+#define MAXPDARG 5
+
+typedef float t_float;
+typedef float t_floatarg;
+typedef long t_int;
+
+struct _class;
+struct _outlet;
+struct _inlet;
+struct _binbuf;
+struct _clock;
+struct _glist;
+struct _garray;
+struct _gpointer;
+
+typedef struct _class *t_pd;
+typedef struct _class t_class;
+typedef struct _outlet t_outlet;
+typedef struct _inlet t_inlet;
+typedef struct _binbuf t_binbuf;
+typedef struct _clock t_clock;
+typedef struct _glist t_glist, t_canvas;
+typedef struct _garray t_garray;
+typedef struct _gpointer t_gpointer;
+
+typedef struct _symbol
+{
+    char  *s_name;
+    t_pd  *s_thing;
+    struct _symbol  *s_next;
+} t_symbol;
+
+typedef union word
+{
+    t_float      w_float;
+    t_symbol    *w_symbol;
+    t_gpointer  *w_gpointer;
+    int          w_index;
+} t_word;
+
+typedef enum
+{
+    A_NULL, A_FLOAT, A_SYMBOL, A_POINTER, A_SEMI, A_COMMA,
+    A_DEFFLOAT, A_DEFSYM, A_DOLLAR, A_DOLLSYM, A_GIMME, A_CANT
+} t_atomtype;
+
+typedef struct _atom
+{
+    t_atomtype  a_type;
+    union word  a_w;
+} t_atom;
+
+typedef struct _gobj
+{
+    t_pd           g_pd;
+    struct _gobj  *g_next;
+} t_gobj;
+
+typedef struct _text
+{
+    t_gobj     te_g;
+    t_binbuf  *te_binbuf;
+    t_outlet  *te_outlet;
+    t_inlet   *te_inlet;
+    short      te_xpix;
+    short      te_ypix;
+    short      te_width;
+    unsigned int  te_type:2;
+} t_text, t_object;
+
+#define ob_pd te_g.g_pd
+#define ob_outlet te_outlet
+
+typedef void (*t_method)(void);
+typedef void *(*t_newmethod)(void);
+
+#define CLASS_DEFAULT 0
+#define CLASS_PD 1
+
+EXTERN t_symbol s_pointer, s_float, s_symbol, s_bang, s_list, s_anything,
+    s_signal, s__N, s__X, s_x, s_y, s_;
+EXTERN t_class *garray_class;
+
+EXTERN t_symbol *gensym(const char *s);
+
+EXTERN void *getbytes(size_t nbytes);
+EXTERN void *resizebytes(void *x, size_t oldsize, size_t newsize);
+EXTERN void freebytes(void *x, size_t nbytes);
+EXTERN void *copybytes(const void *src, size_t nbytes);
+EXTERN void *t_getbytes(size_t nbytes);
+
+EXTERN t_pd *pd_new(t_class *cls);
+EXTERN void pd_free(t_pd *x);
+EXTERN void pd_bind(t_pd *x, t_symbol *s);
+EXTERN void pd_unbind(t_pd *x, t_symbol *s);
+EXTERN t_pd *pd_findbyclass(t_symbol *s, const t_class *c);
+EXTERN void pd_typedmess(t_pd *x, t_symbol *s, int argc, t_atom *argv);
+EXTERN void typedmess(t_pd *x, t_symbol *s, int argc, t_atom *argv);
+EXTERN void vmess(t_pd *x, t_symbol *s, const char *fmt, ...);
+#define pd_class(x) (*(x))
+
+EXTERN t_binbuf *binbuf_new(void);
+EXTERN void binbuf_free(t_binbuf *x);
+EXTERN void binbuf_clear(t_binbuf *x);
+EXTERN void binbuf_add(t_binbuf *x, int argc, const t_atom *argv);
+EXTERN void binbuf_print(const t_binbuf *x);
+EXTERN int binbuf_getnatom(const t_binbuf *x);
+EXTERN t_atom *binbuf_getvec(const t_binbuf *x);
+EXTERN int binbuf_read_via_path(t_binbuf *b, const char *filename,
+				const char *dirname, int crflag);
+EXTERN int binbuf_write(const t_binbuf *x, const char *filename,
+			const char *dir, int crflag);
+
+EXTERN t_clock *clock_new(void *owner, t_method fn);
+EXTERN void clock_delay(t_clock *x, double delaytime);
+EXTERN void clock_unset(t_clock *x);
+EXTERN double clock_getlogicaltime(void);
+EXTERN double clock_getsystime(void);
+EXTERN double clock_gettimesince(double prevsystime);
+EXTERN void clock_free(t_clock *x);
+
+EXTERN t_outlet *outlet_new(t_object *owner, t_symbol *s);
+EXTERN void outlet_bang(t_outlet *x);
+EXTERN void outlet_float(t_outlet *x, t_float f);
+EXTERN void outlet_symbol(t_outlet *x, t_symbol *s);
+EXTERN void outlet_list(t_outlet *x, t_symbol *s, int argc, t_atom *argv);
+EXTERN void outlet_anything(t_outlet *x, t_symbol *s, int argc, t_atom *argv);
+EXTERN t_inlet *inlet_new(t_object *owner, t_pd *dest,
+			  t_symbol *s1, t_symbol *s2);
+EXTERN t_inlet *floatinlet_new(t_object *owner, t_float *fp);
+
+EXTERN t_class *class_new(t_symbol *name, t_newmethod newmethod,
+			  t_method freemethod, size_t size, int flags,
+			  t_atomtype arg1, ...);
+EXTERN void class_addcreator(t_newmethod newmethod, t_symbol *s,
+			     t_atomtype type1, ...);
+EXTERN void class_addmethod(t_class *c, t_method fn, t_symbol *sel,
+			    t_atomtype arg1, ...);
+EXTERN void class_addbang(t_class *c, t_method fn);
+EXTERN void class_addfloat(t_class *c, t_method fn);
+EXTERN void class_addlist(t_class *c, t_method fn);
+EXTERN void class_addanything(t_class *c, t_method fn);
+EXTERN char *class_getname(const t_class *c);
+#define class_addbang(x, y) class_addbang((x), (t_method)(y))
+#define class_addfloat(x, y) class_addfloat((x), (t_method)(y))
+#define class_addlist(x, y) class_addlist((x), (t_method)(y))
+#define class_addanything(x, y) class_addanything((x), (t_method)(y))
+
+EXTERN void post(const char *fmt, ...);
+EXTERN void error(const char *fmt, ...);
+EXTERN void pd_error(const void *object, const char *fmt, ...);
+EXTERN void bug(const char *fmt, ...);
+
+EXTERN void atom_string(const t_atom *a, char *buf, unsigned int bufsize);
+EXTERN t_float atom_getfloat(const t_atom *a);
+EXTERN t_symbol *atom_getsymbol(const t_atom *a);
+
+EXTERN void sys_gui(const char *s);
+EXTERN void sys_vgui(const char *fmt, ...);
+EXTERN void sys_getversion(int *major, int *minor, int *bugfix);
+EXTERN void sys_bashfilename(const char *from, char *to);
+EXTERN void sys_unbashfilename(const char *from, char *to);
+EXTERN int open_via_path(const char *dir, const char *name, const char *ext,
+			 char *dirresult, char **nameresult,
+			 unsigned int size, int bin);
+
+EXTERN t_canvas *canvas_getcurrent(void);
+EXTERN t_symbol *canvas_getdir(const t_canvas *x);
+EXTERN void canvas_makefilename(const t_canvas *c, const char *file,
+				char *result, int resultsize);
+EXTERN void canvas_redraw(t_canvas *x);
+
+EXTERN int garray_getfloatarray(t_garray *x, int *size, t_float **vec);
+EXTERN int garray_getfloatwords(t_garray *x, int *size, t_word **vec);
+EXTERN void garray_redraw(t_garray *x);
+EXTERN void garray_resize(t_garray *x, t_floatarg f);
+EXTERN int garray_npoints(t_garray *x);
+
+#define SETSEMI(atom) ((atom)->a_type = A_SEMI, (atom)->a_w.w_index = 0)
+#define SETCOMMA(atom) ((atom)->a_type = A_COMMA, (atom)->a_w.w_index = 0)
+#define SETPOINTER(atom, gp) ((atom)->a_type = A_POINTER, \
+			      (atom)->a_w.w_gpointer = (gp))
+#define SETFLOAT(atom, f) ((atom)->a_type = A_FLOAT, (atom)->a_w.w_float = (f))
+#define SETSYMBOL(atom, s) ((atom)->a_type = A_SYMBOL, \
+			    (atom)->a_w.w_symbol = (s))
+
+#endif
@@ -0,0 +1,1034 @@
+/* Copyright (c) 1997-2002 Miller Puckette and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* A minimal implementation of the parts of Pd API used by shared/ and src/.
+   Binbufs, symbols, classes and message dispatch behave as in Pd (binbufs
+   are resized to the exact size on every addition, as in m_binbuf.c).
+   Clocks are kept in a list, which is run by pdstub_runclocks() in
+   logical time.  There is no GUI, no canvas, and no garray, outlets are
+   not connected, only counted.  Symbol creation and posting are guarded
+   by a mutex, everything else is meant for a single thread. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "m_pd.h"
+#include "m_imp.h"
+#include "g_canvas.h"
+#include "pdstub.h"
+
+int pdstub_verbose = 1;
+unsigned long pdstub_noutputs = 0;
+
+static pthread_mutex_t pdstub_symlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t pdstub_postlock = PTHREAD_MUTEX_INITIALIZER;
+
+/* MEMORY */
+
+void *getbytes(size_t nbytes)
+{
+    void *ret = calloc(nbytes ? nbytes : 1, 1);
+    if (!ret) post("pd: getbytes() failed -- out of memory");
+    return (ret);
+}
+
+void *t_getbytes(size_t nbytes)
+{
+    return (getbytes(nbytes));
+}
+
+void *resizebytes(void *x, size_t oldsize, size_t newsize)
+{
+    void *ret = realloc(x, newsize ? newsize : 1);
+    if (!ret) post("pd: resizebytes() failed -- out of memory");
+    else if (newsize > oldsize)
+	memset((char *)ret + oldsize, 0, newsize - oldsize);
+    return (ret);
+}
+
+void freebytes(void *x, size_t nbytes)
+{
+    free(x);
+}
+
+void *copybytes(const void *src, size_t nbytes)
+{
+    void *ret = getbytes(nbytes);
+    if (ret) memcpy(ret, src, nbytes);
+    return (ret);
+}
+
+/* PRINTING */
+
+static void pdstub_vpost(const char *prefix, const char *fmt, va_list ap)
+{
+    if (!pdstub_verbose)
+	return;
+    pthread_mutex_lock(&pdstub_postlock);
+    fputs(prefix, stderr);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    pthread_mutex_unlock(&pdstub_postlock);
+}
+
+void post(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    pdstub_vpost("", fmt, ap);
+    va_end(ap);
+}
+
+void error(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    pdstub_vpost("error: ", fmt, ap);
+    va_end(ap);
+}
+
+void pd_error(const void *object, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    pdstub_vpost("error: ", fmt, ap);
+    va_end(ap);
+}
+
+void bug(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    pdstub_vpost("consistency check failed: ", fmt, ap);
+    va_end(ap);
+}
+
+/* SYMBOLS */
+
+#define PDSTUB_HASHSIZE  4096
+
+static t_symbol *pdstub_symhash[PDSTUB_HASHSIZE];
+
+t_symbol s_pointer = {"pointer", 0, 0};
+t_symbol s_float = {"float", 0, 0};
+t_symbol s_symbol = {"symbol", 0, 0};
+t_symbol s_bang = {"bang", 0, 0};
+t_symbol s_list = {"list", 0, 0};
+t_symbol s_anything = {"anything", 0, 0};
+t_symbol s_signal = {"signal", 0, 0};
+t_symbol s__N = {"#N", 0, 0};
+t_symbol s__X = {"#X", 0, 0};
+t_symbol s_x = {"x", 0, 0};
+t_symbol s_y = {"y", 0, 0};
+t_symbol s_ = {"", 0, 0};
+
+static t_symbol *pdstub_builtins[] =
+{
+    &s_pointer, &s_float, &s_symbol, &s_bang, &s_list, &s_anything,
+    &s_signal, &s__N, &s__X, &s_x, &s_y, &s_, 0
+};
+
+static int pdstub_symsinitialized = 0;
+
+static t_symbol *pdstub_dogensym(const char *s, t_symbol *oldsym)
+{
+    t_symbol **sym1, *sym2;
+    unsigned int hash = 5381;
+    const char *s2 = s;
+    while (*s2) hash = hash * 33 + (unsigned char)*s2++;
+    sym1 = pdstub_symhash + (hash & (PDSTUB_HASHSIZE - 1));
+    while ((sym2 = *sym1))
+    {
+	if (!strcmp(sym2->s_name, s))
+	    return (sym2);
+	sym1 = &sym2->s_next;
+    }
+    if (oldsym)
+	sym2 = oldsym;
+    else
+    {
+	sym2 = getbytes(sizeof(*sym2));
+	sym2->s_name = getbytes(strlen(s) + 1);
+	strcpy(sym2->s_name, s);
+    }
+    sym2->s_next = 0;
+    sym2->s_thing = 0;
+    *sym1 = sym2;
+    return (sym2);
+}
+
+t_symbol *gensym(const char *s)
+{
+    t_symbol *sym;
+    pthread_mutex_lock(&pdstub_symlock);
+    if (!pdstub_symsinitialized)
+    {
+	t_symbol **sp;
+	for (sp = pdstub_builtins; *sp; sp++)
+	    pdstub_dogensym((*sp)->s_name, *sp);
+	pdstub_symsinitialized = 1;
+    }
+    sym = pdstub_dogensym(s, 0);
+    pthread_mutex_unlock(&pdstub_symlock);
+    return (sym);
+}
+
+/* CLASSES AND MESSAGES */
+
+typedef struct _pdstub_creator
+{
+    t_symbol   *c_name;
+    t_class    *c_class;
+    t_newmethod c_newmethod;
+    t_atomtype  c_args[PDSTUB_MAXARGS];
+    struct _pdstub_creator  *c_next;
+} t_pdstub_creator;
+
+static t_pdstub_creator *pdstub_creators = 0;
+static t_class *pdstub_lastclass = 0;  /* for class_addcreator() */
+
+static void pdstub_getargs(t_atomtype *argp, t_atomtype arg1, va_list ap)
+{
+    int i = 0;
+    t_atomtype arg = arg1;
+    while (arg != A_NULL && i < PDSTUB_MAXARGS - 1)
+    {
+	argp[i++] = arg;
+	arg = (t_atomtype)va_arg(ap, int);
+    }
+    argp[i] = A_NULL;
+}
+
+static void pdstub_addcreator(t_symbol *s, t_class *c, t_newmethod fn,
+			      t_atomtype *args)
+{
+    t_pdstub_creator *cr = getbytes(sizeof(*cr));
+    cr->c_name = s;
+    cr->c_class = c;
+    cr->c_newmethod = fn;
+    memcpy(cr->c_args, args, sizeof(cr->c_args));
+    cr->c_next = pdstub_creators;
+    pdstub_creators = cr;
+}
+
+t_class *class_new(t_symbol *name, t_newmethod newmethod,
+		   t_method freemethod, size_t size, int flags,
+		   t_atomtype arg1, ...)
+{
+    t_class *c = getbytes(sizeof(*c));
+    va_list ap;
+    c->c_name = c->c_helpname = name;
+    c->c_size = size;
+    c->c_freemethod = freemethod;
+    c->c_newmethod = newmethod;
+    c->c_patchable = (flags != CLASS_PD);
+    va_start(ap, arg1);
+    pdstub_getargs(c->c_newargs, arg1, ap);
+    va_end(ap);
+    if (newmethod)
+    {
+	pdstub_addcreator(name, c, newmethod, c->c_newargs);
+	pdstub_lastclass = c;
+    }
+    return (c);
+}
+
+void class_addcreator(t_newmethod newmethod, t_symbol *s,
+		      t_atomtype type1, ...)
+{
+    t_atomtype args[PDSTUB_MAXARGS];
+    va_list ap;
+    va_start(ap, type1);
+    pdstub_getargs(args, type1, ap);
+    va_end(ap);
+    pdstub_addcreator(s, pdstub_lastclass, newmethod, args);
+}
+
+void class_addmethod(t_class *c, t_method fn, t_symbol *sel,
+		     t_atomtype arg1, ...)
+{
+    t_methodentry *m;
+    va_list ap;
+    c->c_methods = resizebytes(c->c_methods,
+			       c->c_nmethods * sizeof(*c->c_methods),
+			       (c->c_nmethods + 1) * sizeof(*c->c_methods));
+    m = c->c_methods + c->c_nmethods++;
+    m->me_name = sel;
+    m->me_fun = fn;
+    va_start(ap, arg1);
+    pdstub_getargs(m->me_arg, arg1, ap);
+    va_end(ap);
+}
+
+#undef class_addbang
+#undef class_addfloat
+#undef class_addlist
+#undef class_addanything
+
+void class_addbang(t_class *c, t_method fn)
+{
+    c->c_bangmethod = fn;
+}
+
+void class_addfloat(t_class *c, t_method fn)
+{
+    c->c_floatmethod = fn;
+}
+
+void class_addlist(t_class *c, t_method fn)
+{
+    c->c_listmethod = fn;
+}
+
+void class_addanything(t_class *c, t_method fn)
+{
+    c->c_anymethod = fn;
+}
+
+char *class_getname(const t_class *c)
+{
+    return (c->c_name->s_name);
+}
+
+/* Typed arguments are passed as in m_class.c: pointers in one group,
+   floats in another, which works for the usual calling conventions. */
+typedef void *(*t_pdstub_fun)(t_int, t_int, t_int, t_int, t_int, t_int,
+			      t_floatarg, t_floatarg, t_floatarg,
+			      t_floatarg, t_floatarg);
+typedef void *(*t_pdstub_gimme)(void *, t_symbol *, int, t_atom *);
+
+/* self is zero for creators */
+static void *pdstub_call(t_method fn, t_atomtype *args, void *self,
+			 t_symbol *s, int argc, t_atom *argv)
+{
+    t_int ai[PDSTUB_MAXARGS] = {0};
+    t_floatarg af[MAXPDARG] = {0};
+    int ni = 0, nf = 0;
+    if (self) ai[ni++] = (t_int)self;
+    for (; *args != A_NULL; args++)
+    {
+	switch (*args)
+	{
+	case A_GIMME:
+	    if (self)
+		return (((t_pdstub_gimme)fn)(self, s, argc, argv));
+	    else return (((void *(*)(t_symbol *, int, t_atom *))fn)
+			 (s, argc, argv));
+	case A_FLOAT:
+	case A_DEFFLOAT:
+	    if (nf < MAXPDARG)
+		af[nf++] = (argc > 0 && argv->a_type == A_FLOAT ?
+			    argv->a_w.w_float : 0);
+	    break;
+	case A_SYMBOL:
+	case A_DEFSYM:
+	    if (ni < PDSTUB_MAXARGS)
+		ai[ni++] = (t_int)(argc > 0 && argv->a_type == A_SYMBOL ?
+				   argv->a_w.w_symbol : &s_);
+	    break;
+	default:
+	    break;
+	}
+	if (argc > 0) argc--, argv++;
+    }
+    return (((t_pdstub_fun)fn)(ai[0], ai[1], ai[2], ai[3], ai[4], ai[5],
+			       af[0], af[1], af[2], af[3], af[4]));
+}
+
+void pd_typedmess(t_pd *x, t_symbol *s, int argc, t_atom *argv)
+{
+    t_class *c = *x;
+    int i;
+    if (s == &s_bang && !argc && c->c_bangmethod)
+    {
+	((void (*)(t_pd *))c->c_bangmethod)(x);
+	return;
+    }
+    if (s == &s_float && argc && c->c_floatmethod)
+    {
+	((void (*)(t_pd *, t_floatarg))c->c_floatmethod)
+	    (x, argv->a_w.w_float);
+	return;
+    }
+    if (s == &s_list)
+    {
+	if (c->c_listmethod)
+	{
+	    ((t_pdstub_gimme)c->c_listmethod)(x, s, argc, argv);
+	    return;
+	}
+	if (!argc && c->c_bangmethod)
+	{
+	    ((void (*)(t_pd *))c->c_bangmethod)(x);
+	    return;
+	}
+	if (argc == 1 && argv->a_type == A_FLOAT && c->c_floatmethod)
+	{
+	    ((void (*)(t_pd *, t_floatarg))c->c_floatmethod)
+		(x, argv->a_w.w_float);
+	    return;
+	}
+    }
+    for (i = 0; i < c->c_nmethods; i++)
+    {
+	t_methodentry *m = c->c_methods + i;
+	if (m->me_name == s)
+	{
+	    pdstub_call(m->me_fun, m->me_arg, x, s, argc, argv);
+	    return;
+	}
+    }
+    if (c->c_anymethod)
+	((t_pdstub_gimme)c->c_anymethod)(x, s, argc, argv);
+    else pd_error(x, "%s: no method for '%s'", c->c_name->s_name, s->s_name);
+}
+
+void typedmess(t_pd *x, t_symbol *s, int argc, t_atom *argv)
+{
+    pd_typedmess(x, s, argc, argv);
+}
+
+void vmess(t_pd *x, t_symbol *s, const char *fmt, ...)
+{
+    t_atom at[MAXPDARG + 1];
+    int n = 0;
+    va_list ap;
+    va_start(ap, fmt);
+    for (; *fmt && n <= MAXPDARG; fmt++, n++)
+    {
+	if (*fmt == 'f') SETFLOAT(at + n, va_arg(ap, double));
+	else if (*fmt == 's') SETSYMBOL(at + n, va_arg(ap, t_symbol *));
+	else break;
+    }
+    va_end(ap);
+    pd_typedmess(x, s, n, at);
+}
+
+t_pd *pd_new(t_class *c)
+{
+    t_pd *x = getbytes(c->c_size);
+    *x = c;
+    return (x);
+}
+
+static void pdstub_freeoutlets(t_object *ob);
+
+void pd_free(t_pd *x)
+{
+    t_class *c = *x;
+    if (c->c_freemethod)
+	((void (*)(t_pd *))c->c_freemethod)(x);
+    if (c->c_patchable)
+	pdstub_freeoutlets((t_object *)x);
+    freebytes(x, c->c_size);
+}
+
+t_pd *pdstub_create(const char *classname, int argc, t_atom *argv)
+{
+    t_symbol *s = gensym(classname);
+    t_pdstub_creator *cr;
+    for (cr = pdstub_creators; cr; cr = cr->c_next)
+	if (cr->c_name == s)
+	    return ((t_pd *)pdstub_call((t_method)cr->c_newmethod,
+					cr->c_args, 0, s, argc, argv));
+    error("%s: couldn't create", classname);
+    return (0);
+}
+
+void pdstub_delete(t_pd *x)
+{
+    pd_free(x);
+}
+
+void pdstub_send(t_pd *x, const char *selector, int argc, t_atom *argv)
+{
+    pd_typedmess(x, gensym(selector), argc, argv);
+}
+
+/* BINDING */
+
+typedef struct _pdstub_bindelem
+{
+    t_pd  *e_who;
+    struct _pdstub_bindelem  *e_next;
+} t_pdstub_bindelem;
+
+typedef struct _pdstub_bindlist
+{
+    t_pd  b_pd;
+    t_pdstub_bindelem  *b_list;
+} t_pdstub_bindlist;
+
+static t_class *pdstub_bindlist_class = 0;
+
+static void pdstub_bindlist_anything(t_pdstub_bindlist *x, t_symbol *s,
+				     int argc, t_atom *argv)
+{
+    t_pdstub_bindelem *e;
+    for (e = x->b_list; e; e = e->e_next)
+	pd_typedmess(e->e_who, s, argc, argv);
+}
+
+void pd_bind(t_pd *x, t_symbol *s)
+{
+    t_pdstub_bindelem *e;
+    if (!pdstub_bindlist_class)
+    {
+	pdstub_bindlist_class = class_new(gensym("bindlist"), 0, 0,
+					  sizeof(t_pdstub_bindlist),
+					  CLASS_PD, 0);
+	class_addanything(pdstub_bindlist_class,
+			  (t_method)pdstub_bindlist_anything);
+    }
+    if (!s->s_thing)
+    {
+	s->s_thing = x;
+	return;
+    }
+    if (*s->s_thing != pdstub_bindlist_class)
+    {
+	t_pdstub_bindlist *b =
+	    (t_pdstub_bindlist *)pd_new(pdstub_bindlist_class);
+	e = getbytes(sizeof(*e));
+	e->e_who = s->s_thing;
+	b->b_list = e;
+	s->s_thing = &b->b_pd;
+    }
+    e = getbytes(sizeof(*e));
+    e->e_who = x;
+    e->e_next = ((t_pdstub_bindlist *)s->s_thing)->b_list;
+    ((t_pdstub_bindlist *)s->s_thing)->b_list = e;
+}
+
+void pd_unbind(t_pd *x, t_symbol *s)
+{
+    if (s->s_thing == x)
+	s->s_thing = 0;
+    else if (s->s_thing && *s->s_thing == pdstub_bindlist_class)
+    {
+	t_pdstub_bindlist *b = (t_pdstub_bindlist *)s->s_thing;
+	t_pdstub_bindelem **ep, *e;
+	for (ep = &b->b_list; (e = *ep); ep = &e->e_next)
+	{
+	    if (e->e_who == x)
+	    {
+		*ep = e->e_next;
+		freebytes(e, sizeof(*e));
+		break;
+	    }
+	}
+	if (b->b_list && !b->b_list->e_next)
+	{
+	    s->s_thing = b->b_list->e_who;
+	    freebytes(b->b_list, sizeof(*b->b_list));
+	    pd_free(&b->b_pd);
+	}
+    }
+    else pd_error(x, "%s: couldn't unbind", s->s_name);
+}
+
+t_pd *pd_findbyclass(t_symbol *s, const t_class *c)
+{
+    if (!s->s_thing)
+	return (0);
+    if (*s->s_thing == c)
+	return (s->s_thing);
+    if (*s->s_thing == pdstub_bindlist_class)
+    {
+	t_pdstub_bindelem *e;
+	for (e = ((t_pdstub_bindlist *)s->s_thing)->b_list; e; e = e->e_next)
+	    if (*e->e_who == c)
+		return (e->e_who);
+    }
+    return (0);
+}
+
+/* OUTLETS */
+
+struct _outlet
+{
+    t_object  *o_owner;
+    struct _outlet  *o_next;
+    t_symbol  *o_sym;
+};
+
+t_outlet *outlet_new(t_object *owner, t_symbol *s)
+{
+    t_outlet *x = getbytes(sizeof(*x)), **op;
+    x->o_owner = owner;
+    x->o_sym = s;
+    for (op = &owner->te_outlet; *op; op = &(*op)->o_next);
+    *op = x;
+    return (x);
+}
+
+static void pdstub_freeoutlets(t_object *ob)
+{
+    t_outlet *o, *next;
+    for (o = ob->te_outlet; o; o = next)
+    {
+	next = o->o_next;
+	freebytes(o, sizeof(*o));
+    }
+    ob->te_outlet = 0;
+}
+
+void outlet_bang(t_outlet *x)
+{
+    pdstub_noutputs++;
+}
+
+void outlet_float(t_outlet *x, t_float f)
+{
+    pdstub_noutputs++;
+}
+
+void outlet_symbol(t_outlet *x, t_symbol *s)
+{
+    pdstub_noutputs++;
+}
+
+void outlet_list(t_outlet *x, t_symbol *s, int argc, t_atom *argv)
+{
+    pdstub_noutputs++;
+}
+
+void outlet_anything(t_outlet *x, t_symbol *s, int argc, t_atom *argv)
+{
+    pdstub_noutputs++;
+}
+
+t_inlet *inlet_new(t_object *owner, t_pd *dest, t_symbol *s1, t_symbol *s2)
+{
+    return (0);
+}
+
+t_inlet *floatinlet_new(t_object *owner, t_float *fp)
+{
+    return (0);
+}
+
+/* ATOMS AND BINBUFS */
+
+struct _binbuf
+{
+    int      b_n;
+    t_atom  *b_vec;
+};
+
+t_float atom_getfloat(const t_atom *a)
+{
+    return (a->a_type == A_FLOAT ? a->a_w.w_float : 0);
+}
+
+t_symbol *atom_getsymbol(const t_atom *a)
+{
+    return (a->a_type == A_SYMBOL ? a->a_w.w_symbol : &s_);
+}
+
+void atom_string(const t_atom *a, char *buf, unsigned int bufsize)
+{
+    char tbuf[64];
+    const char *s = tbuf;
+    switch (a->a_type)
+    {
+    case A_FLOAT:
+	sprintf(tbuf, "%g", a->a_w.w_float);
+	break;
+    case A_SYMBOL:
+	s = a->a_w.w_symbol->s_name;
+	break;
+    case A_SEMI:
+	s = ";";
+	break;
+    case A_COMMA:
+	s = ",";
+	break;
+    default:
+	s = "?";
+    }
+    if (bufsize)
+    {
+	strncpy(buf, s, bufsize - 1);
+	buf[bufsize - 1] = 0;
+    }
+}
+
+t_binbuf *binbuf_new(void)
+{
+    t_binbuf *x = getbytes(sizeof(*x));
+    x->b_n = 0;
+    x->b_vec = getbytes(0);
+    return (x);
+}
+
+void binbuf_free(t_binbuf *x)
+{
+    freebytes(x->b_vec, x->b_n * sizeof(*x->b_vec));
+    freebytes(x, sizeof(*x));
+}
+
+void binbuf_clear(t_binbuf *x)
+{
+    x->b_vec = resizebytes(x->b_vec, x->b_n * sizeof(*x->b_vec), 0);
+    x->b_n = 0;
+}
+
+void binbuf_add(t_binbuf *x, int argc, const t_atom *argv)
+{
+    int newsize = x->b_n + argc;
+    t_atom *ap;
+    if (!(ap = resizebytes(x->b_vec, x->b_n * sizeof(*x->b_vec),
+			   newsize * sizeof(*x->b_vec))))
+    {
+	error("binbuf_add: out of space");
+	return;
+    }
+    memcpy(ap + x->b_n, argv, argc * sizeof(*ap));
+    x->b_vec = ap;
+    x->b_n = newsize;
+}
+
+int binbuf_getnatom(const t_binbuf *x)
+{
+    return (x->b_n);
+}
+
+t_atom *binbuf_getvec(const t_binbuf *x)
+{
+    return (x->b_vec);
+}
+
+void binbuf_print(const t_binbuf *x)
+{
+    int i;
+    char buf[MAXPDSTRING];
+    for (i = 0; i < x->b_n; i++)
+    {
+	atom_string(x->b_vec + i, buf, MAXPDSTRING);
+	post("%s", buf);
+    }
+}
+
+static void pdstub_addtoken(t_binbuf *b, char *tok)
+{
+    t_atom at;
+    char *end;
+    double f = strtod(tok, &end);
+    if (*tok && !*end)
+	SETFLOAT(&at, f);
+    else SETSYMBOL(&at, gensym(tok));
+    binbuf_add(b, 1, &at);
+}
+
+/* plain text only, escapes are honored but not dollars */
+int binbuf_read_via_path(t_binbuf *b, const char *filename,
+			 const char *dirname, int crflag)
+{
+    char path[MAXPDSTRING], tok[MAXPDSTRING];
+    FILE *fp;
+    int c, n = 0;
+    t_atom sep;
+    if (*dirname && *filename != '/')
+	snprintf(path, MAXPDSTRING, "%s/%s", dirname, filename);
+    else snprintf(path, MAXPDSTRING, "%s", filename);
+    if (!(fp = fopen(path, "r")))
+    {
+	error("%s: can't open", path);
+	return (1);
+    }
+    binbuf_clear(b);
+    while (1)
+    {
+	c = fgetc(fp);
+	if (c == '\\' && (c = fgetc(fp)) != EOF)
+	{
+	    if (n < MAXPDSTRING - 1) tok[n++] = c;
+	    continue;
+	}
+	if (c == EOF || isspace(c) || c == ';' || c == ',')
+	{
+	    if (n)
+	    {
+		tok[n] = 0;
+		pdstub_addtoken(b, tok);
+		n = 0;
+	    }
+	    if (c == ';' || (crflag && c == '\n'))
+	    {
+		SETSEMI(&sep);
+		binbuf_add(b, 1, &sep);
+	    }
+	    else if (c == ',')
+	    {
+		SETCOMMA(&sep);
+		binbuf_add(b, 1, &sep);
+	    }
+	    if (c == EOF) break;
+	}
+	else if (n < MAXPDSTRING - 1) tok[n++] = c;
+    }
+    fclose(fp);
+    return (0);
+}
+
+int binbuf_write(const t_binbuf *x, const char *filename,
+		 const char *dir, int crflag)
+{
+    char path[MAXPDSTRING], buf[MAXPDSTRING];
+    FILE *fp;
+    int i, linestart = 1;
+    if (*dir)
+	snprintf(path, MAXPDSTRING, "%s/%s", dir, filename);
+    else snprintf(path, MAXPDSTRING, "%s", filename);
+    if (!(fp = fopen(path, "w")))
+    {
+	error("%s: can't create", path);
+	return (1);
+    }
+    for (i = 0; i < x->b_n; i++)
+    {
+	t_atom *ap = x->b_vec + i;
+	if (ap->a_type == A_SEMI)
+	{
+	    fputs(crflag ? "\n" : ";\n", fp);
+	    linestart = 1;
+	    continue;
+	}
+	if (ap->a_type == A_SYMBOL)
+	{
+	    /* escape separators */
+	    char *s = ap->a_w.w_symbol->s_name, *bp = buf;
+	    while (*s && bp < buf + MAXPDSTRING - 2)
+	    {
+		if (*s == ';' || *s == ',' || *s == '\\' || *s == ' ')
+		    *bp++ = '\\';
+		*bp++ = *s++;
+	    }
+	    *bp = 0;
+	}
+	else atom_string(ap, buf, MAXPDSTRING);
+	if (!linestart && ap->a_type != A_COMMA) fputc(' ', fp);
+	fputs(buf, fp);
+	linestart = 0;
+    }
+    if (fclose(fp))
+    {
+	error("%s: write failed", path);
+	return (1);
+    }
+    return (0);
+}
+
+/* CLOCKS */
+
+struct _clock
+{
+    double      c_settime;  /* negative if unset */
+    void       *c_owner;
+    t_method    c_fn;
+    struct _clock  *c_next;
+};
+
+static t_clock *pdstub_clocks = 0;
+static double pdstub_time = 0;
+
+t_clock *clock_new(void *owner, t_method fn)
+{
+    t_clock *x = getbytes(sizeof(*x));
+    x->c_settime = -1;
+    x->c_owner = owner;
+    x->c_fn = fn;
+    return (x);
+}
+
+void clock_unset(t_clock *x)
+{
+    if (x->c_settime >= 0)
+    {
+	t_clock **cp;
+	for (cp = &pdstub_clocks; *cp; cp = &(*cp)->c_next)
+	{
+	    if (*cp == x)
+	    {
+		*cp = x->c_next;
+		break;
+	    }
+	}
+	x->c_settime = -1;
+    }
+}
+
+void clock_delay(t_clock *x, double delaytime)
+{
+    t_clock **cp;
+    clock_unset(x);
+    x->c_settime = pdstub_time + (delaytime > 0 ? delaytime : 0);
+    for (cp = &pdstub_clocks; *cp && (*cp)->c_settime <= x->c_settime;
+	 cp = &(*cp)->c_next);
+    x->c_next = *cp;
+    *cp = x;
+}
+
+void clock_free(t_clock *x)
+{
+    clock_unset(x);
+    freebytes(x, sizeof(*x));
+}
+
+double clock_getlogicaltime(void)
+{
+    return (pdstub_time);
+}
+
+double clock_getsystime(void)
+{
+    return (pdstub_time);
+}
+
+double clock_gettimesince(double prevsystime)
+{
+    return (pdstub_time - prevsystime);
+}
+
+int pdstub_runclocks(double until)
+{
+    int count = 0;
+    t_clock *x;
+    while ((x = pdstub_clocks) && x->c_settime <= until)
+    {
+	pdstub_clocks = x->c_next;
+	pdstub_time = x->c_settime;
+	x->c_settime = -1;
+	((void (*)(void *))x->c_fn)(x->c_owner);
+	count++;
+    }
+    if (until > pdstub_time) pdstub_time = until;
+    return (count);
+}
+
+double pdstub_nextclock(void)
+{
+    return (pdstub_clocks ? pdstub_clocks->c_settime : -1);
+}
+
+/* SYSTEM, GUI AND CANVASES */
+
+void sys_gui(const char *s)
+{
+}
+
+void sys_vgui(const char *fmt, ...)
+{
+}
+
+void sys_getversion(int *major, int *minor, int *bugfix)
+{
+    *major = PD_MAJOR_VERSION;
+    *minor = PD_MINOR_VERSION;
+    *bugfix = 0;
+}
+
+void sys_bashfilename(const char *from, char *to)
+{
+    if (from != to) strcpy(to, from);
+}
+
+void sys_unbashfilename(const char *from, char *to)
+{
+    if (from != to) strcpy(to, from);
+}
+
+int open_via_path(const char *dir, const char *name, const char *ext,
+		  char *dirresult, char **nameresult,
+		  unsigned int size, int bin)
+{
+    char path[MAXPDSTRING];
+    int fd;
+    if (*name == '/' || !*dir)
+	dir = ".";
+    if (*name == '/')
+	snprintf(path, MAXPDSTRING, "%s%s", name, ext);
+    else snprintf(path, MAXPDSTRING, "%s/%s%s", dir, name, ext);
+    if ((fd = open(path, O_RDONLY)) < 0)
+	return (-1);
+    if (*name == '/')
+    {
+	snprintf(dirresult, size, "%s%s", name, ext);
+	*nameresult = dirresult;
+    }
+    else
+    {
+	int len = strlen(dir);
+	snprintf(dirresult, size, "%s", dir);
+	*nameresult = dirresult + len + 1;
+	snprintf(*nameresult, size - len - 1, "%s%s", name, ext);
+    }
+    return (fd);
+}
+
+t_class *canvas_class = 0;
+t_class *scalar_class = 0;
+t_class *garray_class = 0;
+
+t_canvas *canvas_getcurrent(void)
+{
+    return (0);
+}
+
+t_symbol *canvas_getdir(const t_canvas *x)
+{
+    return (gensym("."));
+}
+
+void canvas_makefilename(const t_canvas *c, const char *file,
+			 char *result, int resultsize)
+{
+    snprintf(result, resultsize, "%s", file);
+}
+
+void canvas_redraw(t_canvas *x)
+{
+}
+
+static int glist_valid = 10000;
+
+void glist_delete(t_glist *x, t_gobj *y)
+{
+    x->gl_valid = ++glist_valid;  /* as Pd does, stale pointers tell */
+}
+
+int glist_isvisible(t_glist *x)
+{
+    return (0);
+}
+
+int garray_getfloatarray(t_garray *x, int *size, t_float **vec)
+{
+    return (0);
+}
+
+int garray_getfloatwords(t_garray *x, int *size, t_word **vec)
+{
+    return (0);
+}
+
+void garray_redraw(t_garray *x)
+{
+}
+
+void garray_resize(t_garray *x, t_floatarg f)
+{
+}
+
+int garray_npoints(t_garray *x)
+{
+    return (0);
+}
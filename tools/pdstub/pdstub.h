@@ -0,0 +1,21 @@
+/* Copyright (c) 1997-2002 Miller Puckette and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* driving the Pd stand-in from a standalone program */
+
+#ifndef __PDSTUB_H__
+#define __PDSTUB_H__
+
+extern int pdstub_verbose;        /* if zero, post() and error() are silent */
+extern unsigned long pdstub_noutputs;  /* number of outlet calls so far */
+
+t_pd *pdstub_create(const char *classname, int argc, t_atom *argv);
+void pdstub_delete(t_pd *x);
+void pdstub_send(t_pd *x, const char *selector, int argc, t_atom *argv);
+
+/* fire all clocks due until given logical time (msec), return count */
+int pdstub_runclocks(double until);
+double pdstub_nextclock(void);  /* negative if none is set */
+
+#endif
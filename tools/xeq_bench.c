@@ -0,0 +1,369 @@
+/* Copyright (c) 1997-2002 Miller Puckette and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* Headless benchmarks of the sequencing core, built against the Pd
+   stand-in in tools/pdstub (use `make bench').  A synthetic sequence of
+   note events is generated, then traversed, searched, rendered, written
+   to and read from a midifile.  Every result is printed on a line of its
+   own: name, value, unit, so that it is easy to track in a build log. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "m_pd.h"
+#include "pdstub.h"
+#include "shared.h"
+#include "sq.h"
+#include "bifi.h"
+#include "mifi.h"
+#include "mfbb.h"
+#include "dict.h"
+#include "hyphen.h"
+#include "xeq.h"
+
+#define BENCH_NTRACKS  4
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+static void bench_report(char *name, double value, char *unit)
+{
+    printf("%-28s %14.2f %s\n", name, value, unit);
+    fflush(stdout);
+}
+
+static unsigned int bench_seed = 1;
+
+static int bench_random(int range)
+{
+    unsigned int hi;
+    bench_seed = bench_seed * 1103515245 + 12345;
+    hi = bench_seed >> 16;
+    bench_seed = bench_seed * 1103515245 + 12345;
+    return ((int)(((hi << 15) ^ (bench_seed >> 16)) % range));
+}
+
+/* Fills a binbuf with nevents note events in midifile particle format
+   (delta, track, status, pitch, velocity, channel, semi).  Every note-on
+   is followed by its note-off, notes of different tracks overlap.  All
+   notes are on channel one, so that reading back a midifile in default
+   single-track mode yields every event.
+   Returns total duration in msec. */
+static double bench_fill(t_binbuf *bb, int nevents)
+{
+    t_atom *vec = getbytes(nevents * 7 * sizeof(*vec)), *ap = vec;
+    t_symbol *tracks[BENCH_NTRACKS];
+    double total = 0;
+    int i, pitch = 60;
+    char buf[32];
+    for (i = 0; i < BENCH_NTRACKS; i++)
+    {
+	sprintf(buf, "%d-track", i + 1);
+	tracks[i] = gensym(buf);
+    }
+    for (i = 0; i < nevents; i++)
+    {
+	int isoff = i & 1, delta = (bench_random(4) ? bench_random(40) : 0);
+	if (!isoff) pitch = 36 + bench_random(60);
+	SETFLOAT(ap, delta); ap++;
+	SETSYMBOL(ap, tracks[(i >> 1) % BENCH_NTRACKS]); ap++;
+	SETFLOAT(ap, isoff ? 0x80 : 0x90); ap++;
+	SETFLOAT(ap, pitch); ap++;
+	SETFLOAT(ap, isoff ? 0 : 1 + bench_random(127)); ap++;
+	SETFLOAT(ap, 1); ap++;
+	SETSEMI(ap); ap++;
+	total += delta;
+    }
+    binbuf_clear(bb);
+    binbuf_add(bb, nevents * 7, vec);
+    freebytes(vec, nevents * 7 * sizeof(*vec));
+    return (total);
+}
+
+/* plain traversal, as done by any derived object walking a sequence */
+static void bench_walk(t_xeq *x, int nevents, int nrepeats)
+{
+    t_xeqit *it = &x->x_walkit;
+    double start, elapsed;
+    int i;
+    xeqit_sethooks(it, 0, 0, 0, 0, 0);
+    start = bench_now();
+    for (i = 0; i < nrepeats; i++)
+    {
+	xeqit_rewind(it);
+	while (!it->i_finish)
+	    xeqit_donext(it);
+    }
+    elapsed = bench_now() - start;
+    bench_report("walk", nevents * (double)nrepeats / elapsed, "events/s");
+}
+
+/* step playback, with message dispatch through the usual hooks,
+   midi output either unpacked or packed */
+static void bench_step(t_xeq *x, int nevents, int nrepeats, int packed)
+{
+    char name[32];
+    unsigned long count = pdstub_noutputs;
+    double start, elapsed;
+    int i, n;
+    x->x_packed = packed;
+    start = bench_now();
+    for (i = 0; i < nrepeats; i++)
+    {
+	xeq_rewind(x);
+	for (n = 0; n < nevents && !x->x_stepit.i_finish; n++)
+	    pdstub_send((t_pd *)x, "next", 0, 0);
+    }
+    elapsed = bench_now() - start;
+    x->x_packed = XEQ_PACKED_OFF;
+    sprintf(name, packed ? "step packed" : "step");
+    bench_report(name, nevents * (double)nrepeats / elapsed, "events/s");
+    strcat(name, " outputs");
+    bench_report(name, (pdstub_noutputs - count) /
+		 (double)nrepeats, "outputs/pass");
+}
+
+/* step playback by a friend, validated on every message */
+static void bench_friendstep(t_xeq *x, int nevents, int nrepeats)
+{
+    t_pd *friend;
+    t_atom at;
+    double start, elapsed;
+    int i, n;
+    SETSYMBOL(&at, gensym("bench"));
+    if (!(friend = pdstub_create("xeq_parse", 1, &at)))
+	return;
+    start = bench_now();
+    for (i = 0; i < nrepeats; i++)
+    {
+	pdstub_send(friend, "rewind", 0, 0);
+	for (n = 0; n < nevents; n++)
+	    pdstub_send(friend, "next", 0, 0);
+    }
+    elapsed = bench_now() - start;
+    bench_report("friend step", nevents * (double)nrepeats / elapsed,
+		 "events/s");
+    pdstub_delete(friend);
+}
+
+/* clock-driven playback in logical time, with simultaneous events
+   passed one by one, or batched */
+static void bench_play(t_xeq *x, int nevents, int batch)
+{
+    unsigned long count = pdstub_noutputs;
+    double start, elapsed, when;
+    int nticks = 0;
+    t_atom at;
+    SETFLOAT(&at, batch);
+    pdstub_send((t_pd *)x, "batch", 1, &at);
+    xeq_rewind(x);
+    start = bench_now();
+    pdstub_send((t_pd *)x, "bang", 0, 0);
+    while ((when = pdstub_nextclock()) >= 0)
+	nticks += pdstub_runclocks(when);
+    elapsed = bench_now() - start;
+    SETFLOAT(&at, 0);
+    pdstub_send((t_pd *)x, "batch", 1, &at);
+    if (batch)
+    {
+	bench_report("play batched", nevents / elapsed, "events/s");
+	bench_report("play batched ticks", nticks, "clock ticks");
+	bench_report("play batched outputs", pdstub_noutputs - count,
+		     "outputs");
+    }
+    else
+    {
+	bench_report("play", nevents / elapsed, "events/s");
+	bench_report("play ticks", nticks, "clock ticks");
+	bench_report("play outputs", pdstub_noutputs - count, "outputs");
+    }
+}
+
+static void bench_seek(t_xeq *x, int nseeks, double duration)
+{
+    t_xeqlocator loc = x->x_beditloc;
+    int nevents = binbuf_getnatom(x->x_binbuf) / 7, i;
+    double start, elapsed;
+    xeqlocator_settotime(&loc, 0);
+    start = bench_now();
+    for (i = 0; i < nseeks; i++)
+	xeqlocator_settotime(&loc, bench_random((int)duration + 1));
+    elapsed = bench_now() - start;
+    bench_report("seek to time", elapsed * 1e9 / nseeks, "ns/seek");
+    start = bench_now();
+    for (i = 0; i < nseeks; i++)
+	xeqlocator_settoindex(&loc, bench_random(nevents));
+    elapsed = bench_now() - start;
+    bench_report("seek to index", elapsed * 1e9 / nseeks, "ns/seek");
+}
+
+static void bench_render(t_xeq *x, int nevents, int nrepeats)
+{
+    double start, elapsed;
+    int i, nrendered = 0;
+    start = bench_now();
+    for (i = 0; i < nrepeats; i++)
+    {
+	xeq_rewind(x);
+	nrendered += xeq_dorender(x, -1, 0);
+    }
+    elapsed = bench_now() - start;
+    bench_report("render", nrendered / elapsed, "events/s");
+}
+
+static void bench_midifile(t_binbuf *bb, char *dir, int nrepeats)
+{
+    char path[MAXPDSTRING];
+    t_binbuf *bb2 = binbuf_new();
+    t_symbol *tts = gensym("-");
+    double start, elapsed;
+    long nbytes;
+    FILE *fp;
+    int i;
+    start = bench_now();
+    for (i = 0; i < nrepeats; i++)
+	if (mfbb_write(bb, "xeq_bench.mid", dir, tts))
+	{
+	    fprintf(stderr, "midifile write failed\n");
+	    return;
+	}
+    elapsed = bench_now() - start;
+    sprintf(path, "%s/xeq_bench.mid", dir);
+    if (!(fp = fopen(path, "rb")))
+	return;
+    fseek(fp, 0, SEEK_END);
+    nbytes = ftell(fp);
+    fclose(fp);
+    bench_report("midifile size", nbytes / 1024., "KB");
+    bench_report("midifile write", nbytes * (double)nrepeats / elapsed / 1e6,
+		 "MB/s");
+    start = bench_now();
+    for (i = 0; i < nrepeats; i++)
+	if (mfbb_read(bb2, "xeq_bench.mid", dir, tts))
+	{
+	    fprintf(stderr, "midifile read failed\n");
+	    break;
+	}
+    elapsed = bench_now() - start;
+    bench_report("midifile read", nbytes * (double)nrepeats / elapsed / 1e6,
+		 "MB/s");
+    bench_report("midifile events", binbuf_getnatom(bb2) / 7, "events");
+    unlink(path);
+    binbuf_free(bb2);
+}
+
+/* conversion between delta times and onsets, in place */
+static void bench_fold(t_binbuf *bb, int nevents, int nrepeats)
+{
+    t_squtt tt;
+    t_mifi_stream *stp;
+    double start, elapsed;
+    int i;
+    squtt_make(&tt, gensym("-"));
+    if (!(stp = mfbb_make_stream(bb, &tt, 0)))
+	return;
+    stp->s_nevents = nevents;
+    stp->s_nticks = 500;  /* one tick per msec at default tempo */
+    start = bench_now();
+    for (i = 0; i < nrepeats; i++)
+    {
+	sq_unfold_time(stp);
+	sq_fold_time(stp);
+    }
+    elapsed = bench_now() - start;
+    bench_report("unfold+fold", nevents * (double)nrepeats / elapsed,
+		 "events/s");
+    mifi_stream_free(stp);
+}
+
+/* named hosts and friends, as in large patches */
+static void bench_dict(int nkeys)
+{
+    t_dict *d = dict_new(0);
+    t_symbol **keys = getbytes(nkeys * sizeof(*keys));
+    double start, elapsed;
+    char buf[32];
+    int i;
+    start = bench_now();
+    for (i = 0; i < nkeys; i++)
+    {
+	sprintf(buf, "seq%d", i);
+	keys[i] = dict_key(d, buf);
+	dict_bind(d, (t_pd *)keys, keys[i]);
+    }
+    elapsed = bench_now() - start;
+    bench_report("dict insert", elapsed * 1e9 / nkeys, "ns/key");
+    start = bench_now();
+    for (i = 0; i < nkeys; i++)
+    {
+	sprintf(buf, "seq%d", bench_random(nkeys));
+	if (!dict_value(d, dict_key(d, buf)))
+	    break;
+    }
+    elapsed = bench_now() - start;
+    bench_report("dict lookup", elapsed * 1e9 / nkeys, "ns/key");
+    freebytes(keys, nkeys * sizeof(*keys));
+}
+
+static void bench_usage(void)
+{
+    fprintf(stderr, "usage: xeq_bench [-n nevents] [-s nseeks] [-r nrepeats] \
+[-d tmpdir]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int nevents = 100000, nseeks = 1000, nrepeats = 5, c;
+    char *dir = "/tmp";
+    t_xeq *x;
+    t_atom at;
+    double duration;
+    while ((c = getopt(argc, argv, "n:s:r:d:")) != -1)
+    {
+	switch (c)
+	{
+	case 'n': nevents = atoi(optarg); break;
+	case 's': nseeks = atoi(optarg); break;
+	case 'r': nrepeats = atoi(optarg); break;
+	case 'd': dir = optarg; break;
+	default: bench_usage();
+	}
+    }
+    if (nevents < 2 || nseeks < 1 || nrepeats < 1)
+	bench_usage();
+    nevents &= ~1;
+
+    pdstub_verbose = 0;
+    xeq_setup();
+    SETSYMBOL(&at, gensym("bench"));
+    if (!(x = (t_xeq *)pdstub_create("xeq", 1, &at)))
+	return (1);
+    duration = bench_fill(x->x_binbuf, nevents);
+    xeq_rewindall(x);
+    bench_report("events", nevents, "events");
+    bench_report("duration", duration / 1000., "sec");
+
+    bench_walk(x, nevents, nrepeats);
+    bench_step(x, nevents, nrepeats, XEQ_PACKED_OFF);
+    bench_step(x, nevents, nrepeats, XEQ_PACKED_LIST);
+    bench_friendstep(x, nevents, nrepeats);
+    bench_play(x, nevents, 0);
+    bench_play(x, nevents, 1);
+    bench_seek(x, nseeks, duration);
+    bench_render(x, nevents, nrepeats);
+    bench_midifile(x->x_binbuf, dir, nrepeats);
+    bench_fold(x->x_binbuf, nevents, nrepeats);
+    bench_dict(nevents);
+
+    pdstub_delete((t_pd *)x);
+    return (0);
+}
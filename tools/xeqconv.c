@@ -0,0 +1,507 @@
+/* Copyright (c) 1997-2002 Miller Puckette and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* xeqconv: batch conversion between midifiles and qlists, outside of Pd.
+   Built from shared/ against the Pd stand-in in tools/pdstub (use `make
+   xeqconv').  Any number of files and directory trees may be given, they
+   are converted in parallel.  Every midifile (.mid, .midi, .smf) becomes
+   a qlist, and every qlist (.txt, or as given with -q) becomes a midifile,
+   stored next to its source, or in a mirrored tree under -o directory.
+   With -d midi or -d qlist, only one direction is converted.  Otherwise
+   a file whose output would overwrite another source (foo.mid and
+   foo.txt side by side) is skipped, and two sources writing the same
+   output (foo.mid and foo.midi) stop the whole run before it starts.
+
+   Jobs are dealt out to per-worker deques.  A worker takes jobs from the
+   back of its own deque, and when it runs dry, steals from the front of
+   others, so that a few large files do not keep the whole pool waiting. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "m_pd.h"
+#include "pdstub.h"
+#include "shared.h"
+#include "sq.h"
+#include "bifi.h"
+#include "mifi.h"
+#include "mfbb.h"
+
+#define XEQCONV_MAXTHREADS  256
+
+typedef struct _xeqconv_job
+{
+    char    *j_srcdir;
+    char    *j_srcname;
+    char    *j_dstdir;
+    char    *j_dstname;
+    int      j_tomidi;
+    int      j_failed;   /* 0, or one of the messages below */
+    int      j_nevents;
+    double   j_msecs;
+} t_xeqconv_job;
+
+static char *xeqconv_failures[] =
+{
+    "ok", "cannot read midifile", "cannot write qlist",
+    "cannot read qlist", "cannot write midifile"
+};
+
+typedef struct _xeqconv_deque
+{
+    pthread_mutex_t  d_lock;
+    int     *d_jobs;
+    int      d_head;  /* stolen from here */
+    int      d_tail;  /* taken by owner from here */
+} t_xeqconv_deque;
+
+static t_xeqconv_job *xeqconv_jobs = 0;
+static int xeqconv_njobs = 0;
+static int xeqconv_jobsize = 0;
+static t_xeqconv_deque *xeqconv_deques;
+static int xeqconv_nthreads = 0;
+static pthread_mutex_t xeqconv_outlock = PTHREAD_MUTEX_INITIALIZER;
+
+/* options */
+static t_symbol *xeqconv_tts;
+static char *xeqconv_qext = "txt";
+static char *xeqconv_outdir = 0;
+static int xeqconv_quiet = 0;
+static int xeqconv_direction = -1;  /* 1: to midifiles, 0: to qlists */
+
+static double xeqconv_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000. + ts.tv_nsec * 1e-6);
+}
+
+static char *xeqconv_strdup(const char *s)
+{
+    char *result = malloc(strlen(s) + 1);
+    if (!result)
+    {
+	fprintf(stderr, "xeqconv: out of memory\n");
+	exit(2);
+    }
+    return (strcpy(result, s));
+}
+
+static char *xeqconv_join(const char *dir, const char *name)
+{
+    char *result = malloc(strlen(dir) + strlen(name) + 2);
+    if (!result)
+    {
+	fprintf(stderr, "xeqconv: out of memory\n");
+	exit(2);
+    }
+    if (*dir && *name) sprintf(result, "%s/%s", dir, name);
+    else strcpy(result, *dir ? dir : name);
+    return (result);
+}
+
+static int xeqconv_mkdirs(char *path)
+{
+    char *p;
+    for (p = path + 1; *p; p++)
+    {
+	if (*p == '/')
+	{
+	    *p = 0;
+	    if (mkdir(path, 0777) < 0 && errno != EEXIST)
+		return (0);
+	    *p = '/';
+	}
+    }
+    return (mkdir(path, 0777) == 0 || errno == EEXIST);
+}
+
+/* returns 1 for a midifile, 0 for a qlist, -1 otherwise,
+   and sets *extp to the extension's dot */
+static int xeqconv_filetype(char *name, char **extp)
+{
+    char *ext = strrchr(name, '.');
+    if (!ext || ext == name) return (-1);
+    *extp = ext++;
+    if (!strcasecmp(ext, "mid") || !strcasecmp(ext, "midi") ||
+	!strcasecmp(ext, "smf"))
+	return (1);
+    if (!strcmp(ext, xeqconv_qext))
+	return (0);
+    return (-1);
+}
+
+/* reldir is a path relative to the root given on command line
+   (used for mirroring under -o directory) */
+static void xeqconv_addjob(char *srcdir, char *reldir, char *name)
+{
+    t_xeqconv_job *jp;
+    char *ext, buf[MAXPDSTRING];
+    int type = xeqconv_filetype(name, &ext);
+    if (type < 0 || (xeqconv_direction >= 0 && type == xeqconv_direction))
+	return;
+    if (xeqconv_njobs == xeqconv_jobsize)
+    {
+	int newsize = xeqconv_jobsize ? 2 * xeqconv_jobsize : 256;
+	if (!(jp = realloc(xeqconv_jobs, newsize * sizeof(*jp))))
+	{
+	    fprintf(stderr, "xeqconv: out of memory\n");
+	    exit(2);
+	}
+	xeqconv_jobs = jp;
+	xeqconv_jobsize = newsize;
+    }
+    jp = xeqconv_jobs + xeqconv_njobs++;
+    jp->j_srcdir = xeqconv_strdup(srcdir);
+    jp->j_srcname = xeqconv_strdup(name);
+    jp->j_dstdir = (xeqconv_outdir ? xeqconv_join(xeqconv_outdir, reldir)
+		    : xeqconv_strdup(srcdir));
+    snprintf(buf, MAXPDSTRING, "%.*s.%s", (int)(ext - name), name,
+	     type ? xeqconv_qext : "mid");
+    jp->j_dstname = xeqconv_strdup(buf);
+    jp->j_tomidi = !type;
+    jp->j_failed = 0;
+    jp->j_nevents = 0;
+    jp->j_msecs = 0;
+}
+
+static void xeqconv_scan(char *dir, char *reldir)
+{
+    DIR *dp;
+    struct dirent *de;
+    struct stat st;
+    if (!(dp = opendir(dir)))
+    {
+	fprintf(stderr, "xeqconv: cannot open directory %s: %s\n",
+		dir, strerror(errno));
+	return;
+    }
+    while ((de = readdir(dp)))
+    {
+	char *path;
+	if (de->d_name[0] == '.') continue;
+	path = xeqconv_join(dir, de->d_name);
+	if (stat(path, &st) < 0)
+	    fprintf(stderr, "xeqconv: %s: %s\n", path, strerror(errno));
+	else if (S_ISDIR(st.st_mode))
+	{
+	    char *rel = xeqconv_join(reldir, de->d_name);
+	    xeqconv_scan(path, rel);
+	    free(rel);
+	}
+	else if (S_ISREG(st.st_mode))
+	    xeqconv_addjob(dir, reldir, de->d_name);
+	free(path);
+    }
+    closedir(dp);
+}
+
+static int xeqconv_strcmp(const void *p1, const void *p2)
+{
+    return (strcmp(*(char **)p1, *(char **)p2));
+}
+
+static int xeqconv_pathcmp(const void *p1, const void *p2)
+{
+    return (strcmp(**(char ***)p1, **(char ***)p2));
+}
+
+static void xeqconv_freejob(t_xeqconv_job *jp)
+{
+    free(jp->j_srcdir);
+    free(jp->j_srcname);
+    free(jp->j_dstdir);
+    free(jp->j_dstname);
+}
+
+/* Drop jobs whose output is another job's source, then refuse to go on
+   if two jobs still have the same output.  Both are checked before any
+   worker starts, since the order in which workers get to the files is
+   arbitrary.  Returns the number of clashing outputs. */
+static int xeqconv_checkjobs(void)
+{
+    char **srcs, **dsts, ***byname;
+    int i, j, nclashes = 0;
+    if (!(srcs = malloc(xeqconv_njobs * sizeof(*srcs))) ||
+	!(dsts = malloc(xeqconv_njobs * sizeof(*dsts))) ||
+	!(byname = malloc(xeqconv_njobs * sizeof(*byname))))
+    {
+	fprintf(stderr, "xeqconv: out of memory\n");
+	exit(2);
+    }
+    for (i = 0; i < xeqconv_njobs; i++)
+    {
+	srcs[i] = xeqconv_join(xeqconv_jobs[i].j_srcdir,
+			       xeqconv_jobs[i].j_srcname);
+	dsts[i] = xeqconv_join(xeqconv_jobs[i].j_dstdir,
+			       xeqconv_jobs[i].j_dstname);
+    }
+    qsort(srcs, xeqconv_njobs, sizeof(*srcs), xeqconv_strcmp);
+    for (i = j = 0; i < xeqconv_njobs; i++)
+    {
+	if (bsearch(dsts + i, srcs, xeqconv_njobs, sizeof(*srcs),
+		    xeqconv_strcmp))
+	{
+	    fprintf(stderr, "xeqconv: skipping %s/%s: %s is also a source \
+(use -d)\n", xeqconv_jobs[i].j_srcdir, xeqconv_jobs[i].j_srcname, dsts[i]);
+	    xeqconv_freejob(xeqconv_jobs + i);
+	    free(dsts[i]);
+	}
+	else
+	{
+	    xeqconv_jobs[j] = xeqconv_jobs[i];
+	    dsts[j++] = dsts[i];
+	}
+    }
+    for (i = 0; i < xeqconv_njobs; i++)
+	free(srcs[i]);
+    xeqconv_njobs = j;
+
+    for (i = 0; i < xeqconv_njobs; i++)
+	byname[i] = dsts + i;
+    qsort(byname, xeqconv_njobs, sizeof(*byname), xeqconv_pathcmp);
+    for (i = 1; i < xeqconv_njobs; i++)
+    {
+	if (!strcmp(*byname[i], *byname[i-1]))
+	{
+	    t_xeqconv_job *jp1 = xeqconv_jobs + (byname[i-1] - dsts),
+		*jp2 = xeqconv_jobs + (byname[i] - dsts);
+	    fprintf(stderr, "xeqconv: %s/%s and %s/%s both write %s\n",
+		    jp1->j_srcdir, jp1->j_srcname,
+		    jp2->j_srcdir, jp2->j_srcname, *byname[i]);
+	    nclashes++;
+	}
+    }
+    for (i = 0; i < xeqconv_njobs; i++)
+	free(dsts[i]);
+    free(srcs);
+    free(dsts);
+    free(byname);
+    return (nclashes);
+}
+
+static void xeqconv_convert(t_xeqconv_job *jp)
+{
+    t_binbuf *bb = binbuf_new();
+    double start = xeqconv_now();
+    if (jp->j_tomidi)
+    {
+	if (binbuf_read_via_path(bb, jp->j_srcname, jp->j_srcdir, 0))
+	    jp->j_failed = 3;
+	else if (mfbb_write(bb, jp->j_dstname, jp->j_dstdir, xeqconv_tts))
+	    jp->j_failed = 4;
+    }
+    else
+    {
+	if (mfbb_read(bb, jp->j_srcname, jp->j_srcdir, xeqconv_tts))
+	    jp->j_failed = 1;
+	else if (binbuf_write(bb, jp->j_dstname, jp->j_dstdir, 0))
+	    jp->j_failed = 2;
+    }
+    jp->j_msecs = xeqconv_now() - start;
+    /* qlist lines of channel events are 7 atoms long */
+    jp->j_nevents = binbuf_getnatom(bb) / 7;
+    binbuf_free(bb);
+
+    pthread_mutex_lock(&xeqconv_outlock);
+    if (jp->j_failed)
+	fprintf(stderr, "FAILED %s/%s: %s\n", jp->j_srcdir, jp->j_srcname,
+		xeqconv_failures[jp->j_failed]);
+    else if (!xeqconv_quiet)
+	printf("%9.2f ms %8d events  %s/%s -> %s/%s\n", jp->j_msecs,
+	       jp->j_nevents, jp->j_srcdir, jp->j_srcname,
+	       jp->j_dstdir, jp->j_dstname);
+    pthread_mutex_unlock(&xeqconv_outlock);
+}
+
+static int xeqconv_take(t_xeqconv_deque *dp)
+{
+    int result = -1;
+    pthread_mutex_lock(&dp->d_lock);
+    if (dp->d_tail > dp->d_head)
+	result = dp->d_jobs[--dp->d_tail];
+    pthread_mutex_unlock(&dp->d_lock);
+    return (result);
+}
+
+static int xeqconv_steal(t_xeqconv_deque *dp)
+{
+    int result = -1;
+    pthread_mutex_lock(&dp->d_lock);
+    if (dp->d_tail > dp->d_head)
+	result = dp->d_jobs[dp->d_head++];
+    pthread_mutex_unlock(&dp->d_lock);
+    return (result);
+}
+
+static void *xeqconv_worker(void *arg)
+{
+    int self = (int)(long)arg, ndx, i;
+    while (1)
+    {
+	if ((ndx = xeqconv_take(xeqconv_deques + self)) < 0)
+	{
+	    /* no jobs are created during conversion, so if every deque
+	       is empty, we are done */
+	    for (i = 1; i < xeqconv_nthreads; i++)
+		if ((ndx = xeqconv_steal(xeqconv_deques +
+					 (self + i) % xeqconv_nthreads)) >= 0)
+		    break;
+	    if (ndx < 0) break;
+	}
+	xeqconv_convert(xeqconv_jobs + ndx);
+    }
+    return (0);
+}
+
+static void xeqconv_usage(void)
+{
+    fprintf(stderr, "usage: xeqconv [-j nthreads] [-t template] \
+[-o outdir] [-q qlistext] [-d midi|qlist] [-s] [-v] path...\n\
+  -j  number of worker threads (default: number of processors)\n\
+  -t  track template, as in `mfread'/`mfwrite' (e.g. 1:16-track)\n\
+  -o  write into a tree mirrored under outdir (default: next to sources)\n\
+  -q  qlist file extension (default: txt)\n\
+  -d  convert only into midifiles, or only into qlists (default: both)\n\
+  -s  summary only\n\
+  -v  verbose (show messages of midifile routines)\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t threads[XEQCONV_MAXTHREADS];
+    int i, c, nfailed = 0;
+    long nevents = 0;
+    double start, elapsed, worktime = 0;
+    char *tts = 0;
+    struct stat st;
+
+    xeqconv_nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    pdstub_verbose = 0;
+    while ((c = getopt(argc, argv, "j:t:o:q:d:sv")) != -1)
+    {
+	switch (c)
+	{
+	case 'j': xeqconv_nthreads = atoi(optarg); break;
+	case 't': tts = optarg; break;
+	case 'o': xeqconv_outdir = optarg; break;
+	case 'q': xeqconv_qext = (*optarg == '.' ? optarg + 1 : optarg); break;
+	case 'd':
+	    if (!strcmp(optarg, "midi")) xeqconv_direction = 1;
+	    else if (!strcmp(optarg, "qlist")) xeqconv_direction = 0;
+	    else xeqconv_usage();
+	    break;
+	case 's': xeqconv_quiet = 1; break;
+	case 'v': pdstub_verbose = 1; break;
+	default: xeqconv_usage();
+	}
+    }
+    if (optind >= argc)
+	xeqconv_usage();
+    if (xeqconv_nthreads < 1)
+	xeqconv_nthreads = 1;
+    else if (xeqconv_nthreads > XEQCONV_MAXTHREADS)
+	xeqconv_nthreads = XEQCONV_MAXTHREADS;
+    xeqconv_tts = (tts ? gensym(tts) : &s_);
+
+    for (i = optind; i < argc; i++)
+    {
+	if (stat(argv[i], &st) < 0)
+	    fprintf(stderr, "xeqconv: %s: %s\n", argv[i], strerror(errno));
+	else if (S_ISDIR(st.st_mode))
+	    xeqconv_scan(argv[i], "");
+	else
+	{
+	    char *path = xeqconv_strdup(argv[i]), *slash = strrchr(path, '/');
+	    if (slash)
+	    {
+		*slash = 0;
+		xeqconv_addjob(*path ? path : "/", "", slash + 1);
+	    }
+	    else xeqconv_addjob(".", "", path);
+	    free(path);
+	}
+    }
+    if (xeqconv_njobs && xeqconv_checkjobs())
+    {
+	fprintf(stderr, "xeqconv: conflicting outputs, nothing converted\n");
+	return (1);
+    }
+    if (!xeqconv_njobs)
+    {
+	fprintf(stderr, "xeqconv: nothing to convert\n");
+	return (1);
+    }
+    /* output directories are created up front, not by competing workers */
+    if (xeqconv_outdir)
+	for (i = 0; i < xeqconv_njobs; i++)
+	    if ((i == 0 || strcmp(xeqconv_jobs[i].j_dstdir,
+				  xeqconv_jobs[i-1].j_dstdir)) &&
+		!xeqconv_mkdirs(xeqconv_jobs[i].j_dstdir))
+		fprintf(stderr, "xeqconv: cannot create %s: %s\n",
+			xeqconv_jobs[i].j_dstdir, strerror(errno));
+    if (xeqconv_nthreads > xeqconv_njobs)
+	xeqconv_nthreads = xeqconv_njobs;
+
+    /* deal jobs round-robin, so that every worker starts with a share
+       of each directory */
+    if (!(xeqconv_deques = calloc(xeqconv_nthreads, sizeof(*xeqconv_deques))))
+	return (2);
+    for (i = 0; i < xeqconv_nthreads; i++)
+    {
+	pthread_mutex_init(&xeqconv_deques[i].d_lock, 0);
+	if (!(xeqconv_deques[i].d_jobs =
+	      malloc((xeqconv_njobs / xeqconv_nthreads + 1) * sizeof(int))))
+	    return (2);
+    }
+    for (i = 0; i < xeqconv_njobs; i++)
+    {
+	t_xeqconv_deque *dp = xeqconv_deques + i % xeqconv_nthreads;
+	dp->d_jobs[dp->d_tail++] = i;
+    }
+
+    start = xeqconv_now();
+    for (i = 0; i < xeqconv_nthreads; i++)
+	if (pthread_create(threads + i, 0, xeqconv_worker, (void *)(long)i))
+	{
+	    fprintf(stderr, "xeqconv: cannot start thread\n");
+	    return (2);
+	}
+    for (i = 0; i < xeqconv_nthreads; i++)
+	pthread_join(threads[i], 0);
+    elapsed = xeqconv_now() - start;
+
+    for (i = 0; i < xeqconv_njobs; i++)
+    {
+	t_xeqconv_job *jp = xeqconv_jobs + i;
+	worktime += jp->j_msecs;
+	if (jp->j_failed) nfailed++;
+	else nevents += jp->j_nevents;
+    }
+    printf("xeqconv: %d files, %d converted, %d failed, %ld events\n",
+	   xeqconv_njobs, xeqconv_njobs - nfailed, nfailed, nevents);
+    printf("xeqconv: %.2f s on %d threads (%.2f s of work, %.1f files/s)\n",
+	   elapsed / 1000., xeqconv_nthreads, worktime / 1000.,
+	   xeqconv_njobs * 1000. / (elapsed > 0 ? elapsed : 1));
+    if (nfailed)
+    {
+	fprintf(stderr, "failures:\n");
+	for (i = 0; i < xeqconv_njobs; i++)
+	    if (xeqconv_jobs[i].j_failed)
+		fprintf(stderr, "  %s/%s: %s\n", xeqconv_jobs[i].j_srcdir,
+			xeqconv_jobs[i].j_srcname,
+			xeqconv_failures[xeqconv_jobs[i].j_failed]);
+    }
+    return (nfailed ? 1 : 0);
+}